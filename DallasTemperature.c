@@ -8,6 +8,7 @@
 // Modified by Jordan Hochenbaum
 
 #include "DallasTemperature.h"
+#include "health.h"
 #include "delay.h"
 
 typedef uint8_t ScratchPad[9];
@@ -28,9 +29,6 @@ bool checkForConversion;
 // count of devices on the bus
 uint8_t devices;
 
-// Take a pointer to one wire instance
-struct OneWire * _wire;
-
 
 // reads scratchpad and returns the temperature in degrees C
 float calculateTemperature(uint8_t*, uint8_t*);
@@ -50,12 +48,15 @@ AlarmHandler *_AlarmHandler;
 #endif
 
 
-void DallasTemperature_Init(struct OneWire* _oneWire)
 #if REQUIRESALARMS
-: _AlarmHandler(&defaultAlarmHandler)
+void DallasTemperature_defaultAlarmHandler(uint8_t* deviceAddress);
 #endif
+
+void DallasTemperature_Init(void)
 {
-	_wire = _oneWire;
+#if REQUIRESALARMS
+	_AlarmHandler = DallasTemperature_defaultAlarmHandler;
+#endif
 	devices = 0;
 	parasite = FALSE;
 	bitResolution = 9;
@@ -72,7 +73,7 @@ uint8_t DallasTemperature_getDeviceCount(void)
 // returns TRUE if address is valid
 bool DallasTemperature_validAddress(uint8_t* deviceAddress)
 {
-	return (bool)(_wire->crc8(deviceAddress, 7) == deviceAddress[7]);
+	return (bool)(OneWire_crc8(deviceAddress, 7) == deviceAddress[7]);
 }
 
 // finds an address at a given index on the bus
@@ -81,11 +82,15 @@ bool DallasTemperature_getAddress(uint8_t* deviceAddress, uint8_t index)
 {
 	uint8_t depth = 0;
 	
-	_wire->reset_search();
+	OneWire_reset_search();
 	
-	while (depth <= index && _wire->search(deviceAddress))
+	while (depth <= index && OneWire_search(deviceAddress))
 	{
-		if (depth == index && DallasTemperature_validAddress(deviceAddress)) return TRUE;
+		if (depth == index)
+		{
+			if (DallasTemperature_validAddress(deviceAddress)) return TRUE;
+			Health_Count(HEALTH_ONEWIRE_CRC);
+		}
 		depth++;
 	}
 	
@@ -96,9 +101,9 @@ bool DallasTemperature_getAddress(uint8_t* deviceAddress, uint8_t index)
 void DallasTemperature_readScratchPad(uint8_t* deviceAddress, uint8_t* scratchPad)
 {
 	// send the command
-	_wire->reset();
-	_wire->select(deviceAddress);
-	_wire->write(READSCRATCH, 0);
+	OneWire_reset();
+	OneWire_select(deviceAddress);
+	OneWire_write(READSCRATCH, 0);
 	
 	// TODO => collect all comments &  use simple loop
 	// byte 0: temperature LSB  
@@ -116,56 +121,64 @@ void DallasTemperature_readScratchPad(uint8_t* deviceAddress, uint8_t* scratchPa
 	//
 	// for(int i=0; i<9; i++)
 	// {
-	//   scratchPad[i] = _wire->read();
+	//   scratchPad[i] = OneWire_read();
 	// }
 	
 	
 	// read the response
 	
 	// byte 0: temperature LSB
-	scratchPad[TEMP_LSB] = _wire->read();
+	scratchPad[TEMP_LSB] = OneWire_read();
 	
 	// byte 1: temperature MSB
-	scratchPad[TEMP_MSB] = _wire->read();
+	scratchPad[TEMP_MSB] = OneWire_read();
 	
 	// byte 2: high alarm temp
-	scratchPad[HIGH_ALARM_TEMP] = _wire->read();
+	scratchPad[HIGH_ALARM_TEMP] = OneWire_read();
 	
 	// byte 3: low alarm temp
-	scratchPad[LOW_ALARM_TEMP] = _wire->read();
+	scratchPad[LOW_ALARM_TEMP] = OneWire_read();
 	
 	// byte 4:
 	// DS18S20: store for crc
 	// DS18B20 & DS1822: configuration register
-	scratchPad[CONFIGURATION] = _wire->read();
+	scratchPad[CONFIGURATION] = OneWire_read();
 	
 	// byte 5:
 	// internal use & crc
-	scratchPad[INTERNAL_BYTE] = _wire->read();
+	scratchPad[INTERNAL_BYTE] = OneWire_read();
 	
 	// byte 6:
 	// DS18S20: COUNT_REMAIN
 	// DS18B20 & DS1822: store for crc
-	scratchPad[COUNT_REMAIN] = _wire->read();
+	scratchPad[COUNT_REMAIN] = OneWire_read();
 	
 	// byte 7:
 	// DS18S20: COUNT_PER_C
 	// DS18B20 & DS1822: store for crc
-	scratchPad[COUNT_PER_C] = _wire->read();
+	scratchPad[COUNT_PER_C] = OneWire_read();
 	
 	// byte 8:
 	// SCTRACHPAD_CRC
-	scratchPad[SCRATCHPAD_CRC] = _wire->read();
+	scratchPad[SCRATCHPAD_CRC] = OneWire_read();
 	
-	_wire->reset();
+	OneWire_reset();
 }
 
 // attempt to determine if the device at the given address is connected to the bus
 // also allows for updating the read scratchpad
 bool DallasTemperature_isConnected2(uint8_t* deviceAddress, uint8_t* scratchPad)
 {
+	uint8_t i;
+	
 	DallasTemperature_readScratchPad(deviceAddress, scratchPad);
-	return (bool)(_wire->crc8(scratchPad, 8) == scratchPad[SCRATCHPAD_CRC]);
+	if (OneWire_crc8(scratchPad, 8) == scratchPad[SCRATCHPAD_CRC])
+		return TRUE;
+	// all ones is a sensor that did not answer, the reset counted that
+	for (i = 0; i < 9 && scratchPad[i] == 0xFF; i++);
+	if (i < 9)
+		Health_Count(HEALTH_ONEWIRE_CRC);
+	return FALSE;
 }
 
 // attempt to determine if the device at the given address is connected to the bus
@@ -179,29 +192,29 @@ bool DallasTemperature_isConnected1(uint8_t* deviceAddress)
 // writes device's scratch pad
 void DallasTemperature_writeScratchPad(uint8_t* deviceAddress, const uint8_t* scratchPad)
 {
-	_wire->reset();
-	_wire->select(deviceAddress);
-	_wire->write(WRITESCRATCH, 0);
-	_wire->write(scratchPad[HIGH_ALARM_TEMP], 0); // high alarm temp
-	_wire->write(scratchPad[LOW_ALARM_TEMP], 0); // low alarm temp
+	OneWire_reset();
+	OneWire_select(deviceAddress);
+	OneWire_write(WRITESCRATCH, 0);
+	OneWire_write(scratchPad[HIGH_ALARM_TEMP], 0); // high alarm temp
+	OneWire_write(scratchPad[LOW_ALARM_TEMP], 0); // low alarm temp
 	// DS18S20 does not use the configuration register
-	if (deviceAddress[0] != DS18S20MODEL) _wire->write(scratchPad[CONFIGURATION], 0); // configuration
-	_wire->reset();
+	if (deviceAddress[0] != DS18S20MODEL) OneWire_write(scratchPad[CONFIGURATION], 0); // configuration
+	OneWire_reset();
 	// save the newly written values to eeprom
-	_wire->write(COPYSCRATCH, parasite);
+	OneWire_write(COPYSCRATCH, parasite);
 	if (parasite) _delay_ms(10); // 10ms delay
-	_wire->reset();
+	OneWire_reset();
 }
 
 // reads the device's power requirements
 bool DallasTemperature_readPowerSupply(uint8_t* deviceAddress)
 {
 	bool ret = FALSE;
-	_wire->reset();
-	_wire->select(deviceAddress);
-	_wire->write(READPOWERSUPPLY, 0);
-	if (_wire->read_bit() == 0) ret = TRUE;
-	_wire->reset();
+	OneWire_reset();
+	OneWire_select(deviceAddress);
+	OneWire_write(READPOWERSUPPLY, 0);
+	if (OneWire_read_bit() == 0) ret = TRUE;
+	OneWire_reset();
 	return ret;
 }
 
@@ -331,9 +344,9 @@ bool DallasTemperature_isConversionAvailable(uint8_t* deviceAddress)
 // sends command for all devices on the bus to perform a temperature conversion
 void DallasTemperature_requestTemperatures()
 {
-	_wire->reset();
-	_wire->skip();
-	_wire->write(STARTCONVO, parasite);
+	OneWire_reset();
+	OneWire_skip();
+	OneWire_write(STARTCONVO, parasite);
 	
 	// ASYNC mode?
 	if (!waitForConversion) return; 
@@ -348,9 +361,9 @@ void DallasTemperature_requestTemperatures()
 bool DallasTemperature_requestTemperaturesByAddress(uint8_t* deviceAddress)
 {
 	
-	_wire->reset();
-	_wire->select(deviceAddress);
-	_wire->write(STARTCONVO, parasite);
+	OneWire_reset();
+	OneWire_select(deviceAddress);
+	OneWire_write(STARTCONVO, parasite);
 	
 	// check device
 	ScratchPad scratchPad;
@@ -373,7 +386,7 @@ void blockTillConversionComplete(uint8_t* bitResolution, uint8_t* deviceAddress)
 		// Continue to check if the IC has responded with a temperature
 		// NB: Could cause issues with multiple devices (one device may respond faster)
 		unsigned long start = millis();
-		while(!DallasTemperature_isConversionAvailable(0) && ((millis() - start) < 750));	
+		while(!DallasTemperature_isConversionAvailable(deviceAddress) && ((millis() - start) < 750));	
 	}
 	
 	// Wait a fix number of cycles till conversion is complete (based on IC datasheet)
@@ -535,10 +548,10 @@ void DallasTemperature_setHighAlarmTemp(uint8_t* deviceAddress, int8_t celsius)
 	else if (celsius < -55) celsius = -55;
 	
 	ScratchPad scratchPad;
-	if (isConnected(deviceAddress, scratchPad))
+	if (DallasTemperature_isConnected2(deviceAddress, scratchPad))
 	{
 		scratchPad[HIGH_ALARM_TEMP] = (uint8_t)celsius;
-		writeScratchPad(deviceAddress, scratchPad);
+		DallasTemperature_writeScratchPad(deviceAddress, scratchPad);
 	}
 }
 
@@ -552,10 +565,10 @@ void DallasTemperature_setLowAlarmTemp(uint8_t* deviceAddress, int8_t celsius)
 	else if (celsius < -55) celsius = -55;
 	
 	ScratchPad scratchPad;
-	if (isConnected(deviceAddress, scratchPad))
+	if (DallasTemperature_isConnected2(deviceAddress, scratchPad))
 	{
 		scratchPad[LOW_ALARM_TEMP] = (uint8_t)celsius;
-		writeScratchPad(deviceAddress, scratchPad);
+		DallasTemperature_writeScratchPad(deviceAddress, scratchPad);
 	}
 }
 
@@ -564,7 +577,7 @@ void DallasTemperature_setLowAlarmTemp(uint8_t* deviceAddress, int8_t celsius)
 int8_t DallasTemperature_getHighAlarmTemp(uint8_t* deviceAddress)
 {
 	ScratchPad scratchPad;
-	if (isConnected(deviceAddress, scratchPad)) return (int8_t)scratchPad[HIGH_ALARM_TEMP];
+	if (DallasTemperature_isConnected2(deviceAddress, scratchPad)) return (int8_t)scratchPad[HIGH_ALARM_TEMP];
 	return DEVICE_DISCONNECTED;
 }
 
@@ -573,7 +586,7 @@ int8_t DallasTemperature_getHighAlarmTemp(uint8_t* deviceAddress)
 int8_t DallasTemperature_getLowAlarmTemp(uint8_t* deviceAddress)
 {
 	ScratchPad scratchPad;
-	if (isConnected(deviceAddress, scratchPad)) return (int8_t)scratchPad[LOW_ALARM_TEMP];
+	if (DallasTemperature_isConnected2(deviceAddress, scratchPad)) return (int8_t)scratchPad[LOW_ALARM_TEMP];
 	return DEVICE_DISCONNECTED;
 }
 
@@ -605,15 +618,15 @@ bool DallasTemperature_alarmSearch(uint8_t* newAddr)
 	uint8_t done = 1;
 	
 	if (alarmSearchExhausted) return FALSE;
-	if (!_wire->reset()) return FALSE;
+	if (!OneWire_reset()) return FALSE;
 	
 	// send the alarm search command
-	_wire->write(0xEC, 0);
+	OneWire_write(0xEC, 0);
 	
 	for(i = 0; i < 64; i++)
 	{
-		uint8_t a = _wire->read_bit( );
-		uint8_t nota = _wire->read_bit( );
+		uint8_t a = OneWire_read_bit( );
+		uint8_t nota = OneWire_read_bit( );
 		uint8_t ibyte = i / 8;
 		uint8_t ibit = 1 << (i & 7);
 		
@@ -655,7 +668,7 @@ bool DallasTemperature_alarmSearch(uint8_t* newAddr)
 		if (a) alarmSearchAddress[ibyte] |= ibit;
 		else alarmSearchAddress[ibyte] &= ~ibit;
 		
-		_wire->write_bit(a);
+		OneWire_write_bit(a);
 	}
 	
 	if (done) alarmSearchExhausted = 1;
@@ -667,10 +680,10 @@ bool DallasTemperature_alarmSearch(uint8_t* newAddr)
 // TODO: can this be done with only TEMP_MSB REGISTER (faster)
 //       if ((char) scratchPad[TEMP_MSB] <= (char) scratchPad[LOW_ALARM_TEMP]) return TRUE;
 //       if ((char) scratchPad[TEMP_MSB] >= (char) scratchPad[HIGH_ALARM_TEMP]) return TRUE;
-bool DallasTemperature_hasAlarm(uint8_t* deviceAddress)
+bool DallasTemperature_hasAlarm1(uint8_t* deviceAddress)
 {
 	ScratchPad scratchPad;
-	if (isConnected(deviceAddress, scratchPad))
+	if (DallasTemperature_isConnected2(deviceAddress, scratchPad))
 	{
 		float temp = calculateTemperature(deviceAddress, scratchPad);
 		
@@ -686,22 +699,22 @@ bool DallasTemperature_hasAlarm(uint8_t* deviceAddress)
 }
 
 // returns TRUE if any device is reporting an alarm condition on the bus
-bool DallasTemperature_hasAlarm(void)
+bool DallasTemperature_hasAlarm2(void)
 {
 	DeviceAddress deviceAddress;
-	resetAlarmSearch();
-	return alarmSearch(deviceAddress);
+	DallasTemperature_resetAlarmSearch();
+	return DallasTemperature_alarmSearch(deviceAddress);
 }
 
 // runs the alarm handler for all devices returned by alarmSearch()
 void DallasTemperature_processAlarms(void)
 {
-	resetAlarmSearch();
+	DallasTemperature_resetAlarmSearch();
 	DeviceAddress alarmAddr;
 	
-	while (alarmSearch(alarmAddr))
+	while (DallasTemperature_alarmSearch(alarmAddr))
 	{
-		if (validAddress(alarmAddr))
+		if (DallasTemperature_validAddress(alarmAddr))
 			_AlarmHandler(alarmAddr);
 	}
 }
@@ -755,10 +768,10 @@ void DallasTemperature_begin(void)
 {
 	DeviceAddress deviceAddress;
 	
-	_wire->reset_search();
+	OneWire_reset_search();
 	devices = 0; // Reset the number of devices when we enumerate wire devices
 	
-	while (_wire->search(deviceAddress))
+	while (OneWire_search(deviceAddress))
 	{
 		if (DallasTemperature_validAddress(deviceAddress))
 		{
@@ -10,12 +10,12 @@
 
 // set to true to include code for new and delete operators
 #ifndef REQUIRESNEW
-#define REQUIRESNEW false
+#define REQUIRESNEW 0
 #endif
 
 // set to true to include code implementing alarm search functions
 #ifndef REQUIRESALARMS
-#define REQUIRESALARMS true
+#define REQUIRESALARMS 1
 #endif
 
 #include "stm8s.h"
@@ -59,13 +59,17 @@
 #define constrain(x, a, b) ((x < a) ? a : ((x > b) ? b : x))
 
 // max function
-#define max(a, b) ((a < b) ? a : b)
+#define max(a, b) ((a < b) ? b : a)
 
 typedef uint8_t DeviceAddress[8];
 
+#if REQUIRESALARMS
+typedef void AlarmHandler(uint8_t*);
+#endif
+
 struct DallasTemperature
 {
-	void (*Init)(struct OneWire * one_wire);
+	void (*Init)(void);
 	
 	// initalise bus
 	void (*begin)(void);
@@ -146,8 +150,6 @@ struct DallasTemperature
 	
 #if REQUIRESALARMS
 	
-	typedef void AlarmHandler(uint8_t*);
-	
 	// sets the high alarm temperature for a device
 	// accepts a char.  valid range is -55C - 125C
 	void (*setHighAlarmTemp)(uint8_t*, const int8_t);
@@ -0,0 +1,66 @@
+#include "calib.h"
+#include "config.h"
+#include "one_wire.h"
+
+static const uint16_t * const calib_table[2] = {calib_gas_table, calib_lux_table};
+
+// per channel correction applied after the table, Q12 gain; the offset
+// spans the whole 0..65535 output range either way
+int16_t calib_gain[2] = {CALIB_GAIN_ONE, CALIB_GAIN_ONE};
+int32_t calib_offset[2];
+
+static uint16_t Calib_Lookup(uint8_t channel, uint16_t x)
+{
+	const uint16_t * t = calib_table[channel];
+	uint16_t i = x >> CALIB_SEGMENT_BITS;
+	uint16_t f = x & ((1 << CALIB_SEGMENT_BITS) - 1);
+	
+	return t[i] + (int16_t)(((int32_t)((int32_t)t[i + 1] - t[i]) * f) >> CALIB_SEGMENT_BITS);
+}
+
+void Calib_Init(void)
+{
+	struct calib_record rec;
+	uint8_t ch;
+	
+	if (Config_Read(CONFIG_KEY_CALIB, &rec, sizeof (struct calib_record)) != sizeof (struct calib_record) ||
+		rec.magic != CALIB_MAGIC ||
+		OneWire_crc8((uint8_t *)&rec, sizeof (struct calib_record) - 1) != rec.crc)
+	{
+		// no per unit calibration, use the nominal curves
+		return;
+	}
+	
+	for (ch = 0; ch < 2; ch++)
+	{
+		int32_t lo = Calib_Lookup(ch, rec.points[ch][0].raw);
+		int32_t hi = Calib_Lookup(ch, rec.points[ch][1].raw);
+		int32_t ref_lo = rec.points[ch][0].value;
+		int32_t ref_hi = rec.points[ch][1].value;
+		int32_t gain;
+		
+		if (hi == lo)
+			continue;
+		// map the nominal values at both points onto the references
+		gain = (ref_hi - ref_lo) * CALIB_GAIN_ONE / (hi - lo);
+		if (gain <= 0 || gain > 0x7FFF)
+			continue;
+		calib_gain[ch] = (int16_t)gain;
+		calib_offset[ch] = ref_lo - ((lo * gain) >> 12);
+	}
+}
+
+uint16_t Calib_Convert(uint8_t channel, uint16_t raw)
+{
+	int32_t y;
+	
+#if GAS_LIGHTING_RESOLUTION < CALIB_INPUT_BITS
+	raw <<= CALIB_INPUT_BITS - GAS_LIGHTING_RESOLUTION;
+#elif GAS_LIGHTING_RESOLUTION > CALIB_INPUT_BITS
+	raw >>= GAS_LIGHTING_RESOLUTION - CALIB_INPUT_BITS;
+#endif
+	y = (((int32_t)Calib_Lookup(channel, raw) * calib_gain[channel]) >> 12) + calib_offset[channel];
+	if (y < 0) y = 0;
+	if (y > 0xFFFF) y = 0xFFFF;
+	return (uint16_t)y;
+}
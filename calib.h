@@ -0,0 +1,45 @@
+#ifndef _calib_h_
+#define _calib_h_
+
+#include "stm8s.h"
+#include "gas_lighting.h"
+
+// The conversion tables take a 12 bit reading and are split into
+// 2^(12 - CALIB_SEGMENT_BITS) linear segments. calib_table.c is
+// generated by tools/gen_calib.py with the same geometry.
+#define CALIB_INPUT_BITS		12
+#define CALIB_SEGMENT_BITS		4
+#define CALIB_KNOTS				((1 << (CALIB_INPUT_BITS - CALIB_SEGMENT_BITS)) + 1)
+
+// fixed point scale of the table outputs
+#define CALIB_GAS_SCALE			100		// 0.01 kppm
+#define CALIB_LUX_SCALE			10		// 0.1 lux
+
+// per unit two point calibration, stored under CONFIG_KEY_CALIB
+#define CALIB_MAGIC				0xCA
+#define CALIB_GAIN_ONE			4096
+
+struct calib_point
+{
+	uint16_t raw;		// 12 bit reading
+	uint16_t value;		// reference value, table fixed point
+};
+
+struct calib_record
+{
+	uint8_t magic;
+	struct calib_point points[2][2];	// [channel][low, high]
+	uint8_t crc;		// OneWire_crc8 of the bytes above
+};
+
+extern const uint16_t calib_gas_table[CALIB_KNOTS];
+extern const uint16_t calib_lux_table[CALIB_KNOTS];
+
+// Loads the per unit calibration from the config log, if there is a valid one.
+void Calib_Init(void);
+
+// Converts a GAS_LIGHTING_RESOLUTION bit reading of a channel to the
+// table fixed point unit.
+uint16_t Calib_Convert(uint8_t channel, uint16_t raw);
+
+#endif
@@ -0,0 +1,79 @@
+// Generated by tools/gen_calib.py, do not edit.
+
+#include "calib.h"
+
+#if CALIB_INPUT_BITS != 12 || CALIB_SEGMENT_BITS != 4
+#error "calib_table.c is out of date, run tools/gen_calib.py"
+#endif
+
+const uint16_t calib_gas_table[CALIB_KNOTS] = {  // 0.01 kppm
+	65535, 65535, 65535, 65535, 63000, 50200, 41667, 35571,
+	31000, 27444, 24600, 22273, 20333, 18692, 17286, 16067,
+	15000, 14059, 13222, 12474, 11800, 11190, 10636, 10130,
+	 9667,  9240,  8846,  8481,  8143,  7828,  7533,  7258,
+	 7000,  6758,  6529,  6314,  6111,  5919,  5737,  5564,
+	 5400,  5244,  5095,  4953,  4818,  4689,  4565,  4447,
+	 4333,  4224,  4120,  4020,  3923,  3830,  3741,  3655,
+	 3571,  3491,  3414,  3339,  3267,  3197,  3129,  3063,
+	 3000,  2938,  2879,  2821,  2765,  2710,  2657,  2606,
+	 2556,  2507,  2459,  2413,  2368,  2325,  2282,  2241,
+	 2200,  2160,  2122,  2084,  2048,  2012,  1977,  1943,
+	 1909,  1876,  1844,  1813,  1783,  1753,  1723,  1695,
+	 1667,  1639,  1612,  1586,  1560,  1535,  1510,  1485,
+	 1462,  1438,  1415,  1393,  1370,  1349,  1327,  1306,
+	 1286,  1265,  1246,  1226,  1207,  1188,  1169,  1151,
+	 1133,  1116,  1098,  1081,  1065,  1048,  1032,  1016,
+	 1000,   984,   969,   954,   939,   925,   910,   896,
+	  882,   869,   855,   842,   829,   816,   803,   790,
+	  778,   766,   753,   741,   730,   718,   707,   695,
+	  684,   673,   662,   652,   641,   631,   620,   610,
+	  600,   590,   580,   571,   561,   552,   542,   533,
+	  524,   515,   506,   497,   488,   480,   471,   463,
+	  455,   446,   438,   430,   422,   414,   407,   399,
+	  391,   384,   376,   369,   362,   354,   347,   340,
+	  333,   326,   320,   313,   306,   299,   293,   286,
+	  280,   274,   267,   261,   255,   249,   243,   237,
+	  231,   225,   219,   213,   208,   202,   196,   191,
+	  185,   180,   174,   169,   164,   158,   153,   148,
+	  143,   138,   133,   128,   123,   118,   113,   108,
+	  103,    99,    94,    89,    85,    80,    76,    71,
+	   67,    62,    58,    53,    49,    45,    41,    36,
+	   32,    28,    24,    20,    16,    12,     8,     4,
+	    0
+};
+
+const uint16_t calib_lux_table[CALIB_KNOTS] = {  // 0.1 lux
+	    0,    98,   195,   293,   391,   488,   586,   684,
+	  781,   879,   977,  1074,  1172,  1270,  1367,  1465,
+	 1563,  1660,  1758,  1855,  1953,  2051,  2148,  2246,
+	 2344,  2441,  2539,  2637,  2734,  2832,  2930,  3027,
+	 3125,  3223,  3320,  3418,  3516,  3613,  3711,  3809,
+	 3906,  4004,  4102,  4199,  4297,  4395,  4492,  4590,
+	 4688,  4785,  4883,  4980,  5078,  5176,  5273,  5371,
+	 5469,  5566,  5664,  5762,  5859,  5957,  6055,  6152,
+	 6250,  6348,  6445,  6543,  6641,  6738,  6836,  6934,
+	 7031,  7129,  7227,  7324,  7422,  7520,  7617,  7715,
+	 7813,  7910,  8008,  8105,  8203,  8301,  8398,  8496,
+	 8594,  8691,  8789,  8887,  8984,  9082,  9180,  9277,
+	 9375,  9473,  9570,  9668,  9766,  9863,  9961, 10059,
+	10156, 10254, 10352, 10449, 10547, 10645, 10742, 10840,
+	10938, 11035, 11133, 11230, 11328, 11426, 11523, 11621,
+	11719, 11816, 11914, 12012, 12109, 12207, 12305, 12402,
+	12500, 12598, 12695, 12793, 12891, 12988, 13086, 13184,
+	13281, 13379, 13477, 13574, 13672, 13770, 13867, 13965,
+	14063, 14160, 14258, 14355, 14453, 14551, 14648, 14746,
+	14844, 14941, 15039, 15137, 15234, 15332, 15430, 15527,
+	15625, 15723, 15820, 15918, 16016, 16113, 16211, 16309,
+	16406, 16504, 16602, 16699, 16797, 16895, 16992, 17090,
+	17188, 17285, 17383, 17480, 17578, 17676, 17773, 17871,
+	17969, 18066, 18164, 18262, 18359, 18457, 18555, 18652,
+	18750, 18848, 18945, 19043, 19141, 19238, 19336, 19434,
+	19531, 19629, 19727, 19824, 19922, 20020, 20117, 20215,
+	20313, 20410, 20508, 20606, 20703, 20801, 20898, 20996,
+	21094, 21191, 21289, 21387, 21484, 21582, 21680, 21777,
+	21875, 21973, 22070, 22168, 22266, 22363, 22461, 22559,
+	22656, 22754, 22852, 22949, 23047, 23145, 23242, 23340,
+	23438, 23535, 23633, 23731, 23828, 23926, 24023, 24121,
+	24219, 24316, 24414, 24512, 24609, 24707, 24805, 24902,
+	25000
+};
@@ -0,0 +1,156 @@
+#include "codec.h"
+
+static uint16_t Codec_Zigzag(int16_t d)
+{
+	return ((uint16_t)d << 1) ^ (d < 0 ? 0xFFFF : 0);
+}
+
+static int16_t Codec_Unzigzag(uint16_t z)
+{
+	return (int16_t)((z >> 1) ^ (uint16_t)(0 - (z & 1)));
+}
+
+static uint8_t Codec_Width(uint16_t v)
+{
+	uint8_t w = 0;
+	
+	while (v)
+	{
+		v >>= 1;
+		w++;
+	}
+	return w;
+}
+
+static void Codec_PutBits(struct codec * c, uint16_t v, uint8_t width)
+{
+	while (width)
+	{
+		uint8_t used = c->bit & 7;
+		uint8_t n = 8 - used;
+		uint8_t * p = c->buf + (c->bit >> 3);
+		
+		if (n > width)
+			n = width;
+		if (used == 0)
+			*p = 0;
+		width -= n;
+		*p |= (uint8_t)(((v >> width) & ((1 << n) - 1)) << (8 - used - n));
+		c->bit += n;
+	}
+}
+
+static uint16_t Codec_GetBits(struct codec * c, uint8_t width)
+{
+	uint16_t v = 0;
+	
+	while (width)
+	{
+		uint8_t used = c->bit & 7;
+		uint8_t n = 8 - used;
+		
+		if (n > width)
+			n = width;
+		v = (v << n) | ((c->buf[c->bit >> 3] >> (8 - used - n)) & ((1 << n) - 1));
+		width -= n;
+		c->bit += n;
+	}
+	return v;
+}
+
+void Codec_Init(struct codec * c, uint8_t channels, uint8_t * buf, uint8_t size)
+{
+	uint8_t ch;
+	
+	c->buf = buf;
+	c->size = size;
+	c->bit = 0;
+	c->channels = channels;
+	c->started = 0;
+	for (ch = 0; ch < CODEC_MAX_CHANNELS; ch++)
+		c->prev[ch] = 0;
+}
+
+uint8_t Codec_Put(struct codec * c, const int16_t * samples, uint8_t count)
+{
+	uint16_t z[CODEC_GROUP][CODEC_MAX_CHANNELS];
+	uint8_t width[CODEC_MAX_CHANNELS];
+	uint8_t first = c->started ? 0 : 1;
+	uint16_t bits = first ? 16 * c->channels : 0;
+	uint8_t row, ch;
+	
+	if (count == 0 || count > CODEC_GROUP)
+		return count == 0;
+	
+	for (ch = 0; ch < c->channels; ch++)
+	{
+		int16_t prev = first ? samples[ch] : c->prev[ch];
+		uint16_t any = 0;
+		
+		for (row = first; row < count; row++)
+		{
+			int16_t v = samples[row * c->channels + ch];
+			
+			z[row][ch] = Codec_Zigzag((int16_t)((uint16_t)v - (uint16_t)prev));
+			any |= z[row][ch];
+			prev = v;
+		}
+		width[ch] = Codec_Width(any);
+		if (count > first)
+			bits += CODEC_WIDTH_BITS + (count - first) * width[ch];
+	}
+	
+	if (c->bit + bits > (uint16_t)c->size * 8)
+		return 0;
+	
+	for (ch = 0; ch < c->channels; ch++)
+	{
+		if (first)
+			Codec_PutBits(c, (uint16_t)samples[ch], 16);
+		if (count > first)
+		{
+			Codec_PutBits(c, width[ch], CODEC_WIDTH_BITS);
+			for (row = first; row < count; row++)
+				Codec_PutBits(c, z[row][ch], width[ch]);
+		}
+		c->prev[ch] = samples[(count - 1) * c->channels + ch];
+	}
+	c->started = 1;
+	return 1;
+}
+
+uint8_t Codec_Get(struct codec * c, int16_t * samples, uint8_t count)
+{
+	uint8_t first = c->started ? 0 : 1;
+	uint8_t row, ch;
+	
+	for (ch = 0; ch < c->channels; ch++)
+	{
+		int16_t prev = c->prev[ch];
+		uint8_t width = 0;
+		
+		if (first)
+		{
+			if (c->bit + 16 > (uint16_t)c->size * 8)
+				return 0;
+			prev = (int16_t)Codec_GetBits(c, 16);
+			samples[ch] = prev;
+		}
+		if (count > first)
+		{
+			if (c->bit + CODEC_WIDTH_BITS > (uint16_t)c->size * 8)
+				return 0;
+			width = (uint8_t)Codec_GetBits(c, CODEC_WIDTH_BITS);
+			if (width > 16 || c->bit + (count - first) * width > (uint16_t)c->size * 8)
+				return 0;
+		}
+		for (row = first; row < count; row++)
+		{
+			prev = (int16_t)((uint16_t)prev + (uint16_t)Codec_Unzigzag(Codec_GetBits(c, width)));
+			samples[row * c->channels + ch] = prev;
+		}
+		c->prev[ch] = prev;
+	}
+	c->started = 1;
+	return 1;
+}
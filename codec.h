@@ -0,0 +1,38 @@
+#ifndef _codec_h_
+#define _codec_h_
+
+#include "stm8s.h"
+
+// Packs rows of 16 bit samples, one column per channel. The first row of
+// a stream goes out verbatim, every later sample as the zigzag of its
+// difference to the sample above it. Rows go in groups of up to
+// CODEC_GROUP; per group each channel gets a 5 bit width and then its
+// values in that many bits, most significant bit first.
+
+#define CODEC_GROUP			8
+#define CODEC_MAX_CHANNELS	4
+#define CODEC_WIDTH_BITS	5
+
+struct codec
+{
+	uint8_t * buf;
+	uint8_t size;			// bytes
+	uint16_t bit;			// bits used or consumed
+	uint8_t channels;
+	uint8_t started;
+	int16_t prev[CODEC_MAX_CHANNELS];
+};
+
+void Codec_Init(struct codec * c, uint8_t channels, uint8_t * buf, uint8_t size);
+
+// Appends count rows of samples[row * channels + channel], or nothing at
+// all and returns 0 if they do not fit the buffer.
+uint8_t Codec_Put(struct codec * c, const int16_t * samples, uint8_t count);
+
+// Reads back a group of count rows as it was put, returns 0 if the buffer
+// ends first.
+uint8_t Codec_Get(struct codec * c, int16_t * samples, uint8_t count);
+
+#define Codec_Length(c)		((uint8_t)(((c)->bit + 7) >> 3))
+
+#endif
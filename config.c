@@ -0,0 +1,216 @@
+#include "config.h"
+#include "flash.h"
+#include "one_wire.h"
+#include <string.h>
+
+#define CONFIG_SIZE		((uint16_t)CONFIG_BLOCKS * FLASH_BLOCK_SIZE)
+#define CONFIG_NEXT(b)	((b) + 1 == CONFIG_BLOCKS ? 0 : (b) + 1)
+
+uint16_t config_index[CONFIG_KEYS];
+static uint16_t config_seq[CONFIG_KEYS];
+static uint16_t config_next_seq;
+static uint8_t config_head;			// block being appended to
+static uint16_t config_free;		// offset of the next record
+static uint8_t config_formatted;	// the log holds at least one record
+static uint8_t config_stuck;		// the block after the head is not erased
+
+static uint8_t config_buf[CONFIG_RECORD_SIZE(CONFIG_MAX_DATA)];
+
+// Indexes the records of a block, returns the offset after the last one.
+static uint16_t Config_ScanBlock(uint8_t block)
+{
+	uint16_t offset = (uint16_t)block * FLASH_BLOCK_SIZE;
+	uint16_t end = offset + FLASH_BLOCK_SIZE;
+	
+	while (offset + CONFIG_RECORD_SIZE(0) <= end)
+	{
+		uint8_t key, len, size;
+		uint16_t seq;
+		
+		flash_read_at(offset, (char *)config_buf, CONFIG_HEADER);
+		key = config_buf[0];
+		len = config_buf[1];
+		if (key == 0)
+			break;		// free space, or a record cut short
+		if (len > CONFIG_MAX_DATA || offset + CONFIG_RECORD_SIZE(len) > end)
+			return end;	// not a record, leave the rest of the block alone
+		size = CONFIG_RECORD_SIZE(len);
+		flash_read_at(offset, (char *)config_buf, size);
+		seq = ((uint16_t)config_buf[2] << 8) | config_buf[3];
+		
+		if (key < CONFIG_KEYS && OneWire_crc8(config_buf, CONFIG_HEADER + len) == config_buf[CONFIG_HEADER + len])
+		{
+			if (config_index[key] == CONFIG_NONE || (int16_t)(seq - config_seq[key]) > 0)
+			{
+				config_index[key] = offset;
+				config_seq[key] = seq;
+			}
+			if (!config_formatted || (int16_t)(seq - config_next_seq) >= 0)
+			{
+				// the newest record marks the head block
+				config_formatted = 1;
+				config_next_seq = seq + 1;
+				config_head = block;
+			}
+		}
+		offset += size;
+	}
+	return offset;
+}
+
+static uint8_t Config_Fits(uint8_t len)
+{
+	return config_free + CONFIG_RECORD_SIZE(len) <=
+		((uint16_t)config_head + 1) * FLASH_BLOCK_SIZE;
+}
+
+// data may point into config_buf
+static void Config_Append(uint8_t key, const uint8_t * data, uint8_t len)
+{
+	uint8_t size = CONFIG_RECORD_SIZE(len);
+	
+	memmove(config_buf + CONFIG_HEADER, data, len);
+	config_buf[0] = key;
+	config_buf[1] = len;
+	config_buf[2] = config_next_seq >> 8;
+	config_buf[3] = config_next_seq & 0xFF;
+	config_buf[CONFIG_HEADER + len] = OneWire_crc8(config_buf, CONFIG_HEADER + len);
+	memset(config_buf + CONFIG_HEADER + len + 1, 0, size - CONFIG_HEADER - len - 1);
+	
+	// commit by programming the key after the rest of the record
+	flash_program_at(config_free + 1, (char *)config_buf + 1, size - 1);
+	flash_program_at(config_free, (char *)config_buf, 1);
+	
+	config_index[key] = config_free;
+	config_seq[key] = config_next_seq++;
+	config_free += size;
+}
+
+// Moves the live records of a block to the head and erases it. Returns 0
+// and leaves the block alone if they do not all fit in the head.
+static uint8_t Config_Reclaim(uint8_t block)
+{
+	uint16_t start = (uint16_t)block * FLASH_BLOCK_SIZE;
+	uint16_t need = 0;
+	uint8_t key;
+	
+	for (key = 1; key < CONFIG_KEYS; key++)
+	{
+		uint16_t offset = config_index[key];
+		
+		if (offset == CONFIG_NONE || offset < start || offset >= start + FLASH_BLOCK_SIZE)
+			continue;
+		flash_read_at(offset + 1, (char *)config_buf, 1);
+		need += CONFIG_RECORD_SIZE(config_buf[0]);
+	}
+	if (config_free + need > ((uint16_t)config_head + 1) * FLASH_BLOCK_SIZE)
+		return 0;
+	
+	for (key = 1; key < CONFIG_KEYS; key++)
+	{
+		uint16_t offset = config_index[key];
+		uint8_t len;
+		
+		if (offset == CONFIG_NONE || offset < start || offset >= start + FLASH_BLOCK_SIZE)
+			continue;
+		flash_read_at(offset, (char *)config_buf, CONFIG_HEADER);
+		len = config_buf[1];
+		flash_read_at(offset + CONFIG_HEADER, (char *)config_buf + CONFIG_HEADER, len);
+		Config_Append(key, config_buf + CONFIG_HEADER, len);
+	}
+	flash_erase_block(block);
+	return 1;
+}
+
+// Returns 0 if the block after the head could not be erased, the log is
+// full then.
+static uint8_t Config_NextBlock(void)
+{
+	if (config_stuck)
+		return 0;
+	// the block after the head is erased, append there
+	config_head = CONFIG_NEXT(config_head);
+	config_free = (uint16_t)config_head * FLASH_BLOCK_SIZE;
+	config_stuck = !Config_Reclaim(CONFIG_NEXT(config_head));
+	return 1;
+}
+
+static void Config_Format(void)
+{
+	uint8_t block;
+	
+	for (block = 0; block < CONFIG_BLOCKS; block++)
+		flash_erase_block(block);
+	config_head = 0;
+	config_free = 0;
+	config_next_seq = 1;
+	config_formatted = 1;
+	config_stuck = 0;
+}
+
+uint8_t Config_Init(void)
+{
+	uint8_t block, spare;
+	
+	for (block = 0; block < CONFIG_KEYS; block++)
+		config_index[block] = CONFIG_NONE;
+	config_formatted = 0;
+	config_stuck = 0;
+	
+	for (block = 0; block < CONFIG_BLOCKS; block++)
+		Config_ScanBlock(block);
+	if (!config_formatted)
+		return 0;
+	
+	config_free = Config_ScanBlock(config_head);
+	
+	// finish a move the last reset interrupted
+	spare = CONFIG_NEXT(config_head);
+	flash_read_at((uint16_t)spare * FLASH_BLOCK_SIZE, (char *)config_buf, 1);
+	if (config_buf[0] != 0)
+		config_stuck = !Config_Reclaim(spare);
+	return 1;
+}
+
+uint8_t Config_Read(uint8_t key, void * data, uint8_t len)
+{
+	uint16_t offset;
+	uint8_t n;
+	
+	if (key >= CONFIG_KEYS || (offset = config_index[key]) == CONFIG_NONE)
+		return 0;
+	flash_read_at(offset + 1, (char *)&n, 1);
+	if (n > len)
+		n = len;
+	flash_read_at(offset + CONFIG_HEADER, (char *)data, n);
+	return n;
+}
+
+uint8_t Config_Write(uint8_t key, const void * data, uint8_t len)
+{
+	uint8_t moves;
+	
+	if (key == 0 || key >= CONFIG_KEYS || len > CONFIG_MAX_DATA)
+		return 0;
+	
+	if (config_index[key] != CONFIG_NONE)
+	{
+		flash_read_at(config_index[key] + 1, (char *)config_buf, 1);
+		if (config_buf[0] == len)
+		{
+			flash_read_at(config_index[key] + CONFIG_HEADER, (char *)config_buf, len);
+			if (memcmp(config_buf, data, len) == 0)
+				return 1;
+		}
+	}
+	
+	if (!config_formatted)
+		Config_Format();
+	for (moves = 0; !Config_Fits(len); moves++)
+	{
+		if (moves == CONFIG_BLOCKS || !Config_NextBlock())
+			return 0;
+	}
+	Config_Append(key, (const uint8_t *)data, len);
+	return 1;
+}
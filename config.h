@@ -0,0 +1,55 @@
+#ifndef _config_h_
+#define _config_h_
+
+#include "stm8s.h"
+
+// Append only record log over the data EEPROM blocks. A saved value is a
+// new record at the end of the log, the newest record of a key wins.
+//
+// record: key, len, seq (big endian), data[len], crc8 of the bytes before,
+// padded to the 4 byte EEPROM word
+//
+// The key is programmed last, so a write cut short by a reset reads back
+// as free space. A record never shares a word with the one before, so a
+// torn word program cannot reach back into it. One block after the head
+// is kept erased: when the head block is full the log moves into it,
+// copies the live records out of the block after that and erases it. A
+// block whose live records do not all fit is left whole, and the log
+// does not move on until it has been erased.
+
+// 1.5 KB of data EEPROM on the STM8S207C8
+#ifndef CONFIG_BLOCKS
+#define CONFIG_BLOCKS		12
+#endif
+
+#if CONFIG_BLOCKS < 3
+#error "the log needs a head, a spare and a block to reclaim"
+#endif
+
+#define CONFIG_KEY_ID		1	// struct flash_data
+#define CONFIG_KEY_CALIB	2	// struct calib_record
+#define CONFIG_KEY_BOOT		3	// uint16_t boot count
+#define CONFIG_KEYS			8
+
+#define CONFIG_MAX_DATA		32
+#define CONFIG_HEADER		4
+#define CONFIG_RECORD_SIZE(len)	((CONFIG_HEADER + (len) + 1 + 3) & ~3)
+#define CONFIG_NONE			0xFFFF
+
+// EEPROM offset of the newest record of each key, CONFIG_NONE if unset
+extern uint16_t config_index[CONFIG_KEYS];
+
+// Scans the log and builds the index. Returns 0 if the EEPROM holds no
+// valid record yet; it is formatted by the first Config_Write.
+uint8_t Config_Init(void);
+
+// Copies up to len bytes of the newest value of key, returns the number
+// of bytes copied, 0 if the key was never written.
+uint8_t Config_Read(uint8_t key, void * data, uint8_t len);
+
+// Appends a new value of key, compacting the log when the head block is
+// full. Writing the saved value again does not touch the EEPROM.
+// Returns 0 if the key or length is invalid or the log is full.
+uint8_t Config_Write(uint8_t key, const void * data, uint8_t len);
+
+#endif
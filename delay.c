@@ -1,7 +1,7 @@
 #include "delay.h"
+#include "rs485.h"
 
-__IO unsigned int tick_ms = 0;
-__IO unsigned int delay_count = 0;
+__IO uint32_t tick_ms = 0;
 
 void Delay_Init(void)
 {
@@ -45,8 +45,7 @@ INTERRUPT_HANDLER(TIM4_UPD_OVF_IRQHandler, 23)
  INTERRUPT_HANDLER(TIM3_UPD_OVF_BRK_IRQHandler, 15)
 {
   tick_ms++;
-  if (delay_count)
-    delay_count--;
+  RS485_Tick();
   
   /* Cleat Interrupt Pending bit */
   TIM3_ClearITPendingBit(TIM3_IT_UPDATE);
@@ -54,8 +53,9 @@ INTERRUPT_HANDLER(TIM4_UPD_OVF_IRQHandler, 23)
 
 void Delay(unsigned int ms_time)
 {
-  delay_count = ms_time;
-  while(delay_count);
+  uint32_t start = Millis();
+  while (Millis() - start < ms_time)
+    wfi();
 }
 
 void DelayUs(unsigned int time)
@@ -64,11 +64,31 @@ void DelayUs(unsigned int time)
 	while(time--);
 	rim();
 }
-unsigned int Millis(void)
+
+/* tick_ms is four bytes wide and the ISR may update it between the byte
+   reads, so read until two reads agree */
+uint32_t Millis(void)
 {
-  return tick_ms;
+  uint32_t t;
+  do {
+    t = tick_ms;
+  } while (t != tick_ms);
+  return t;
 }
-unsigned int Micros(void)
+
+/* wraps after 71 minutes, differences are valid up to that */
+uint32_t Micros(void)
 {
-  return tick_ms * 1000 + TIM3_GetCounter();
+  uint32_t t;
+  uint16_t c;
+  uint8_t carry;
+  do {
+    t = tick_ms;
+    c = TIM3_GetCounter();
+    /* the counter rolled over but the update interrupt has not run yet,
+       e.g. when called with interrupts masked; counted outside the
+       loop, tick_ms does not move while masked */
+    carry = TIM3_GetFlagStatus(TIM3_FLAG_UPDATE) == SET && c < 500;
+  } while (t != tick_ms);
+  return (t + carry) * 1000 + c;
 }
\ No newline at end of file
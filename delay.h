@@ -5,9 +5,9 @@
 
 void Delay_Init(void);
 void Delay(unsigned int ms_time);
-unsigned int Millis(void);
+uint32_t Millis(void);
 void DelayUs(unsigned int time);
-unsigned int Micros(void);
+uint32_t Micros(void);
 
 #define delay 		Delay
 #define _delay_ms	Delay
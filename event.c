@@ -0,0 +1,39 @@
+#include "event.h"
+
+#define EVENT_NEXT(i)	((uint8_t)(((i) + 1) & (EVENT_QUEUE_SIZE - 1)))
+
+struct event_queue rs485_events;
+struct event_queue uart_events;
+struct event_queue timer_events;
+struct event_queue adc_events;
+
+uint8_t Event_Post(struct event_queue * q, uint8_t type, uint8_t arg)
+{
+	uint8_t head = q->head;
+	uint8_t next = EVENT_NEXT(head);
+	
+	if (next == q->tail)
+	{
+		q->dropped++;
+		return 0;
+	}
+	if (((next - q->tail) & (EVENT_QUEUE_SIZE - 1)) > q->high)
+		q->high = (next - q->tail) & (EVENT_QUEUE_SIZE - 1);
+	q->type[head] = type;
+	q->arg[head] = arg;
+	// publish only after the slot is written
+	q->head = next;
+	return 1;
+}
+
+uint8_t Event_Get(struct event_queue * q, struct event * ev)
+{
+	uint8_t tail = q->tail;
+	
+	if (tail == q->head)
+		return EVT_NONE;
+	ev->type = q->type[tail];
+	ev->arg = q->arg[tail];
+	q->tail = EVENT_NEXT(tail);
+	return ev->type;
+}
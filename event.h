@@ -0,0 +1,50 @@
+#ifndef _event_h_
+#define _event_h_
+
+#include "stm8s.h"
+
+// Single producer, single consumer event queues from the ISRs to the
+// main loop. The ISR only writes head and the main loop only writes
+// tail, both are one byte so no interrupt masking is needed.
+
+#define EVENT_QUEUE_SIZE	8	// power of 2
+
+/* event type */
+#define EVT_NONE			0x00
+#define EVT_RS485_FRAME		0x01	// arg: ring index of the frame start
+#define EVT_RS485_OVERRUN	0x02	// arg: ring index of the dropped byte
+#define EVT_RS485_TIMEOUT	0x03	// arg: ring index the partial frame ends at
+#define EVT_UART_RX			0x04	// arg: received byte
+#define EVT_ADC_DONE		0x05	// arg: channel with a new decimated reading
+/* event type */
+
+struct event
+{
+	uint8_t type;
+	uint8_t arg;
+};
+
+struct event_queue
+{
+	__IO uint8_t type[EVENT_QUEUE_SIZE];
+	__IO uint8_t arg[EVENT_QUEUE_SIZE];
+	__IO uint8_t head;		// written by the producer
+	__IO uint8_t tail;		// written by the consumer
+	__IO uint8_t dropped;	// events lost on a full queue
+	__IO uint8_t high;		// most events waiting at once
+};
+
+extern struct event_queue rs485_events;		// UART1 RX
+extern struct event_queue uart_events;		// UART3 RX
+extern struct event_queue timer_events;		// TIM3
+extern struct event_queue adc_events;		// ADC2
+
+// Producer side, returns 0 and counts a drop when the queue is full.
+uint8_t Event_Post(struct event_queue * q, uint8_t type, uint8_t arg);
+
+// Consumer side, returns EVT_NONE when the queue is empty.
+uint8_t Event_Get(struct event_queue * q, struct event * ev);
+
+#define Event_Pending(q)	((q)->head != (q)->tail)
+
+#endif
@@ -3,10 +3,8 @@
 
 #define FLASH_WRITE_ADDR FLASH_DATA_START_PHYSICAL_ADDRESS
 
-int flash_write_buffer(char * buff, int size)
+static void flash_unlock(void)
 {
-	int i;
-	
 	/* Define flash programming Time*/
 	FLASH_SetProgrammingTime(FLASH_PROGRAMTIME_STANDARD);
 	
@@ -15,33 +13,125 @@ int flash_write_buffer(char * buff, int size)
 	/* Wait until Data EEPROM area unlocked flag is set*/
 	while (FLASH_GetFlagStatus(FLASH_FLAG_DUL) == RESET)
 	{}
+}
+
+int flash_write_buffer(char * buff, int size)
+{
+	flash_erase_block(0);
+	return flash_program_at(0, buff, size);
+}
+
+int flash_erase_block(unsigned char block)
+{
+	flash_unlock();
 	
-	/* Erase block 0 and verify it */
+	/* Erase the block and verify it */
 	/* This function is executed from RAM */
-	FLASH_EraseBlock(0, FLASH_MEMTYPE_DATA);
+	FLASH_EraseBlock(block, FLASH_MEMTYPE_DATA);
 	
 	/* Wait until End of high voltage flag is set*/
 	while (FLASH_GetFlagStatus(FLASH_FLAG_HVOFF) == RESET)
 	{}
 	
-	for (i = 0; i < size; i++)
+	FLASH_Lock(FLASH_MEMTYPE_DATA);
+	return 0;
+}
+
+int flash_program_at(unsigned int offset, const char * buff, int size)
+{
+	uint32_t addr = FLASH_WRITE_ADDR + offset;
+	uint8_t unlocked = 0;
+	
+	// Walk the 4 byte EEPROM words the range touches. Each program cycle
+	// erases and rewrites a whole word, so unchanged words are skipped, a
+	// single changed byte is programmed alone and anything more goes in
+	// one word cycle merged with the current contents.
+	while (size > 0)
 	{
-		FLASH_ProgramByte(FLASH_WRITE_ADDR + i, buff[i]);
-		/* Wait until End of high voltage flag is set*/
-		while (FLASH_GetFlagStatus(FLASH_FLAG_EOP) == RESET)
-		{}
+		uint32_t word = addr & ~(uint32_t)3;
+		uint8_t cur[4], val[4];
+		uint8_t i, changed = 0, last = 0;
+		
+		for (i = 0; i < 4; i++)
+		{
+			cur[i] = val[i] = FLASH_ReadByte(word + i);
+			if (word + i >= addr && size > (int)(word + i - addr))
+			{
+				val[i] = buff[word + i - addr];
+				if (val[i] != cur[i])
+				{
+					changed++;
+					last = i;
+				}
+			}
+		}
+		
+		if (changed)
+		{
+			if (!unlocked)
+			{
+				flash_unlock();
+				unlocked = 1;
+			}
+			if (changed == 1)
+				FLASH_ProgramByte(word + last, val[last]);
+			else
+				FLASH_ProgramWord(word, ((uint32_t)val[0] << 24) | ((uint32_t)val[1] << 16) |
+								  ((uint32_t)val[2] << 8) | val[3]);
+			/* Wait until End of high voltage flag is set*/
+			while (FLASH_GetFlagStatus(FLASH_FLAG_EOP) == RESET)
+			{}
+		}
+		
+		size -= (int)(word + 4 - addr);
+		buff += word + 4 - addr;
+		addr = word + 4;
 	}
 	
-	FLASH_Lock(FLASH_MEMTYPE_DATA);
+	if (unlocked)
+		FLASH_Lock(FLASH_MEMTYPE_DATA);
+	return 0;
+}
+
+int flash_write_prog_block(unsigned int block, char * buff)
+{
+	FLASH_SetProgrammingTime(FLASH_PROGRAMTIME_STANDARD);
+	
+	FLASH_Unlock(FLASH_MEMTYPE_PROG);
+	/* Wait until Flash Program area unlocked flag is set*/
+	while (FLASH_GetFlagStatus(FLASH_FLAG_PUL) == RESET)
+	{}
+	
+	/* Erase and program the block in one cycle */
+	/* These functions are executed from RAM */
+	FLASH_ProgramBlock(block, FLASH_MEMTYPE_PROG, FLASH_PROGRAMMODE_STANDARD, (uint8_t *)buff);
+	FLASH_WaitForLastOperation(FLASH_MEMTYPE_PROG);
+	
+	FLASH_Lock(FLASH_MEMTYPE_PROG);
+	return 0;
+}
+
+int flash_read_prog(unsigned long addr, char * buff, int size)
+{
+	int i;
+	for (i = 0; i < size; i++)
+	{
+		buff[i] = FLASH_ReadByte(addr + i);
+	}
 	return 0;
 }
 
 int flash_read_buffer(char * buff, int size)
+{
+	return flash_read_at(0, buff, size);
+}
+
+int flash_read_at(unsigned int offset, char * buff, int size)
 {
 	int i;
 	for (i = 0; i < size; i++)
 	{
-		buff[i] = FLASH_ReadByte(FLASH_WRITE_ADDR + i);
+		buff[i] = FLASH_ReadByte(FLASH_WRITE_ADDR + offset + i);
 	}
 	return 0;
 }
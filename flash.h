@@ -6,7 +6,17 @@ struct flash_data
   unsigned char id;
 };
 
+// Offsets are relative to the start of data EEPROM.
 int flash_write_buffer(char * buff, int size);
 int flash_read_buffer(char * buff, int size);
+int flash_read_at(unsigned int offset, char * buff, int size);
+// Programs only the words that change, see host/eeprom_verify.c.
+int flash_program_at(unsigned int offset, const char * buff, int size);
+int flash_erase_block(unsigned char block);
+
+// Program flash, block counts from FLASH_PROG_START_PHYSICAL_ADDRESS. The
+// block write runs from RAM, build with RAM_EXECUTION.
+int flash_write_prog_block(unsigned int block, char * buff);
+int flash_read_prog(unsigned long addr, char * buff, int size);
 
 #endif
@@ -1,6 +1,24 @@
 #include "gas_lighting.h"
+#include "calib.h"
 
-__IO uint16_t Conversion_Value = 0;
+#if GAS_LIGHTING_OVERSAMPLE_BITS > 3
+#error "GAS_LIGHTING_OVERSAMPLE_BITS too large for the 16 bit accumulator"
+#endif
+
+// channel number of the conversion running now, toggled by the ISR
+__IO uint8_t adc_channel = GAS_CHANNEL;
+
+// per channel accumulator and sample count of the current decimation
+uint16_t adc_acc[2];
+uint8_t adc_count[2];
+#if GAS_LIGHTING_MEDIAN3
+uint16_t adc_hist[2][2];
+#endif
+
+// decimated results, written by the ISR only
+__IO uint16_t adc_result[2];
+
+static const uint8_t adc_hw_channel[2] = {ADC2_CHANNEL_9, ADC2_CHANNEL_8};
 
 int GasLighting_Init(void)
 {
@@ -11,59 +29,47 @@ int GasLighting_Init(void)
 	/* De-Init ADC peripheral*/
 	ADC2_DeInit();
 	
-	/* Init ADC2 peripheral */
+	/* Init ADC2 peripheral, conversions are started by TIM1 TRGO */
 	ADC2_Init(ADC2_CONVERSIONMODE_SINGLE, ADC2_CHANNEL_9, ADC2_PRESSEL_FCPU_D2, \
-		ADC2_EXTTRIG_TIM, DISABLE, ADC2_ALIGN_RIGHT, ADC2_SCHMITTTRIG_CHANNEL9,\
+		ADC2_EXTTRIG_TIM, ENABLE, ADC2_ALIGN_RIGHT, ADC2_SCHMITTTRIG_CHANNEL9,\
 			DISABLE);
+	ADC2_SchmittTriggerConfig(ADC2_SCHMITTTRIG_CHANNEL8, DISABLE);
+	adc_channel = GAS_CHANNEL;
+	
+	/* Enable end of conversion interrupt */
+	ADC2_ITConfig(ENABLE);
+	
+	/* TIM1 configuration:
+	- TIM1 counter clock is 16 MHz / 16 = 1 MHz
+	- the update event is routed to TRGO and starts one ADC2 conversion */
+	TIM1_DeInit();
+	TIM1_TimeBaseInit(15, TIM1_COUNTERMODE_UP, 1000000 / GAS_LIGHTING_SAMPLE_RATE - 1, 0);
+	TIM1_SelectOutputTrigger(TIM1_TRGOSOURCE_UPDATE);
+	TIM1_Cmd(ENABLE);
 	
-	/*Start Conversion */
-	ADC2_StartConversion();
-	while (ADC2_GetFlagStatus() == RESET);
-	Conversion_Value = ADC2_GetConversionValue();
-	ADC2_ClearFlag();
+	enableInterrupts();
 	return 0;
 }
 
-float GasLighting_GetGas(void)
+uint16_t GasLighting_GetRaw(uint8_t channel)
 {
-	/* De-Init ADC peripheral*/
-	ADC2_DeInit();
+	uint16_t value;
 	
-	/* Init ADC2 peripheral */
-	ADC2_Init(ADC2_CONVERSIONMODE_SINGLE, ADC2_CHANNEL_9, ADC2_PRESSEL_FCPU_D2, \
-		ADC2_EXTTRIG_TIM, DISABLE, ADC2_ALIGN_RIGHT, ADC2_SCHMITTTRIG_CHANNEL9,\
-			DISABLE);
-	/*Start Conversion */
-	ADC2_StartConversion();
-	while (ADC2_GetFlagStatus() == RESET);
-	Conversion_Value = ADC2_GetConversionValue();
-	ADC2_ClearFlag();
-//  res = Conversion_Value * 5 / 1024;
-//  res = (5 - res) * 10000 / res;
-//  res = 1024/Conversion_Value - 1;
-	return 10240.0/Conversion_Value - 10.0;
+	// the ISR may update the result between the two byte reads, so
+	// read until two reads agree instead of masking interrupts
+	do {
+		value = adc_result[channel];
+	} while (value != adc_result[channel]);
+	return value;
+}
+
+float GasLighting_GetGas(void)
+{
+	return Calib_Convert(GAS_CHANNEL, GasLighting_GetRaw(GAS_CHANNEL)) * (1.0 / CALIB_GAS_SCALE);
 }
 float GasLighting_GetLighting(void)
 {
-	/* De-Init ADC peripheral*/
-	ADC2_DeInit();
-	
-	/* Init ADC2 peripheral */
-	ADC2_Init(ADC2_CONVERSIONMODE_SINGLE, ADC2_CHANNEL_8, ADC2_PRESSEL_FCPU_D2, \
-		ADC2_EXTTRIG_TIM, DISABLE, ADC2_ALIGN_RIGHT, ADC2_SCHMITTTRIG_CHANNEL8,\
-			DISABLE);
-	
-	/*Start Conversion */
-	ADC2_StartConversion();
-	while (ADC2_GetFlagStatus() == RESET);
-	Conversion_Value = ADC2_GetConversionValue();
-	ADC2_ClearFlag();
-	
-	// 1lux - 0.002V
-	// 1000lux - 2v
-	// x = 2.44141 * ADC value
-	// RL = 10K
-	return Conversion_Value * 2.44141;
+	return Calib_Convert(LIGHTING_CHANNEL, GasLighting_GetRaw(LIGHTING_CHANNEL)) * (1.0 / CALIB_LUX_SCALE);
 }
 
 /**
@@ -73,8 +79,32 @@ float GasLighting_GetLighting(void)
 */
 INTERRUPT_HANDLER(ADC2_IRQHandler, 22)
 {
-	/* Get converted value */
-	//    Conversion_Value = ADC2_GetConversionValue();
+	uint8_t ch = adc_channel;
+	uint16_t value = ADC2_GetConversionValue();
 	
-	ADC2_ClearITPendingBit();
-}
\ No newline at end of file
+	/* Next trigger converts the other channel, writing CSR also clears EOC */
+	adc_channel = ch ^ 1;
+	ADC2->CSR = (uint8_t)((ADC2->CSR & (uint8_t)~(ADC2_CSR_CH | ADC2_CSR_EOC)) \
+		| adc_hw_channel[ch ^ 1]);
+	
+#if GAS_LIGHTING_MEDIAN3
+	{
+		uint16_t a = adc_hist[ch][0], b = adc_hist[ch][1], m = value;
+		adc_hist[ch][0] = b;
+		adc_hist[ch][1] = value;
+		// median of a, b and the new value
+		if ((a <= b) == (b <= m)) m = b;
+		else if ((b <= a) == (a <= m)) m = a;
+		value = m;
+	}
+#endif
+	
+	adc_acc[ch] += value;
+	if (++adc_count[ch] == GAS_LIGHTING_OVERSAMPLE)
+	{
+		adc_result[ch] = adc_acc[ch] >> GAS_LIGHTING_OVERSAMPLE_BITS;
+		Event_Post(&adc_events, EVT_ADC_DONE, ch);
+		adc_acc[ch] = 0;
+		adc_count[ch] = 0;
+	}
+}
@@ -2,9 +2,41 @@
 #define _gas_lighting_h_
 
 #include "stm8s.h"
+#include "event.h"
+
+// ADC2 is triggered by TIM1 TRGO at this rate and alternates between
+// the gas (channel 9) and lighting (channel 8) inputs, so each channel
+// is sampled at half of it.
+#ifndef GAS_LIGHTING_SAMPLE_RATE
+#define GAS_LIGHTING_SAMPLE_RATE	1000
+#endif
+
+// Extra bits of resolution gained by oversample-and-decimate. Each
+// extra bit costs 4x the samples: 2 gives 16 samples per result and
+// 12 bit readings.
+#ifndef GAS_LIGHTING_OVERSAMPLE_BITS
+#define GAS_LIGHTING_OVERSAMPLE_BITS	2
+#endif
+
+// Set to 1 to pass every sample through a median-of-3 filter before it
+// is accumulated, so a single spike cannot move the result.
+#ifndef GAS_LIGHTING_MEDIAN3
+#define GAS_LIGHTING_MEDIAN3	1
+#endif
+
+#define GAS_LIGHTING_OVERSAMPLE		(1 << (2 * GAS_LIGHTING_OVERSAMPLE_BITS))
+#define GAS_LIGHTING_RESOLUTION		(10 + GAS_LIGHTING_OVERSAMPLE_BITS)
+#define GAS_LIGHTING_FULL_SCALE		(1 << GAS_LIGHTING_RESOLUTION)
+
+#define GAS_CHANNEL			0
+#define LIGHTING_CHANNEL	1
 
 int GasLighting_Init(void);
 
+// Returns the latest decimated reading of a channel, GAS_LIGHTING_RESOLUTION bits.
+uint16_t GasLighting_GetRaw(uint8_t channel);
+// Each new decimated reading posts EVT_ADC_DONE with the channel to adc_events.
+
 float GasLighting_GetGas(void);
 float GasLighting_GetLighting(void);
 
@@ -0,0 +1,102 @@
+#include <math.h>
+#include "adaptive.h"
+
+void Adaptive_Plan(struct poller_port * port)
+{
+	double total = port->budget * 1e9 / port->poll_cost;	// polls per second the budget allows
+	double weight[POLLER_MAX_NODES], left, sum, rate;
+	uint8_t floor[POLLER_MAX_NODES];
+	int i, changed;
+
+	for (i = 0; i < port->nodes; i++)
+	{
+		struct poller_node * node = &port->node[i];
+
+		weight[i] = sqrt(node->readings < 2 ? ADAPTIVE_UNKNOWN : node->change) + 1e-9;
+		floor[i] = 0;
+	}
+	// nodes that would get less than min_rate get that, the rest share what is left
+	do
+	{
+		left = total;
+		sum = 0;
+		for (i = 0; i < port->nodes; i++)
+		{
+			if (floor[i])
+				left -= port->min_rate;
+			else
+				sum += weight[i];
+		}
+		changed = 0;
+		for (i = 0; i < port->nodes; i++)
+			if (!floor[i] && (left <= 0 || left * weight[i] / sum < port->min_rate))
+			{
+				floor[i] = 1;
+				changed = 1;
+			}
+	} while (changed);
+
+	for (i = 0; i < port->nodes; i++)
+	{
+		rate = floor[i] ? port->min_rate : left * weight[i] / sum;
+		if (rate <= 0)
+			rate = 1e-3;
+		port->node[i].interval = (uint64_t)(1e9 / rate);
+	}
+}
+
+void Adaptive_Reading(struct poller_port * port, struct poller_node * node, uint64_t now)
+{
+	double d = node->value - node->prev, dt, sample;
+
+	if (node->readings > 0 && now > node->last)
+	{
+		dt = (now - node->last) / 1e9;
+		sample = d * d / dt;
+		if (node->readings < 2)
+			node->change = (float)sample;
+		else
+			node->change += (float)((sample - node->change) / ADAPTIVE_WEIGHT);
+	}
+	if (node->readings < 255)
+		node->readings++;
+	Adaptive_Plan(port);
+}
+
+int Adaptive_Next(struct poller_port * port, uint64_t now, uint64_t * at)
+{
+	double overdue, most = -1;
+	uint64_t due, earliest = UINT64_MAX;
+	int i, best = 0, first = 0;
+
+	for (i = 0; i < port->nodes; i++)
+	{
+		struct poller_node * node = &port->node[i];
+
+		if (node->asked == 0)
+		{
+			// never asked
+			*at = now;
+			return i;
+		}
+		due = node->asked + node->interval;
+		if (due < earliest)
+		{
+			earliest = due;
+			first = i;
+		}
+		overdue = (double)(now - node->asked) / node->interval;
+		if (overdue > most)
+		{
+			most = overdue;
+			best = i;
+		}
+	}
+	if (most >= 1)
+	{
+		*at = now;
+		return best;
+	}
+	*at = earliest;
+	return first;
+}
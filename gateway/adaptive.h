@@ -0,0 +1,31 @@
+#ifndef _adaptive_h_
+#define _adaptive_h_
+
+#include <stdint.h>
+#include "poller.h"
+
+// Adaptive poll scheduling for a port with port->budget set. Each node
+// keeps a running estimate of how fast its reading moves, the mean of
+// squared change per second. For readings that wander like a random
+// walk, the error of a held value is smallest for a given number of polls
+// when each node is polled in proportion to the square root of that
+// rate, so the port's budget of polls per second is shared out that way.
+// Every node keeps at least port->min_rate. A node is due one interval
+// after it was last asked, and the most overdue node goes first. When
+// no node is due the port stays idle, which keeps the bus within its
+// budget.
+
+#define ADAPTIVE_WEIGHT		8		// readings in the running estimates
+#define ADAPTIVE_UNKNOWN	1e6f	// rate of a node not read twice yet, polled often to learn it
+
+// Takes in node->value, read at now, with node->prev and node->last the
+// reading before and its time.
+void Adaptive_Reading(struct poller_port * port, struct poller_node * node, uint64_t now);
+
+// The node to ask next and, in at, when; at <= now means at once.
+int Adaptive_Next(struct poller_port * port, uint64_t now, uint64_t * at);
+
+// Shares the budget out again, after a change of budget or costs.
+void Adaptive_Plan(struct poller_port * port);
+
+#endif
@@ -0,0 +1,360 @@
+// Gateway daemon: polls SenseHost nodes with CMD_QUERY on several RS485
+// ports at once, from one epoll loop, and writes the readings out.
+//
+//   ./gatewayd -p /dev/ttyUSB0:115200:91-98 -p /dev/ttyUSB1:57600:91-94
+//   ./gatewayd -S 2 -n 8 -t 10      against stand-in segments on ptys
+//
+//   -p  a port: tty, baud rate and the range of ids on it, in hex
+//   -S  runs this many stand-in segments (standin.h) and polls those
+//   -n  nodes on each stand-in segment
+//   -T  turnaround in us, the quiet time each node gets after its reply
+//   -w  ms to wait for the first byte of a reply
+//   -a  polls by rate of change (adaptive.h) within this fraction of
+//       bus time, instead of in turn as fast as the bus goes
+//   -m  polls per second every node gets at least with -a, 0.2 by default
+//   -r  seconds between the reports of polls per second, on stderr
+//   -t  stops after this many seconds, otherwise on SIGINT or SIGTERM
+//   -o  keeps the readings in the store (store.h) in this directory too,
+//       as series port index * 256 + id
+//   -q  no readings
+//
+// A reading is one line on stdout: unix time, port, id and temperature.
+// The time is the wall clock held from going back, so that a step back
+// by NTP does not make the store refuse the readings until it catches
+// up. Every report gives each port's polls per second, timeouts, bad
+// replies, stray bytes and readings the store refused or failed to
+// write; the end adds each node's count and latency. With -S it fails
+// if a port got no reading or one was not stored.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include "poller.h"
+#include "serial.h"
+#include "standin.h"
+#include "store.h"
+#include "packet.h"
+
+#define MAX_PORTS		16
+#define EV_PORT(i)		(2 * (i))
+#define EV_TIMER(i)		(2 * (i) + 1)
+#define EV_REPORT		(2 * MAX_PORTS)
+#define EV_SIGNAL		(2 * MAX_PORTS + 1)
+
+struct port_total
+{
+	unsigned long polls, timeouts, bad, stray, unstored;
+	uint32_t unstored_now;		// since the last report
+};
+
+static struct poller_port ports[MAX_PORTS];
+static struct port_total totals[MAX_PORTS];
+static int ports_n;
+static char standin_names[MAX_PORTS][64];
+static pid_t standin_pid[MAX_PORTS];
+static int quiet;
+static struct store * store;
+
+// ms since the epoch, never before the time it returned last
+static int64_t Stamp(void)
+{
+	static int64_t last;
+	struct timespec ts;
+	int64_t ms;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ms = ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+	if (ms < last)
+		ms = last;
+	last = ms;
+	return ms;
+}
+
+static void On_Reading(struct poller_port * port, struct poller_node * node, uint64_t now)
+{
+	int64_t ms = Stamp();
+
+	(void)now;
+	if (store && Store_Append(store, STORE_SERIES((port - ports) << 8 | node->id, STORE_TEMPERATURE), ms,
+							  node->value) < 0)
+		totals[port - ports].unstored_now++;
+	if (quiet)
+		return;
+	printf("%lld.%03d %s %02x %.3f\n", (long long)(ms / 1000), (int)(ms % 1000), port->path, node->id,
+		   node->value);
+}
+
+// tty:baud:first-last, ids in hex
+static int Parse_Port(char * spec)
+{
+	struct poller_port * port;
+	char * baud, * ids, * last;
+	long first, end, id;
+
+	if (ports_n == MAX_PORTS)
+		return -1;
+	baud = strchr(spec, ':');
+	ids = baud ? strchr(baud + 1, ':') : NULL;
+	if (ids == NULL)
+		return -1;
+	*baud++ = 0;
+	*ids++ = 0;
+	first = strtol(ids, &last, 16);
+	end = *last == '-' ? strtol(last + 1, NULL, 16) : first;
+	if (first < 1 || end > 0xFE || end < first || end - first >= POLLER_MAX_NODES)
+		return -1;
+	port = &ports[ports_n++];
+	port->path = spec;
+	port->baud = (uint32_t)atol(baud);
+	for (id = first; id <= end; id++)
+		Poller_AddNode(port, (uint8_t)id);
+	return 0;
+}
+
+static int Spawn_Standins(int segments, int nodes)
+{
+	struct standin cfg = {DEV_MY_THESIS + 1, 0, 115200, 300, 0};
+	int i, fd;
+
+	cfg.count = (uint8_t)nodes;
+	for (i = 0; i < segments && ports_n < MAX_PORTS; i++)
+	{
+		fd = Standin_Open(&cfg, standin_names[i], sizeof (standin_names[i]));
+		if (fd < 0)
+			return -1;
+		standin_pid[i] = fork();
+		if (standin_pid[i] == 0)
+		{
+			Standin_Serve(fd, &cfg);
+			_exit(0);
+		}
+		close(fd);
+		snprintf(standin_names[i] + strlen(standin_names[i]), sizeof (standin_names[i]) - strlen(standin_names[i]),
+				 ":%lu:%x-%x",
+				 (unsigned long)cfg.baud, cfg.first, cfg.first + nodes - 1);
+		if (Parse_Port(standin_names[i]) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+// Adds the counts to the totals, and prints them if print is set.
+static void Report(uint64_t now, int print)
+{
+	int i;
+
+	for (i = 0; i < ports_n; i++)
+	{
+		struct poller_port * port = &ports[i];
+		struct port_total * t = &totals[i];
+		uint32_t timeouts = port->timeouts, bad = port->bad, stray = port->stray;
+		uint32_t polls = port->polls, unstored = t->unstored_now;
+		double rate;
+
+		t->polls += polls;
+		t->timeouts += timeouts;
+		t->bad += bad;
+		t->stray += stray;
+		t->unstored += unstored;
+		t->unstored_now = 0;
+		rate = Poller_Report(port, now);
+		if (print)
+			fprintf(stderr, "%s: %.0f polls/s, %u timeouts, %u bad, %u stray, %u not stored\n", port->path, rate,
+					timeouts, bad, stray, unstored);
+	}
+}
+
+static void Summary(double seconds)
+{
+	int i, j;
+
+	for (i = 0; i < ports_n; i++)
+	{
+		fprintf(stderr, "%s at %lu baud: %lu polls, %.0f polls/s, %lu timeouts, %lu bad, %lu stray, %lu not stored\n",
+				ports[i].path, (unsigned long)ports[i].baud, totals[i].polls,
+				seconds > 0 ? totals[i].polls / seconds : 0.0, totals[i].timeouts, totals[i].bad,
+				totals[i].stray, totals[i].unstored);
+		for (j = 0; j < ports[i].nodes; j++)
+		{
+			struct poller_node * node = &ports[i].node[j];
+
+			fprintf(stderr, "  %02x: %u polls, %u timeouts, %u bad, latency %.0f us\n", node->id,
+					node->polls, node->timeouts, node->bad, node->latency / 1e3);
+		}
+	}
+}
+
+static int Add(int ep, int fd, uint32_t tag)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN;
+	ev.data.u32 = tag;
+	return epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int main(int argc, char * argv[])
+{
+	struct epoll_event ev[64];
+	struct itimerspec its;
+	sigset_t mask;
+	uint64_t now, start, turnaround = POLLER_TURNAROUND, timeout = POLLER_TIMEOUT;
+	double report = 1, seconds = 0, budget = 0, min_rate = 0.2;
+	const char * store_dir = NULL;
+	int segments = 0, nodes = 4, running = 1, failed = 0, bad = 0;
+	int ep, report_fd, signal_fd, i, j, n, opt;
+
+	while ((opt = getopt(argc, argv, "p:S:n:T:w:a:m:r:t:o:q")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p':
+			if (Parse_Port(optarg) < 0)
+			{
+				fprintf(stderr, "gatewayd: bad port %s, expected tty:baud:first-last\n", optarg);
+				return 2;
+			}
+			break;
+		case 'S':
+			segments = atoi(optarg);
+			break;
+		case 'n':
+			nodes = atoi(optarg);
+			break;
+		case 'T':
+			turnaround = atol(optarg) * 1000ULL;
+			break;
+		case 'w':
+			timeout = atol(optarg) * 1000000ULL;
+			break;
+		case 'a':
+			budget = atof(optarg);
+			break;
+		case 'm':
+			min_rate = atof(optarg);
+			break;
+		case 'r':
+			report = atof(optarg);
+			break;
+		case 't':
+			seconds = atof(optarg);
+			break;
+		case 'o':
+			store_dir = optarg;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			bad = 1;
+			break;
+		}
+	}
+	if (bad || nodes < 1 || nodes > POLLER_MAX_NODES || report <= 0 || budget < 0 || budget > 1 || min_rate <= 0)
+		ports_n = segments = 0;
+	if (segments && Spawn_Standins(segments, nodes) < 0)
+	{
+		perror("gatewayd: stand-in");
+		return 1;
+	}
+	if (ports_n == 0)
+	{
+		fprintf(stderr, "usage: %s [-p tty:baud:first-last]... [-S segments [-n nodes]] [-T us] [-w ms]\n"
+				"       [-a budget [-m polls/s]] [-r s] [-t s] [-o dir] [-q]\n", argv[0]);
+		return 2;
+	}
+
+	if (store_dir && (store = Store_Open(store_dir)) == NULL)
+	{
+		perror(store_dir);
+		return 1;
+	}
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	signal_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+	ep = epoll_create1(EPOLL_CLOEXEC);
+	report_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	memset(&its, 0, sizeof (its));
+	its.it_value.tv_sec = (time_t)report;
+	its.it_value.tv_nsec = (long)((report - (time_t)report) * 1e9);
+	its.it_interval = its.it_value;
+	timerfd_settime(report_fd, 0, &its, NULL);
+	Add(ep, report_fd, EV_REPORT);
+	Add(ep, signal_fd, EV_SIGNAL);
+
+	start = Serial_Now();
+	for (i = 0; i < ports_n; i++)
+	{
+		ports[i].on_reading = On_Reading;
+		ports[i].budget = (float)budget;
+		ports[i].min_rate = (float)min_rate;
+		if (Poller_Open(&ports[i]) < 0)
+		{
+			perror(ports[i].path);
+			return 1;
+		}
+		for (j = 0; j < ports[i].nodes; j++)
+		{
+			ports[i].node[j].turnaround = turnaround;
+			ports[i].node[j].timeout = timeout;
+		}
+		Add(ep, ports[i].fd, EV_PORT(i));
+		Add(ep, ports[i].timer, EV_TIMER(i));
+		Poller_Start(&ports[i], start);
+	}
+
+	while (running)
+	{
+		n = epoll_wait(ep, ev, 64, 100);
+		now = Serial_Now();
+		for (i = 0; i < n; i++)
+		{
+			uint32_t tag = ev[i].data.u32;
+
+			if (tag == EV_REPORT)
+			{
+				uint64_t expirations;
+
+				if (read(report_fd, &expirations, sizeof (expirations)) > 0)
+					Report(now, 1);
+			}
+			else if (tag == EV_SIGNAL)
+				running = 0;
+			else if (tag & 1)
+				Poller_Timer(&ports[tag / 2], now);
+			else
+				Poller_Readable(&ports[tag / 2], now);
+		}
+		if (seconds > 0 && now - start >= (uint64_t)(seconds * 1e9))
+			running = 0;
+		fflush(stdout);
+	}
+
+	now = Serial_Now();
+	Report(now, 0);
+	Summary((now - start) / 1e9);
+	for (i = 0; i < ports_n; i++)
+	{
+		Poller_Close(&ports[i]);
+		if (segments && (totals[i].polls == 0 || totals[i].unstored))
+			failed = 1;
+	}
+	if (store)
+		Store_Close(store);
+	for (i = 0; i < segments; i++)
+	{
+		kill(standin_pid[i], SIGTERM);
+		waitpid(standin_pid[i], NULL, 0);
+	}
+	return failed;
+}
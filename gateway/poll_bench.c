@@ -0,0 +1,214 @@
+// What adaptive polling (adaptive.h) buys over polling in turn, on a
+// simulated bus in virtual time: the same nodes and the same budget of
+// bus time, with polls in turn at a fixed rate against polls shared out
+// by rate of change.
+//
+//   ./poll_bench [-n nodes] [-u budget] [-m min rate] [-T seconds] [-b baud] [-s seed]
+//
+// Each node reads a temperature that wanders like a random walk, in
+// steps of the DS18B20's 1/16 C. A quarter of the nodes move fast, the
+// rest hardly at all, and halfway through the fast quarter moves to
+// other nodes. A poll costs the bus a query, a reply, the node's reply
+// delay and the turnaround.
+//
+// The error is that of the gateway's last reading against the true
+// temperature, sampled every GRID_MS over every node. A reading carries
+// 0.5 log2(1 + change^2 / q) bits, where q is the variance of the 1/16 C
+// rounding: a reading that tells nothing new is worth close to nothing.
+// Bits per byte is those bits over the bytes on the bus. The bench fails
+// if adaptive polling gives no more bits per byte, or if some node went
+// longer than 1 / min rate without a reading.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "poller.h"
+#include "adaptive.h"
+#include "serial.h"
+#include "packet.h"
+
+#define GRID_MS			10
+#define POLL_BYTES		13			// query and reply
+#define REPLY_DELAY		300000		// ns from the query to the reply, as the stand-in
+#define FAST_STEP		0.2			// C per sqrt(s)
+#define SLOW_STEP		0.005
+#define STEP_C			(1.0 / 16)
+
+struct result
+{
+	unsigned long polls, bytes;
+	double error, bits;
+	uint64_t max_gap;
+};
+
+static int nodes = 16;
+static double budget = 0.2, min_rate = 0.5, seconds = 600;
+static uint32_t baud = 115200;
+static uint64_t seed = 1, rng;
+
+static double truth[POLLER_MAX_NODES];
+
+static double Uniform(void)
+{
+	// xorshift64
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return ((rng >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static double Normal(void)
+{
+	return sqrt(-2 * log(Uniform())) * cos(2 * M_PI * Uniform());
+}
+
+static int Fast(int k, uint64_t t)
+{
+	int quarter = nodes / 4 ? nodes / 4 : 1;
+
+	if (t < (uint64_t)(seconds * 1e9 / 2))
+		return k < quarter;
+	return k >= nodes - quarter;
+}
+
+static void Run(struct result * r, int adaptive)
+{
+	static struct poller_port port;
+	struct poller_node * node;
+	uint64_t byte_time = Serial_ByteTime(baud);
+	uint64_t cost = POLL_BYTES * byte_time + REPLY_DELAY + POLLER_TURNAROUND;
+	uint64_t interval = (uint64_t)(cost / budget);
+	uint64_t t = 1000000000, end = t + (uint64_t)(seconds * 1e9), grid = t, at = t, bus_free = t, done;
+	double q = STEP_C * STEP_C / 12, dt = GRID_MS / 1e3, change;
+	unsigned long ticks = 0;
+	int k, i, turn = 0;
+
+	memset(r, 0, sizeof (*r));
+	memset(&port, 0, sizeof (port));
+	port.byte_time = byte_time;
+	port.poll_cost = cost;
+	port.budget = adaptive ? (float)budget : 0;
+	port.min_rate = (float)min_rate;
+	for (i = 0; i < nodes; i++)
+	{
+		Poller_AddNode(&port, DEV_MY_THESIS + 1 + i);
+		truth[i] = 20;
+		port.node[i].value = 20;
+	}
+	if (adaptive)
+		Adaptive_Plan(&port);
+	rng = seed;
+
+	while (t < end)
+	{
+		if (adaptive)
+		{
+			k = Adaptive_Next(&port, bus_free, &at);
+			if (at < bus_free)
+				at = bus_free;
+		}
+		else
+		{
+			k = turn++ % nodes;
+			at = at + interval > bus_free ? at + interval : bus_free;
+		}
+		// the reading is what the sensor held when the reply was made
+		done = at + cost - POLLER_TURNAROUND;
+		for (; grid + GRID_MS * 1000000ULL <= done; grid += GRID_MS * 1000000ULL)
+		{
+			for (i = 0; i < nodes; i++)
+			{
+				truth[i] += (Fast(i, grid) ? FAST_STEP : SLOW_STEP) * sqrt(dt) * Normal();
+				r->error += (truth[i] - port.node[i].value) * (truth[i] - port.node[i].value);
+			}
+			ticks++;
+		}
+
+		node = &port.node[k];
+		node->asked = at;
+		node->prev = node->value;
+		node->value = (float)(floor(truth[k] / STEP_C + 0.5) * STEP_C);
+		change = node->value - node->prev;
+		r->bits += 0.5 * log2(1 + change * change / q);
+		r->polls++;
+		r->bytes += POLL_BYTES;
+		if (node->last && done - node->last > r->max_gap)
+			r->max_gap = done - node->last;
+		if (adaptive)
+			Adaptive_Reading(&port, node, done);
+		node->last = done;
+		bus_free = at + cost;
+		t = done;
+	}
+	r->error = sqrt(r->error / (ticks * (double)nodes));
+}
+
+static void Print(const char * name, const struct result * r)
+{
+	printf("%-12s %7lu %9lu %12.4f %9.3f %10.2f\n", name, r->polls, r->bytes, r->error,
+		   r->bytes ? r->bits / r->bytes : 0.0, r->max_gap / 1e9);
+}
+
+int main(int argc, char * argv[])
+{
+	struct result rr, ad;
+	double need;
+	int opt, failed = 0;
+
+	while ((opt = getopt(argc, argv, "n:u:m:T:b:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			nodes = atoi(optarg);
+			break;
+		case 'u':
+			budget = atof(optarg);
+			break;
+		case 'm':
+			min_rate = atof(optarg);
+			break;
+		case 'T':
+			seconds = atof(optarg);
+			break;
+		case 'b':
+			baud = (uint32_t)atol(optarg);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			nodes = 0;
+			break;
+		}
+	}
+	if (nodes < 1 || nodes > POLLER_MAX_NODES || budget <= 0 || budget > 1 || min_rate <= 0 || seconds <= 0 ||
+		baud == 0 || seed == 0)
+	{
+		fprintf(stderr, "usage: %s [-n nodes] [-u budget 0-1] [-m min rate] [-T seconds] [-b baud] [-s seed]\n",
+				argv[0]);
+		return 2;
+	}
+
+	Run(&rr, 0);
+	Run(&ad, 1);
+	printf("%d nodes at %lu baud, %.0f%% of the bus, min %.2f polls/s, %.0f s\n", nodes, (unsigned long)baud,
+		   budget * 100, min_rate, seconds);
+	need = nodes * min_rate * (POLL_BYTES * Serial_ByteTime(baud) + REPLY_DELAY + POLLER_TURNAROUND) / 1e9;
+	if (need > budget)
+		printf("the minimum rate alone takes %.0f%% of the bus, over the budget\n", need * 100);
+	printf("               polls     bytes  rms error C  bits/byte  max gap s\n");
+	Print("in turn", &rr);
+	Print("adaptive", &ad);
+	printf("adaptive: %.2fx the bits per byte, %.2fx the rms error\n",
+		   rr.bits > 0 ? (ad.bits / ad.bytes) / (rr.bits / rr.bytes) : 0.0, rr.error > 0 ? ad.error / rr.error : 0.0);
+	if (ad.bits / ad.bytes <= rr.bits / rr.bytes)
+		failed = 1;
+	// a node due while the bus is busy waits out at most one poll per other node
+	if (ad.max_gap > (uint64_t)(1e9 / min_rate) + nodes * (uint64_t)(POLL_BYTES * Serial_ByteTime(baud) +
+		REPLY_DELAY + POLLER_TURNAROUND))
+		failed = 1;
+	return failed;
+}
@@ -0,0 +1,248 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "poller.h"
+#include "adaptive.h"
+#include "serial.h"
+#include "packet.h"
+
+#define P_IDLE		0	// the timer sends the next request
+#define P_WAIT		1	// a request is out, the timer ends the wait
+#define P_QUIET		2	// after a bad reply, the timer ends the silence
+
+static void Arm(struct poller_port * port, uint64_t at)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof (its));
+	// 0 would disarm it
+	if (at == 0)
+		at = 1;
+	its.it_value.tv_sec = at / 1000000000;
+	its.it_value.tv_nsec = at % 1000000000;
+	timerfd_settime(port->timer, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+int Poller_Open(struct poller_port * port)
+{
+	port->fd = Serial_Open(port->path, port->baud);
+	if (port->fd < 0)
+		return -1;
+	port->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (port->timer < 0)
+	{
+		close(port->fd);
+		return -1;
+	}
+	port->byte_time = Serial_ByteTime(port->baud);
+	port->state = P_IDLE;
+	port->next = 0;
+	// a query and its reply, until the first one is timed
+	port->poll_cost = 13 * port->byte_time + POLLER_TURNAROUND;
+	if (port->budget > 0)
+		Adaptive_Plan(port);
+	return 0;
+}
+
+void Poller_Close(struct poller_port * port)
+{
+	close(port->timer);
+	close(port->fd);
+}
+
+int Poller_AddNode(struct poller_port * port, uint8_t id)
+{
+	struct poller_node * node;
+
+	if (port->nodes == POLLER_MAX_NODES)
+		return -1;
+	node = &port->node[port->nodes++];
+	memset(node, 0, sizeof (*node));
+	node->id = id;
+	node->turnaround = POLLER_TURNAROUND;
+	node->timeout = POLLER_TIMEOUT;
+	return 0;
+}
+
+static void Send(struct poller_port * port, uint64_t now)
+{
+	struct poller_node * node;
+	uint8_t req[5];
+	uint64_t at;
+
+	if (port->nodes == 0)
+		return;
+	if (port->budget > 0)
+	{
+		port->current = Adaptive_Next(port, now, &at);
+		if (at > now)
+		{
+			port->state = P_IDLE;
+			Arm(port, at);
+			return;
+		}
+	}
+	else
+	{
+		port->current = port->next;
+		port->next = (port->next + 1) % port->nodes;
+	}
+	node = &port->node[port->current];
+	node->asked = now;
+
+	req[0] = node->id;
+	req[1] = CMD_QUERY;
+	req[2] = TYPE_BYTE;
+	req[3] = 0;
+	req[4] = checksum_len((char *)req, 4);
+	port->rx_n = 0;
+	port->rx_expected = 0;
+	if (write(port->fd, req, sizeof (req)) != sizeof (req))
+	{
+		// the tty buffer is full or gone, count it as a lost poll
+		node->timeouts++;
+		port->timeouts++;
+		port->state = P_IDLE;
+		Arm(port, now + POLLER_QUIET);
+		return;
+	}
+	port->sent = now;
+	port->sent_end = now + sizeof (req) * port->byte_time;
+	port->deadline = port->sent_end + node->timeout;
+	port->state = P_WAIT;
+	Arm(port, port->deadline);
+}
+
+void Poller_Start(struct poller_port * port, uint64_t now)
+{
+	port->since = now;
+	Send(port, now);
+}
+
+static void Quiet(struct poller_port * port, uint64_t now)
+{
+	port->state = P_QUIET;
+	port->deadline = now + POLLER_QUIET;
+	Arm(port, port->deadline);
+}
+
+static void Complete(struct poller_port * port, uint64_t now)
+{
+	struct poller_node * node = &port->node[port->current];
+	uint8_t * c = port->rx;
+	uint32_t raw;
+
+	if (c[0] != node->id || c[1] != CMD_QUERY || !IS_TYPE_FLOAT(c[2]) ||
+		(uint8_t)checksum_len((char *)c, 7) != c[7])
+	{
+		node->bad++;
+		port->bad++;
+		Quiet(port, now);
+		return;
+	}
+	if (IS_LITTLE_ENDIAN_BYTE_ORDER(c[2]))
+		raw = ((uint32_t)c[6] << 24) | ((uint32_t)c[5] << 16) | ((uint32_t)c[4] << 8) | c[3];
+	else
+		raw = ((uint32_t)c[3] << 24) | ((uint32_t)c[4] << 16) | ((uint32_t)c[5] << 8) | c[6];
+	node->prev = node->value;
+	memcpy(&node->value, &raw, sizeof (raw));
+	node->latency = node->latency ? (7 * node->latency + (now - port->sent_end)) / 8 : now - port->sent_end;
+	node->polls++;
+	port->polls++;
+	port->poll_cost = (7 * port->poll_cost + (now - port->sent + node->turnaround)) / 8;
+	if (port->budget > 0)
+		Adaptive_Reading(port, node, now);
+	node->last = now;
+	if (port->on_reading)
+		port->on_reading(port, node, now);
+	port->state = P_IDLE;
+	Arm(port, now + node->turnaround);
+}
+
+void Poller_Readable(struct poller_port * port, uint64_t now)
+{
+	uint8_t buf[256];
+	int n, i;
+
+	while ((n = read(port->fd, buf, sizeof (buf))) > 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			if (port->state != P_WAIT)
+			{
+				// nothing is asked: another master, or the tail of a bad reply
+				port->stray++;
+				if (port->state == P_QUIET)
+					Quiet(port, now);
+				continue;
+			}
+			port->rx[port->rx_n++] = buf[i];
+			if (port->rx_n == 3)
+				port->rx_expected = IS_TYPE_BLOCK(buf[i]) ? 0 : 4 + getTypeLength(buf[i]);
+			else if (port->rx_n == 4 && port->rx_expected == 0)
+				port->rx_expected = 5 + buf[i];
+			if (port->rx_n > 3 && port->rx_n == port->rx_expected)
+				Complete(port, now);
+			else if (port->rx_n == sizeof (port->rx))
+			{
+				port->node[port->current].bad++;
+				port->bad++;
+				Quiet(port, now);
+			}
+		}
+		if (port->state == P_WAIT)
+		{
+			// the rest of the reply has to follow closely
+			port->deadline = now + POLLER_REPLY_GAP * port->byte_time;
+			Arm(port, port->deadline);
+		}
+	}
+}
+
+void Poller_Timer(struct poller_port * port, uint64_t now)
+{
+	uint64_t expirations;
+	struct poller_node * node;
+
+	if (read(port->timer, &expirations, sizeof (expirations)) < 0 && errno == EAGAIN)
+		return;
+	switch (port->state)
+	{
+	case P_WAIT:
+		// the data may be in the tty buffer already
+		Poller_Readable(port, now);
+		if (port->state != P_WAIT)
+			break;
+		node = &port->node[port->current];
+		if (port->rx_n == 0)
+		{
+			node->timeouts++;
+			port->timeouts++;
+			Send(port, now);
+		}
+		else
+		{
+			node->bad++;
+			port->bad++;
+			Quiet(port, now);
+		}
+		break;
+	case P_QUIET:
+	case P_IDLE:
+		Send(port, now);
+		break;
+	}
+}
+
+double Poller_Report(struct poller_port * port, uint64_t now)
+{
+	double rate = now > port->since ? port->polls * 1e9 / (now - port->since) : 0;
+
+	port->polls = 0;
+	port->timeouts = 0;
+	port->bad = 0;
+	port->stray = 0;
+	port->since = now;
+	return rate;
+}
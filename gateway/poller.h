@@ -0,0 +1,86 @@
+#ifndef _poller_h_
+#define _poller_h_
+
+#include <stdint.h>
+
+// Master side of the packet protocol on one RS485 segment. The bus is
+// half duplex, so a port has one request in flight: the next request is
+// sent from the reply or timeout event of the last one, once the node's
+// turnaround has passed. The ports of a gateway run side by side in
+// one event loop. The poller never waits itself: the loop calls it when
+// the port fd is readable or the port timer fd has expired.
+
+#define POLLER_MAX_NODES	32
+#define POLLER_REPLY_GAP	4			// bytes of silence that end a partial reply
+#define POLLER_QUIET		3000000		// ns of silence after a bad reply, RS485_FRAME_TIMEOUT
+#define POLLER_TURNAROUND	200000		// ns, default quiet time after a reply
+#define POLLER_TIMEOUT		30000000	// ns, default wait for the first byte of a reply
+
+struct poller_node
+{
+	uint8_t id;
+	uint64_t turnaround;	// ns the node needs after its reply before the next request
+	uint64_t timeout;		// ns it may take to the first byte of a reply
+	uint32_t polls, timeouts, bad;
+	uint64_t latency;		// smoothed ns from the end of a request to the end of the reply
+	uint64_t last;			// time of the last reading
+	float value;			// last reading, the temperature of CMD_QUERY
+	float prev;				// the reading before
+
+	// adaptive scheduling, see adaptive.h
+	uint64_t asked;			// time of the last request
+	uint64_t interval;		// ns between requests it is given
+	float change;			// mean squared change of the reading per s
+	uint8_t readings;
+};
+
+struct poller_port;
+
+typedef void (*poller_reading)(struct poller_port * port, struct poller_node * node, uint64_t now);
+
+struct poller_port
+{
+	const char * path;
+	uint32_t baud;
+	int fd, timer;
+	uint64_t byte_time;		// ns
+	struct poller_node node[POLLER_MAX_NODES];
+	int nodes;
+	poller_reading on_reading;
+
+	// 0 polls the nodes in turn as fast as the bus goes; otherwise the
+	// fraction of bus time adaptive.h shares out, min_rate polls per
+	// second guaranteed to every node
+	float budget, min_rate;
+	uint64_t poll_cost;		// smoothed ns a poll holds the bus, turnaround included
+
+	// the request in flight
+	uint8_t state;
+	int current, next;
+	uint8_t rx[64];
+	int rx_n, rx_expected;
+	uint64_t sent, sent_end, deadline;
+
+	// counts since the last Poller_Report
+	uint32_t polls, timeouts, bad, stray;
+	uint64_t since;
+};
+
+// Opens the port and its timer, -1 with errno set on failure.
+int Poller_Open(struct poller_port * port);
+void Poller_Close(struct poller_port * port);
+
+// Adds a node with the default timing, -1 if the port is full.
+int Poller_AddNode(struct poller_port * port, uint8_t id);
+
+// Sends the first request.
+void Poller_Start(struct poller_port * port, uint64_t now);
+
+// Event handlers, now is Serial_Now() at the event.
+void Poller_Readable(struct poller_port * port, uint64_t now);
+void Poller_Timer(struct poller_port * port, uint64_t now);
+
+// Polls per second since the last call, and restarts the counts.
+double Poller_Report(struct poller_port * port, uint64_t now);
+
+#endif
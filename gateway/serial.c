@@ -0,0 +1,73 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "serial.h"
+
+static speed_t Speed(uint32_t baud)
+{
+	switch (baud)
+	{
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	default: return 0;
+	}
+}
+
+int Serial_Raw(int fd, uint32_t baud)
+{
+	struct termios tio;
+
+	if (Speed(baud) == 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	if (tcgetattr(fd, &tio) < 0)
+		return -1;
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, Speed(baud));
+	cfsetospeed(&tio, Speed(baud));
+	if (tcsetattr(fd, TCSANOW, &tio) < 0)
+		return -1;
+	tcflush(fd, TCIOFLUSH);
+	return 0;
+}
+
+int Serial_Open(const char * path, uint32_t baud)
+{
+	int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	int e;
+
+	if (fd < 0)
+		return -1;
+	if (Serial_Raw(fd, baud) < 0)
+	{
+		e = errno;
+		close(fd);
+		errno = e;
+		return -1;
+	}
+	return fd;
+}
+
+uint64_t Serial_ByteTime(uint32_t baud)
+{
+	return 10000000000ULL / baud;
+}
+
+uint64_t Serial_Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
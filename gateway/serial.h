@@ -0,0 +1,20 @@
+#ifndef _serial_h_
+#define _serial_h_
+
+#include <stdint.h>
+
+// Serial ports of the gateway: RS485 adapters, or ptys for the stand-in.
+
+// Opens a tty raw at 8N1 and non-blocking; -1 with errno set on failure.
+int Serial_Open(const char * path, uint32_t baud);
+
+// Puts an open tty in raw mode at baud, 0 on success.
+int Serial_Raw(int fd, uint32_t baud);
+
+// ns one 10 bit frame takes on the line
+uint64_t Serial_ByteTime(uint32_t baud);
+
+// CLOCK_MONOTONIC in ns
+uint64_t Serial_Now(void);
+
+#endif
@@ -0,0 +1,123 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "standin.h"
+#include "serial.h"
+#include "packet.h"
+
+#define FRAME_GAP_MS	3	// RS485_FRAME_TIMEOUT
+
+int Standin_Open(const struct standin * cfg, char * name, size_t size)
+{
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	int slave;
+
+	if (fd < 0)
+		return -1;
+	if (grantpt(fd) < 0 || unlockpt(fd) < 0 || ptsname_r(fd, name, size) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	// held open for good: the master gets EIO while no slave fd is open
+	slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0 || Serial_Raw(slave, cfg->baud) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// A slow wave per node, each at its own period.
+static float Reading(uint8_t k)
+{
+	double t = Serial_Now() / 1e9;
+
+	return (float)(20.0 + k + 3.0 * sin(2 * M_PI * t / (10.0 * (k + 1))));
+}
+
+static void Sleep(uint64_t ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000;
+	ts.tv_nsec = ns % 1000000000;
+	while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR);
+}
+
+static void Answer(int fd, const struct standin * cfg, const uint8_t * req, int len)
+{
+	uint64_t byte_time = Serial_ByteTime(cfg->baud);
+	uint8_t reply[8];
+	uint32_t raw;
+	float value;
+
+	if (req[1] != CMD_QUERY || (uint8_t)checksum_len((char *)req, len - 1) != req[len - 1] ||
+		req[0] < cfg->first || req[0] >= cfg->first + cfg->count)
+		return;
+	if (cfg->loss && rand() % 100 < cfg->loss)
+		return;
+
+	value = Reading(req[0] - cfg->first);
+	memcpy(&raw, &value, sizeof (raw));
+	reply[0] = req[0];
+	reply[1] = CMD_QUERY;
+	reply[2] = TYPE_FLOAT | BIG_ENDIAN_BYTE_ORDER;
+	reply[3] = (uint8_t)(raw >> 24);
+	reply[4] = (uint8_t)(raw >> 16);
+	reply[5] = (uint8_t)(raw >> 8);
+	reply[6] = (uint8_t)raw;
+	reply[7] = checksum_len((char *)reply, 7);
+	// the request came through the pty at once, the wire would have taken longer
+	Sleep(len * byte_time + cfg->delay * 1000ULL + sizeof (reply) * byte_time);
+	if (write(fd, reply, sizeof (reply)) < 0)
+		return;
+}
+
+void Standin_Serve(int fd, const struct standin * cfg)
+{
+	struct pollfd pfd;
+	uint8_t buf[256], frame[5 + 255];	// the longest block
+	int n, i, len = 0, expected = 0;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	for (;;)
+	{
+		n = poll(&pfd, 1, len ? FRAME_GAP_MS : -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return;
+		if (n == 0)
+		{
+			// a partial frame timed out, as on the node
+			len = 0;
+			continue;
+		}
+		n = read(fd, buf, sizeof (buf));
+		if (n <= 0)
+			return;
+		for (i = 0; i < n; i++)
+		{
+			frame[len++] = buf[i];
+			if (len == 3)
+				expected = IS_TYPE_BLOCK(buf[i]) ? 0 : 4 + getTypeLength(buf[i]);
+			else if (len == 4 && expected == 0)
+				expected = 5 + buf[i];
+			if ((len > 3 && len == expected) || len == sizeof (frame))
+			{
+				if (len == expected)
+					Answer(fd, cfg, frame, len);
+				len = 0;
+			}
+		}
+	}
+}
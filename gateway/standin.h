@@ -0,0 +1,29 @@
+#ifndef _standin_h_
+#define _standin_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Stand-in for a segment of SenseHost nodes on a pty, to run the gateway
+// without a bus. It answers CMD_QUERY for its ids the way a node does
+// and keeps the timing of the line: a reply reaches the pty when its
+// last byte would have, after the request's own time on the wire and
+// the reply delay.
+
+struct standin
+{
+	uint8_t first, count;	// ids first to first + count - 1
+	uint32_t baud;
+	uint32_t delay;			// us from the end of a request to the start of the reply
+	uint8_t loss;			// percent of requests left unanswered
+};
+
+// Opens a pty, names its slave in name and keeps the slave open in raw
+// mode so that the master reads nothing but what a gateway sends. The
+// master fd, -1 on failure.
+int Standin_Open(const struct standin * cfg, char * name, size_t size);
+
+// Answers on the master fd, returns only when the pty fails.
+void Standin_Serve(int fd, const struct standin * cfg);
+
+#endif
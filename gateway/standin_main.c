@@ -0,0 +1,59 @@
+// Runs a stand-in segment on a pty, see standin.h, and prints the pty
+// to give the gateway:
+//
+//   ./standin -i 0x91 -n 8 &
+//   ./gatewayd -p /dev/pts/5:115200:91-98
+//
+//   -i  first id, DEV_MY_THESIS + 1 by default
+//   -n  nodes
+//   -b  baud rate the timing follows
+//   -d  us from a request to the reply
+//   -l  percent of requests left unanswered
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "standin.h"
+#include "packet.h"
+
+int main(int argc, char * argv[])
+{
+	struct standin cfg = {DEV_MY_THESIS + 1, 4, 115200, 300, 0};
+	char name[64];
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "i:n:b:d:l:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i':
+			cfg.first = (uint8_t)strtol(optarg, NULL, 0);
+			break;
+		case 'n':
+			cfg.count = (uint8_t)atoi(optarg);
+			break;
+		case 'b':
+			cfg.baud = (uint32_t)atol(optarg);
+			break;
+		case 'd':
+			cfg.delay = (uint32_t)atol(optarg);
+			break;
+		case 'l':
+			cfg.loss = (uint8_t)atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-i first id] [-n nodes] [-b baud] [-d us] [-l loss %%]\n", argv[0]);
+			return 2;
+		}
+	}
+	fd = Standin_Open(&cfg, name, sizeof (name));
+	if (fd < 0)
+	{
+		perror("standin");
+		return 1;
+	}
+	printf("%s\n", name);
+	fflush(stdout);
+	Standin_Serve(fd, &cfg);
+	return 1;
+}
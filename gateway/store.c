@@ -0,0 +1,839 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "store.h"
+
+#define HASH_SIZE		(STORE_MAX_SERIES * 2)
+#define TABLE_PENDING	256		// rollup records kept before a write
+
+
+// a bucket a series is filling
+struct bucket
+{
+	int64_t start;
+	uint32_t count;
+	float min, max;
+	double sum;
+};
+
+// open chunk of a series
+struct builder
+{
+	uint32_t series;
+	uint32_t count;
+	int64_t first, last, delta;
+	uint32_t bits;			// of the last value
+	int lead, trail;		// window of the last XOR written with its own
+	float min, max;
+	uint32_t at;			// bits written
+	uint8_t buf[STORE_CHUNK_BYTES];
+	struct bucket level[STORE_LEVELS];
+};
+
+struct reader
+{
+	const uint8_t * buf;
+	uint32_t at;
+	int64_t time, delta;
+	uint32_t bits;
+	int lead, trail;
+};
+
+// how struct store_chunk and struct store_bucket start
+struct record
+{
+	uint32_t series;
+	uint32_t count;
+	int64_t time;
+};
+
+// a file of records, mapped and sorted by series and time for lookups
+struct table
+{
+	int fd;
+	size_t size;			// of a record
+	const uint8_t * map;
+	size_t n, mapped;
+	uint32_t * order;
+	uint8_t * pending;		// records not written yet, if buffered
+	size_t pending_n;
+};
+
+struct store
+{
+	int data;
+	uint64_t data_end;
+	uint64_t points;
+	const uint8_t * map;
+	size_t map_size;
+
+	struct table index;
+	struct table rollup[STORE_LEVELS];
+
+	// open chunks, by series through an open addressed table
+	struct builder * open[STORE_MAX_SERIES];
+	int opened;
+	int16_t hash[HASH_SIZE];
+};
+
+static const int64_t level_span[STORE_LEVELS] = { STORE_MINUTE, STORE_HOUR, STORE_DAY };
+
+static void Put(struct builder * b, uint64_t v, int n)
+{
+	// most significant bit first
+	while (n > 0)
+	{
+		int room = 8 - (b->at & 7), take = n < room ? n : room;
+		uint8_t part = (uint8_t)((v >> (n - take)) & ((1u << take) - 1));
+
+		b->buf[b->at >> 3] |= (uint8_t)(part << (room - take));
+		b->at += take;
+		n -= take;
+	}
+}
+
+static uint64_t Get(struct reader * r, int n)
+{
+	uint64_t v = 0;
+
+	while (n > 0)
+	{
+		int room = 8 - (r->at & 7), take = n < room ? n : room;
+
+		v = (v << take) | ((r->buf[r->at >> 3] >> (room - take)) & ((1u << take) - 1));
+		r->at += take;
+		n -= take;
+	}
+	return v;
+}
+
+static uint32_t Bits(float f)
+{
+	uint32_t u;
+
+	memcpy(&u, &f, 4);
+	return u;
+}
+
+static float Float(uint32_t u)
+{
+	float f;
+
+	memcpy(&f, &u, 4);
+	return f;
+}
+
+static void PutTime(struct builder * b, int64_t time)
+{
+	int64_t delta = time - b->last, dod = delta - b->delta;
+
+	if (dod == 0)
+		Put(b, 0, 1);
+	else if (dod >= -63 && dod <= 64)
+	{
+		Put(b, 2, 2);
+		Put(b, (uint64_t)(dod + 63), 7);
+	}
+	else if (dod >= -255 && dod <= 256)
+	{
+		Put(b, 6, 3);
+		Put(b, (uint64_t)(dod + 255), 9);
+	}
+	else if (dod >= -2047 && dod <= 2048)
+	{
+		Put(b, 14, 4);
+		Put(b, (uint64_t)(dod + 2047), 12);
+	}
+	else
+	{
+		Put(b, 15, 4);
+		Put(b, (uint32_t)dod, 32);
+	}
+	b->delta = delta;
+	b->last = time;
+}
+
+static void PutValue(struct builder * b, uint32_t bits)
+{
+	uint32_t x = bits ^ b->bits;
+	int lead, trail;
+
+	b->bits = bits;
+	if (x == 0)
+	{
+		Put(b, 0, 1);
+		return;
+	}
+	lead = __builtin_clz(x);
+	trail = __builtin_ctz(x);
+	if (b->lead >= 0 && lead >= b->lead && trail >= b->trail)
+	{
+		// inside the window of the last one
+		Put(b, 2, 2);
+		Put(b, x >> b->trail, 32 - b->lead - b->trail);
+		return;
+	}
+	Put(b, 3, 2);
+	Put(b, (uint64_t)lead, 5);
+	Put(b, (uint64_t)(32 - lead - trail), 6);
+	Put(b, x >> trail, 32 - lead - trail);
+	b->lead = lead;
+	b->trail = trail;
+}
+
+static void Start(struct reader * r, const uint8_t * buf)
+{
+	memset(r, 0, sizeof (*r));
+	r->buf = buf;
+	r->lead = -1;
+}
+
+static void Next(struct reader * r, int first)
+{
+	int64_t dod;
+	int lead, len;
+
+	if (first)
+	{
+		r->time = (int64_t)Get(r, 64);
+		r->bits = (uint32_t)Get(r, 32);
+		return;
+	}
+	if (!Get(r, 1))
+		dod = 0;
+	else if (!Get(r, 1))
+		dod = (int64_t)Get(r, 7) - 63;
+	else if (!Get(r, 1))
+		dod = (int64_t)Get(r, 9) - 255;
+	else if (!Get(r, 1))
+		dod = (int64_t)Get(r, 12) - 2047;
+	else
+		dod = (int32_t)Get(r, 32);
+	r->delta += dod;
+	r->time += r->delta;
+
+	if (!Get(r, 1))
+		return;
+	if (Get(r, 1))
+	{
+		r->lead = (int)Get(r, 5);
+		len = (int)Get(r, 6);
+		r->trail = 32 - r->lead - len;
+	}
+	lead = r->lead;
+	len = 32 - lead - r->trail;
+	r->bits ^= (uint32_t)Get(r, len) << r->trail;
+}
+
+static void Begin(struct builder * b, int64_t time, float value)
+{
+	memset(b->buf, 0, sizeof (b->buf));
+	b->at = 0;
+	b->count = 1;
+	b->first = b->last = time;
+	b->delta = 0;
+	b->bits = Bits(value);
+	b->lead = -1;
+	b->trail = 0;
+	b->min = b->max = value;
+	Put(b, (uint64_t)time, 64);
+	Put(b, b->bits, 32);
+}
+
+static int64_t Align(int64_t time, int64_t span)
+{
+	int64_t r = time % span;
+
+	return time - (r < 0 ? r + span : r);
+}
+
+static int Slot(struct store * s, uint32_t series)
+{
+	uint32_t h = (series * 2654435761u) % HASH_SIZE;
+
+	while (s->hash[h] >= 0 && s->open[s->hash[h]]->series != series)
+		h = (h + 1) % HASH_SIZE;
+	return (int)h;
+}
+
+static struct builder * Find(struct store * s, uint32_t series)
+{
+	int h = Slot(s, series);
+
+	return s->hash[h] >= 0 ? s->open[s->hash[h]] : NULL;
+}
+
+static int Table_Open(struct table * t, const char * dir, const char * name, size_t size, int buffered)
+{
+	char path[4096];
+	struct stat st;
+
+	t->size = size;
+	snprintf(path, sizeof (path), "%s/%s", dir, name);
+	t->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (t->fd < 0 || fstat(t->fd, &st) < 0)
+		return -1;
+	// a partial record at the end is from a write cut short
+	if (st.st_size % size && ftruncate(t->fd, st.st_size - st.st_size % size) < 0)
+		return -1;
+	if (buffered && (t->pending = malloc(TABLE_PENDING * size)) == NULL)
+		return -1;
+	return 0;
+}
+
+static int Table_Drain(struct table * t)
+{
+	ssize_t len = (ssize_t)(t->pending_n * t->size);
+
+	if (t->pending_n == 0)
+		return 0;
+	t->pending_n = 0;
+	return write(t->fd, t->pending, (size_t)len) == len ? 0 : -1;
+}
+
+static int Table_Append(struct table * t, const void * record)
+{
+	if (t->pending == NULL)
+		return write(t->fd, record, t->size) == (ssize_t)t->size ? 0 : -1;
+	memcpy(t->pending + t->pending_n++ * t->size, record, t->size);
+	return t->pending_n == TABLE_PENDING ? Table_Drain(t) : 0;
+}
+
+static void Table_Unmap(struct table * t)
+{
+	if (t->map)
+		munmap((void *)t->map, t->mapped);
+	t->map = NULL;
+	t->mapped = 0;
+	t->n = 0;
+}
+
+static void Table_Close(struct table * t)
+{
+	if (t->fd >= 0)
+	{
+		Table_Drain(t);
+		close(t->fd);
+	}
+	Table_Unmap(t);
+	free(t->order);
+	free(t->pending);
+}
+
+static const struct table * sorting;
+
+static int ByTime(const void * a, const void * b)
+{
+	uint32_t i = *(const uint32_t *)a, j = *(const uint32_t *)b;
+	const struct record * x = (const struct record *)(sorting->map + i * sorting->size);
+	const struct record * y = (const struct record *)(sorting->map + j * sorting->size);
+
+	if (x->series != y->series)
+		return x->series < y->series ? -1 : 1;
+	if (x->time != y->time)
+		return x->time < y->time ? -1 : 1;
+	return i < j ? -1 : 1;
+}
+
+// maps the file again if records were written since; the records mapped
+// before are in order already, only the new ones are sorted and merged in
+static int Table_Map(struct table * t)
+{
+	struct stat st;
+	size_t n, old, k, i, j;
+	uint32_t * order;
+	void * map;
+
+	if (Table_Drain(t) < 0 || fstat(t->fd, &st) < 0)
+		return -1;
+	n = (size_t)st.st_size / t->size;
+	if (n == t->n)
+		return 0;
+	old = n < t->n ? 0 : t->n;
+	k = n - old;
+	// room for the new records after the n of the merged order
+	order = realloc(t->order, (n + k) * sizeof (uint32_t));
+	if (order == NULL)
+		return -1;
+	t->order = order;
+	Table_Unmap(t);
+	map = mmap(NULL, n * t->size, PROT_READ, MAP_SHARED, t->fd, 0);
+	if (map == MAP_FAILED)
+		return -1;
+	t->map = map;
+	t->mapped = n * t->size;
+	for (i = 0; i < k; i++)
+		order[n + i] = (uint32_t)(old + i);
+	sorting = t;
+	qsort(order + n, k, sizeof (uint32_t), ByTime);
+	// from the back, each step fills the place after the two runs left
+	for (i = old, j = k; j > 0; )
+	{
+		if (i > 0 && ByTime(order + i - 1, order + n + j - 1) > 0)
+		{
+			order[i + j - 1] = order[i - 1];
+			i--;
+		}
+		else
+		{
+			order[i + j - 1] = order[n + j - 1];
+			j--;
+		}
+	}
+	t->n = n;
+	return 0;
+}
+
+static const void * Table_Get(const struct table * t, size_t i)
+{
+	return t->map + t->order[i] * t->size;
+}
+
+// first record of series at or after time
+static size_t Table_Lower(const struct table * t, uint32_t series, int64_t time)
+{
+	size_t lo = 0, hi = t->n, mid;
+
+	while (lo < hi)
+	{
+		const struct record * r;
+
+		mid = (lo + hi) / 2;
+		r = Table_Get(t, mid);
+		if (r->series < series || (r->series == series && r->time < time))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int WriteChunk(struct store * s, struct builder * b)
+{
+	struct store_chunk c;
+	uint32_t size = (b->at + 7) >> 3;
+
+	if (b->count == 0)
+		return 0;
+	memset(&c, 0, sizeof (c));
+	c.series = b->series;
+	c.count = b->count;
+	c.first = b->first;
+	c.last = b->last;
+	c.min = b->min;
+	c.max = b->max;
+	c.offset = s->data_end;
+	c.size = size;
+	// the data before the index entry that points at it
+	if (pwrite(s->data, b->buf, size, (off_t)s->data_end) != (ssize_t)size)
+		return -1;
+	if (Table_Append(&s->index, &c) < 0)
+		return -1;
+	s->data_end += size;
+	b->count = 0;
+	return 0;
+}
+
+static int WriteBucket(struct store * s, struct builder * b, int l)
+{
+	struct bucket * bk = &b->level[l];
+	struct store_bucket r;
+
+	if (bk->count == 0)
+		return 0;
+	memset(&r, 0, sizeof (r));
+	r.series = b->series;
+	r.count = bk->count;
+	r.start = bk->start;
+	r.min = bk->min;
+	r.max = bk->max;
+	r.sum = bk->sum;
+	// the start stays, for points of the same bucket still to come
+	bk->count = 0;
+	return Table_Append(&s->rollup[l], &r);
+}
+
+// maps the data file again if it has grown
+static int MapData(struct store * s)
+{
+	void * map;
+
+	if (s->data_end <= s->map_size)
+		return 0;
+	if (s->map)
+		munmap((void *)s->map, s->map_size);
+	s->map = NULL;
+	s->map_size = 0;
+	map = mmap(NULL, (size_t)s->data_end, PROT_READ, MAP_SHARED, s->data, 0);
+	if (map == MAP_FAILED)
+		return -1;
+	s->map = map;
+	s->map_size = (size_t)s->data_end;
+	return 0;
+}
+
+struct store * Store_Open(const char * dir)
+{
+	static const char * name[STORE_LEVELS] = { "rollup.60", "rollup.3600", "rollup.86400" };
+	struct store * s;
+	char path[4096];
+	struct stat st;
+	uint64_t end = 0;
+	size_t i;
+	int l, e;
+
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+		return NULL;
+	s = calloc(1, sizeof (*s));
+	if (s == NULL)
+		return NULL;
+	for (i = 0; i < HASH_SIZE; i++)
+		s->hash[i] = -1;
+	s->index.fd = -1;
+	for (l = 0; l < STORE_LEVELS; l++)
+		s->rollup[l].fd = -1;
+	snprintf(path, sizeof (path), "%s/data", dir);
+	s->data = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (s->data < 0 || fstat(s->data, &st) < 0 ||
+		Table_Open(&s->index, dir, "index", sizeof (struct store_chunk), 0) < 0)
+		goto fail;
+	for (l = 0; l < STORE_LEVELS; l++)
+		if (Table_Open(&s->rollup[l], dir, name[l], sizeof (struct store_bucket), 1) < 0)
+			goto fail;
+	if (Table_Map(&s->index) < 0)
+		goto fail;
+	// the data file ends after the last chunk indexed, the rest is lost
+	for (i = 0; i < s->index.n; i++)
+	{
+		const struct store_chunk * c = Table_Get(&s->index, i);
+
+		if (c->offset + c->size > end)
+			end = c->offset + c->size;
+		s->points += c->count;
+	}
+	if (end < (uint64_t)st.st_size && ftruncate(s->data, (off_t)end) < 0)
+		goto fail;
+	s->data_end = end;
+	return s;
+
+fail:
+	e = errno;
+	if (s->data >= 0)
+		close(s->data);
+	Table_Close(&s->index);
+	for (l = 0; l < STORE_LEVELS; l++)
+		Table_Close(&s->rollup[l]);
+	free(s);
+	errno = e;
+	return NULL;
+}
+
+int Store_Flush(struct store * s)
+{
+	int i, l, ret = 0;
+
+	for (i = 0; i < s->opened; i++)
+	{
+		if (WriteChunk(s, s->open[i]) < 0)
+			ret = -1;
+		for (l = 0; l < STORE_LEVELS; l++)
+			if (WriteBucket(s, s->open[i], l) < 0)
+				ret = -1;
+	}
+	for (l = 0; l < STORE_LEVELS; l++)
+		if (Table_Drain(&s->rollup[l]) < 0)
+			ret = -1;
+	return ret;
+}
+
+void Store_Close(struct store * s)
+{
+	int i, l;
+
+	Store_Flush(s);
+	if (s->map)
+		munmap((void *)s->map, s->map_size);
+	close(s->data);
+	Table_Close(&s->index);
+	for (l = 0; l < STORE_LEVELS; l++)
+		Table_Close(&s->rollup[l]);
+	for (i = 0; i < s->opened; i++)
+		free(s->open[i]);
+	free(s);
+}
+
+// end of the last chunk of series in the mapped index, INT64_MIN if none
+static int64_t Last(struct store * s, uint32_t series)
+{
+	const struct store_chunk * c;
+	size_t i;
+
+	i = Table_Lower(&s->index, series, INT64_MAX);
+	while (i < s->index.n && ((const struct store_chunk *)Table_Get(&s->index, i))->series == series)
+		i++;
+	if (i == 0 || (c = Table_Get(&s->index, i - 1))->series != series)
+		return INT64_MIN;
+	return c->last;
+}
+
+int Store_Append(struct store * s, uint32_t series, int64_t time, float value)
+{
+	struct builder * b = Find(s, series);
+	struct bucket * bk;
+	int64_t dod, start;
+	int l;
+
+	if (b == NULL)
+	{
+		if (s->opened == STORE_MAX_SERIES || Table_Map(&s->index) < 0 || (b = malloc(sizeof (*b))) == NULL)
+			return -1;
+		b->series = series;
+		b->count = 0;
+		b->last = Last(s, series);
+		for (l = 0; l < STORE_LEVELS; l++)
+			b->level[l].count = 0;
+		s->hash[Slot(s, series)] = (int16_t)s->opened;
+		s->open[s->opened++] = b;
+	}
+	// last stays when the chunk is written out, the check holds across chunks
+	if (time < b->last)
+		return -1;
+
+	if (b->count)
+	{
+		// a full chunk, or a change of delta too big for its field, starts the next
+		dod = (time - b->last) - b->delta;
+		if (b->count == STORE_CHUNK_POINTS || dod < INT32_MIN || dod > INT32_MAX)
+			if (WriteChunk(s, b) < 0)
+				return -1;
+	}
+	if (b->count == 0)
+		Begin(b, time, value);
+	else
+	{
+		PutTime(b, time);
+		PutValue(b, Bits(value));
+		b->count++;
+		if (value < b->min)
+			b->min = value;
+		if (value > b->max)
+			b->max = value;
+	}
+	s->points++;
+
+	for (l = 0; l < STORE_LEVELS; l++)
+	{
+		bk = &b->level[l];
+		start = Align(time, level_span[l]);
+		if (bk->count && bk->start != start && WriteBucket(s, b, l) < 0)
+			return -1;
+		if (bk->count == 0)
+		{
+			bk->start = start;
+			bk->min = bk->max = value;
+			bk->sum = 0;
+		}
+		bk->count++;
+		bk->sum += value;
+		if (value < bk->min)
+			bk->min = value;
+		if (value > bk->max)
+			bk->max = value;
+	}
+	return 0;
+}
+
+static size_t Decode(const uint8_t * buf, uint32_t count, int64_t from, int64_t to, store_point fn, void * arg,
+					 float * min, float * max)
+{
+	struct reader r;
+	uint32_t i;
+	size_t n = 0;
+	float v;
+
+	Start(&r, buf);
+	for (i = 0; i < count; i++)
+	{
+		Next(&r, i == 0);
+		if (r.time >= to)
+			break;
+		if (r.time < from)
+			continue;
+		v = Float(r.bits);
+		if (fn)
+			fn(arg, r.time, v);
+		if (min && v < *min)
+			*min = v;
+		if (max && v > *max)
+			*max = v;
+		n++;
+	}
+	return n;
+}
+
+static size_t Scan(struct store * s, uint32_t series, int64_t from, int64_t to, store_point fn, void * arg,
+				   float * min, float * max)
+{
+	struct builder * b = Find(s, series);
+	const struct store_chunk * c;
+	size_t i, n = 0;
+
+	if (from >= to || Table_Map(&s->index) < 0 || MapData(s) < 0)
+		return 0;
+	// the chunk before the first that starts in range may reach into it
+	i = Table_Lower(&s->index, series, from);
+	if (i > 0 && (c = Table_Get(&s->index, i - 1))->series == series && c->last >= from)
+		i--;
+	for (; i < s->index.n; i++)
+	{
+		c = Table_Get(&s->index, i);
+		if (c->series != series || c->first >= to)
+			break;
+		if (min && c->first >= from && c->last < to)
+		{
+			// whole chunk in range, the index has it all
+			if (c->min < *min)
+				*min = c->min;
+			if (c->max > *max)
+				*max = c->max;
+			n += c->count;
+		}
+		else
+			n += Decode(s->map + c->offset, c->count, from, to, fn, arg, min, max);
+	}
+	if (b && b->count && b->last >= from && b->first < to)
+	{
+		if (min && b->first >= from && b->last < to)
+		{
+			if (b->min < *min)
+				*min = b->min;
+			if (b->max > *max)
+				*max = b->max;
+			n += b->count;
+		}
+		else
+			n += Decode(b->buf, b->count, from, to, fn, arg, min, max);
+	}
+	return n;
+}
+
+size_t Store_Query(struct store * s, uint32_t series, int64_t from, int64_t to, store_point fn, void * arg)
+{
+	return Scan(s, series, from, to, fn, arg, NULL, NULL);
+}
+
+size_t Store_MinMax(struct store * s, uint32_t series, int64_t from, int64_t to, float * min, float * max)
+{
+	*min = INFINITY;
+	*max = -INFINITY;
+	return Scan(s, series, from, to, NULL, NULL, min, max);
+}
+
+// adds up the records of a bucket and passes each bucket on when done
+struct gather
+{
+	int64_t span;
+	struct store_rollup r;
+	double sum;
+	store_bucket_fn fn;
+	void * arg;
+	size_t n;
+};
+
+static void Gather(struct gather * g, int64_t start, uint32_t count, float min, float max, double sum)
+{
+	if (g->r.count && g->r.start == start)
+	{
+		g->r.count += count;
+		if (min < g->r.min)
+			g->r.min = min;
+		if (max > g->r.max)
+			g->r.max = max;
+		g->sum += sum;
+		return;
+	}
+	if (g->r.count)
+	{
+		g->r.mean = g->sum / g->r.count;
+		g->fn(g->arg, &g->r);
+		g->n++;
+	}
+	g->r.start = start;
+	g->r.span = g->span;
+	g->r.count = count;
+	g->r.min = min;
+	g->r.max = max;
+	g->sum = sum;
+}
+
+static void Gather_Point(void * arg, int64_t time, float value)
+{
+	struct gather * g = arg;
+
+	Gather(g, Align(time, g->span), 1, value, value, value);
+}
+
+size_t Store_Rollup(struct store * s, uint32_t series, int64_t from, int64_t to, int64_t resolution,
+					store_bucket_fn fn, void * arg)
+{
+	const struct store_bucket * r;
+	struct builder * b;
+	struct table * t;
+	struct gather g;
+	size_t i;
+	int l, level = -1;
+
+	if (from >= to)
+		return 0;
+	for (l = 0; l < STORE_LEVELS; l++)
+		if (level_span[l] <= resolution)
+			level = l;
+	memset(&g, 0, sizeof (g));
+	g.fn = fn;
+	g.arg = arg;
+
+	if (level < 0)
+	{
+		// finer than any rollup, from the points
+		g.span = resolution > 0 ? resolution : 1;
+		if (from > INT64_MIN + g.span)
+			from = Align(from, g.span);
+		if (to < INT64_MAX - g.span)
+			to = Align(to - 1, g.span) + g.span;
+		Scan(s, series, from, to, Gather_Point, &g, NULL, NULL);
+	}
+	else
+	{
+		g.span = level_span[level];
+		t = &s->rollup[level];
+		if (Table_Map(t) < 0)
+			return 0;
+		for (i = Table_Lower(t, series, from > INT64_MIN + g.span ? from - g.span + 1 : INT64_MIN); i < t->n; i++)
+		{
+			r = Table_Get(t, i);
+			if (r->series != series || r->start >= to)
+				break;
+			Gather(&g, r->start, r->count, r->min, r->max, r->sum);
+		}
+		b = Find(s, series);
+		if (b && b->level[level].count && b->level[level].start + g.span > from &&
+			b->level[level].start < to)
+			Gather(&g, b->level[level].start, b->level[level].count, b->level[level].min, b->level[level].max,
+				   b->level[level].sum);
+	}
+	// the last bucket
+	Gather(&g, INT64_MIN, 0, 0, 0, 0);
+	return g.n;
+}
+
+void Store_Size(struct store * s, uint64_t * bytes, uint64_t * points)
+{
+	*bytes = s->data_end;
+	*points = s->points;
+}
@@ -0,0 +1,116 @@
+#ifndef _store_h_
+#define _store_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On-disk store for the readings the gateway collects, a series per
+// node and quantity. Points go into an open chunk per series, in memory,
+// and a full chunk is appended to the data file and indexed:
+//
+//   data    chunks back to back; in a chunk the first point is stored
+//           whole, then each time as the change of its delta from the
+//           one before (delta of delta) and each value as its XOR with
+//           the one before, in the fewest bits that hold it
+//   index   a struct store_chunk per chunk: series, time span, count,
+//           min and max, place in the data file
+//   rollup.60, rollup.3600, rollup.86400
+//           a struct store_bucket per series and minute, hour and day:
+//           count, min, max and sum of the points in it, kept as the
+//           points come in and written when the next bucket starts
+//
+// The files are in the host's byte order. The data of a chunk is written
+// before its index entry. Closed buckets go to their rollup in batches
+// of TABLE_PENDING (store.c) records, so a crash loses the open chunks
+// and buckets and up to that many closed buckets of each rollup; their
+// points are still in the chunks. Store_Flush and Store_Close write all
+// of them. A bucket written out part full, by Store_Flush, carries on in
+// another record, and the records of a bucket are added up when read.
+// Reads go through a memory map of the files, remapped when they have
+// grown with the new records sorted into the order kept of the rest, and
+// take in the open chunks and buckets too. Times are ms, non-decreasing
+// within a series.
+
+#define STORE_TEMPERATURE	0
+#define STORE_LIGHTING		1
+#define STORE_GAS			2
+#define STORE_SERIES(node, quantity)	(((uint32_t)(node) << 2) | (quantity))
+
+#define STORE_CHUNK_POINTS	1024
+#define STORE_CHUNK_BYTES	(STORE_CHUNK_POINTS * 11 + 16)	// 81 bits a point at worst
+#define STORE_MAX_SERIES	8192		// series with an open chunk
+
+#define STORE_LEVELS		3			// of rollup
+#define STORE_MINUTE		60000LL
+#define STORE_HOUR			3600000LL
+#define STORE_DAY			86400000LL
+
+struct store_chunk
+{
+	uint32_t series;
+	uint32_t count;
+	int64_t first, last;	// ms
+	float min, max;
+	uint64_t offset;		// in the data file
+	uint32_t size;			// bytes
+	uint32_t reserved;
+};
+
+struct store_bucket
+{
+	uint32_t series;
+	uint32_t count;
+	int64_t start;			// ms, a multiple of the span from the epoch
+	float min, max;
+	double sum;
+};
+
+// a bucket of a rollup query
+struct store_rollup
+{
+	int64_t start, span;	// ms
+	uint32_t count;
+	float min, max;
+	double mean;
+};
+
+struct store;
+
+typedef void (*store_point)(void * arg, int64_t time, float value);
+typedef void (*store_bucket_fn)(void * arg, const struct store_rollup * bucket);
+
+// Opens the store in dir, made if missing. NULL with errno set on failure.
+struct store * Store_Open(const char * dir);
+
+// Writes the open chunks out and frees the store.
+void Store_Close(struct store * s);
+
+// Adds a point, -1 if time is before the last one of the series, stored
+// before the store was opened or not, or the write failed.
+int Store_Append(struct store * s, uint32_t series, int64_t time, float value);
+
+// Writes the open chunks out, so that the files hold every point.
+int Store_Flush(struct store * s);
+
+// Calls fn for each point of series in [from, to), in time order, and
+// returns how many there were.
+size_t Store_Query(struct store * s, uint32_t series, int64_t from, int64_t to, store_point fn, void * arg);
+
+// Min and max of series in [from, to) and the number of points. Chunks
+// inside the range come from the index alone, only those cut by it are
+// decoded.
+size_t Store_MinMax(struct store * s, uint32_t series, int64_t from, int64_t to, float * min, float * max);
+
+// Calls fn for each bucket of series that holds points in [from, to),
+// in time order, and returns how many there were. The buckets are those
+// of the coarsest rollup with a span of at most resolution ms, so a query
+// costs the buckets it returns. Below a minute they are made from the
+// points, resolution ms each, 1 ms for resolution 0. Buckets at the ends
+// take in their points outside the range too.
+size_t Store_Rollup(struct store * s, uint32_t series, int64_t from, int64_t to, int64_t resolution,
+					store_bucket_fn fn, void * arg);
+
+// Bytes in the data file, and points stored, those in open chunks too.
+void Store_Size(struct store * s, uint64_t * bytes, uint64_t * points);
+
+#endif
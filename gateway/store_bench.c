@@ -0,0 +1,485 @@
+// Ingest rate and range query throughput of the store (store.h), on
+// synthetic readings: temperature, lighting and gas for each node.
+//
+//   ./store_bench [-n nodes] [-T seconds] [-i ms] [-q queries] [-w seconds] [-d dir] [-s seed] [-k]
+//
+//   -n  nodes, three series each
+//   -T  seconds of readings
+//   -i  ms between the readings of a node, each a few ms late at random
+//   -q  range queries, each over a random series and window
+//   -w  seconds in a query window
+//   -d  directory of the store, a new one under /tmp by default
+//   -k  keeps the store, removed at the end otherwise
+//
+// The readings move like the real ones: temperature in steps of 1/16 C
+// over a daily swing, lighting in whole lux, dark at night, gas in ppm
+// steps of 0.5. The store is flushed halfway, which leaves buckets of the
+// rollups written in two parts, and read there and at the end while still
+// open, so that the records written since are merged into the maps; then
+// it is closed and opened again. It is read back whole and checked point
+// by point against the readings, and each rollup bucket by bucket.
+// Queries are timed decoding every point, then for min and max, which
+// take whole chunks from the index. Last come charts of a series over all
+// the readings, CHART_BUCKETS wide, from the rollups against those from
+// the points. The bench fails on a point or bucket lost or changed, or a
+// min or max that differs from the points.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "store.h"
+
+#define DAY_MS		86400000LL
+#define START_MS	1700000000000LL
+#define JITTER_MS	20
+#define CHART_BUCKETS	500
+
+struct check
+{
+	int node, quantity;
+	long step, bad;
+	float min, max;
+};
+
+// a rollup against the readings
+struct expect
+{
+	int node, quantity;
+	long step, bad, buckets;
+};
+
+// a chart made from the points
+struct chart
+{
+	int64_t span, start;
+	long buckets;
+	float min, max;
+	double sum;
+	uint32_t count;
+};
+
+static int nodes = 64;
+static double seconds = 86400;
+static long interval = 10000;
+static long steps_n;
+static uint64_t seed = 1;
+
+static uint64_t Hash(uint64_t x)
+{
+	// splitmix64
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static double Noise(int node, int quantity, long step)
+{
+	return (Hash(seed ^ ((uint64_t)node << 40) ^ ((uint64_t)quantity << 32) ^ (uint64_t)step) >> 11) /
+		   9007199254740992.0 - 0.5;
+}
+
+static int64_t Time(int node, long step)
+{
+	return START_MS + step * interval + (int64_t)(Hash(seed + (uint64_t)node * 7919 + (uint64_t)step) % JITTER_MS);
+}
+
+static float Value(int node, int quantity, long step)
+{
+	double day = 2 * M_PI * (double)((Time(node, step) - START_MS) % DAY_MS) / DAY_MS + node * 0.1;
+	double v;
+
+	switch (quantity)
+	{
+	case STORE_TEMPERATURE:
+		v = 25 + 4 * sin(day) + 0.2 * Noise(node, quantity, step);
+		return (float)(floor(v * 16 + 0.5) / 16);
+	case STORE_LIGHTING:
+		v = 800 * sin(day) + 10 * Noise(node, quantity, step);
+		return (float)(v > 0 ? floor(v + 0.5) : 0);
+	default:
+		v = 420 + 30 * sin(2 * day) + 4 * Noise(node, quantity, step);
+		return (float)(floor(v * 2 + 0.5) / 2);
+	}
+}
+
+static double Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the next random query
+static uint32_t Window(uint64_t * rng, int64_t * from)
+{
+	*rng = Hash(*rng);
+	*from = START_MS + (int64_t)((*rng >> 16) % (uint64_t)(seconds * 1000));
+	return STORE_SERIES(*rng % (uint64_t)nodes, (*rng >> 8) % 3);
+}
+
+static void On_Check(void * arg, int64_t time, float value)
+{
+	struct check * c = arg;
+
+	if (time != Time(c->node, c->step) || value != Value(c->node, c->quantity, c->step))
+		c->bad++;
+	c->step++;
+}
+
+static void On_Point(void * arg, int64_t time, float value)
+{
+	struct check * c = arg;
+
+	(void)time;
+	if (value < c->min)
+		c->min = value;
+	if (value > c->max)
+		c->max = value;
+	c->step++;
+}
+
+static void On_Bucket(void * arg, const struct store_rollup * r)
+{
+	struct expect * e = arg;
+	uint32_t count = 0;
+	float min = INFINITY, max = -INFINITY, v;
+	double sum = 0;
+
+	// the readings up to the end of the bucket should all be in it
+	for (; e->step < steps_n && Time(e->node, e->step) < r->start + r->span; e->step++)
+	{
+		if (Time(e->node, e->step) < r->start)
+			e->bad++;
+		v = Value(e->node, e->quantity, e->step);
+		count++;
+		sum += v;
+		if (v < min)
+			min = v;
+		if (v > max)
+			max = v;
+	}
+	if (count != r->count || min != r->min || max != r->max || fabs(sum / count - r->mean) > 1e-9 * fabs(r->mean))
+		e->bad++;
+	e->buckets++;
+}
+
+static void On_Raw(void * arg, int64_t time, float value)
+{
+	struct chart * c = arg;
+	int64_t start = time - time % c->span;
+
+	if (c->count && start != c->start)
+	{
+		c->buckets++;
+		c->count = 0;
+	}
+	if (c->count == 0)
+	{
+		c->start = start;
+		c->min = c->max = value;
+		c->sum = 0;
+	}
+	c->count++;
+	c->sum += value;
+	if (value < c->min)
+		c->min = value;
+	if (value > c->max)
+		c->max = value;
+}
+
+static void On_Chart(void * arg, const struct store_rollup * r)
+{
+	(void)r;
+	(*(long *)arg)++;
+}
+
+// every point of every series against the first steps readings
+static long Check_Points(struct store * s, long steps)
+{
+	struct check c;
+	long bad = 0;
+	int node, q;
+
+	for (node = 0; node < nodes; node++)
+		for (q = STORE_TEMPERATURE; q <= STORE_GAS; q++)
+		{
+			memset(&c, 0, sizeof (c));
+			c.node = node;
+			c.quantity = q;
+			Store_Query(s, STORE_SERIES(node, q), INT64_MIN, INT64_MAX, On_Check, &c);
+			if (c.step != steps)
+				c.bad++;
+			bad += c.bad;
+		}
+	return bad;
+}
+
+// every bucket of span ms of every series against all the readings
+static long Check_Rollup(struct store * s, int64_t span, long * buckets)
+{
+	struct expect e;
+	long bad = 0;
+	int node, q;
+
+	*buckets = 0;
+	for (node = 0; node < nodes; node++)
+		for (q = STORE_TEMPERATURE; q <= STORE_GAS; q++)
+		{
+			memset(&e, 0, sizeof (e));
+			e.node = node;
+			e.quantity = q;
+			Store_Rollup(s, STORE_SERIES(node, q), INT64_MIN, INT64_MAX, span, On_Bucket, &e);
+			if (e.step != steps_n)
+				e.bad++;
+			bad += e.bad;
+			*buckets += e.buckets;
+		}
+	return bad;
+}
+
+int main(int argc, char * argv[])
+{
+	struct store * s;
+	static const int64_t span[STORE_LEVELS] = { STORE_MINUTE, STORE_HOUR, STORE_DAY };
+	struct check c;
+	struct chart ch;
+	char dir[256] = "";
+	char path[300];
+	uint64_t bytes, points, rng;
+	double t, paused, ingest, open_time, decode, minmax, raw, rolled;
+	long steps, step, queries = 10000, decoded = 0, summed = 0, bad = 0, k, buckets, charts, buckets_rolled = 0;
+	double window = 3600;
+	int keep = 0, failed = 0, opt, node, q, level;
+	float min, max;
+	int64_t from;
+	uint32_t series;
+
+	while ((opt = getopt(argc, argv, "n:T:i:q:w:d:s:k")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			nodes = atoi(optarg);
+			break;
+		case 'T':
+			seconds = atof(optarg);
+			break;
+		case 'i':
+			interval = atol(optarg);
+			break;
+		case 'q':
+			queries = atol(optarg);
+			break;
+		case 'w':
+			window = atof(optarg);
+			break;
+		case 'd':
+			snprintf(dir, sizeof (dir), "%s", optarg);
+			break;
+		case 's':
+			seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'k':
+			keep = 1;
+			break;
+		default:
+			nodes = 0;
+			break;
+		}
+	}
+	steps = steps_n = (long)(seconds * 1000 / (interval > 0 ? interval : 1));
+	if (nodes < 1 || nodes > (1 << 16) || interval <= JITTER_MS || steps < 1 || queries < 1 || window <= 0 ||
+		STORE_MAX_SERIES < 3 * nodes)
+	{
+		fprintf(stderr, "usage: %s [-n nodes] [-T seconds] [-i ms] [-q queries] [-w seconds] [-d dir] [-s seed] [-k]\n",
+				argv[0]);
+		return 2;
+	}
+	if (dir[0] == 0)
+	{
+		snprintf(dir, sizeof (dir), "/tmp/store_bench.XXXXXX");
+		if (mkdtemp(dir) == NULL)
+		{
+			perror("mkdtemp");
+			return 1;
+		}
+	}
+
+	s = Store_Open(dir);
+	if (s == NULL)
+	{
+		perror(dir);
+		return 1;
+	}
+	t = Now();
+	for (step = 0; step < steps; step++)
+	{
+		if (step == steps / 2)
+		{
+			if (Store_Flush(s) < 0)
+				failed = 1;
+			// a point before the last one is refused, with the chunk written out
+			if (step > 0 && Store_Append(s, STORE_SERIES(0, STORE_TEMPERATURE), START_MS - 1, 0) == 0)
+				failed = 1;
+			// read while it grows, the index and rollups are mapped here
+			// and their new records merged in at the end; not timed
+			paused = Now();
+			if (Check_Points(s, step))
+				failed = 1;
+			for (level = 0; level < STORE_LEVELS; level++)
+				Store_Rollup(s, STORE_SERIES(0, STORE_TEMPERATURE), INT64_MIN, INT64_MAX, span[level], On_Chart,
+							 &buckets_rolled);
+			t += Now() - paused;
+		}
+		for (node = 0; node < nodes; node++)
+			for (q = STORE_TEMPERATURE; q <= STORE_GAS; q++)
+				if (Store_Append(s, STORE_SERIES(node, q), Time(node, step), Value(node, q, step)) < 0)
+					failed = 1;
+	}
+	ingest = Now() - t;
+	if (Check_Points(s, steps))
+	{
+		printf("points wrong or missing before the store was closed\n");
+		failed = 1;
+	}
+	for (level = 0; level < STORE_LEVELS; level++)
+		if (Check_Rollup(s, span[level], &buckets))
+		{
+			printf("buckets of %lld s wrong or missing before the store was closed\n",
+				   (long long)span[level] / 1000);
+			failed = 1;
+		}
+	buckets_rolled = 0;
+	Store_Close(s);
+
+	t = Now();
+	s = Store_Open(dir);
+	open_time = Now() - t;
+	if (s == NULL)
+	{
+		perror(dir);
+		return 1;
+	}
+	Store_Size(s, &bytes, &points);
+	printf("%d nodes, %ld readings each of 3 series, every %ld ms\n", nodes, steps, interval);
+	printf("ingest  %10.0f points/s, %lu points in %.2f MB, %.2f bytes a point, %.1fx smaller than 12\n",
+		   points / ingest, (unsigned long)points, bytes / 1e6, (double)bytes / points, 12.0 * points / bytes);
+	printf("open    %10.3f ms\n", open_time * 1e3);
+	if (points != (uint64_t)steps * nodes * 3)
+		failed = 1;
+	// and after the store was opened again
+	if (steps > 0 && Store_Append(s, STORE_SERIES(0, STORE_TEMPERATURE), START_MS - 1, 0) == 0)
+	{
+		printf("a point before the last one was taken\n");
+		failed = 1;
+	}
+
+	// everything back, point by point
+	bad = Check_Points(s, steps);
+	printf("check   %10ld points wrong or missing\n", bad);
+	if (bad)
+		failed = 1;
+	for (level = 0; level < STORE_LEVELS; level++)
+	{
+		bad = Check_Rollup(s, span[level], &buckets);
+		printf("rollup  %10ld buckets of %lld s wrong or missing, of %ld\n", bad, (long long)span[level] / 1000,
+			   buckets);
+		if (bad)
+			failed = 1;
+	}
+
+	// queries over random windows, the same windows for both kinds
+	rng = seed;
+	t = Now();
+	for (k = 0; k < queries; k++)
+	{
+		series = Window(&rng, &from);
+		memset(&c, 0, sizeof (c));
+		c.min = INFINITY;
+		c.max = -INFINITY;
+		Store_Query(s, series, from, from + (int64_t)(window * 1000), On_Point, &c);
+		decoded += c.step;
+	}
+	decode = Now() - t;
+	rng = seed;
+	t = Now();
+	for (k = 0; k < queries; k++)
+	{
+		series = Window(&rng, &from);
+		summed += (long)Store_MinMax(s, series, from, from + (int64_t)(window * 1000), &min, &max);
+	}
+	minmax = Now() - t;
+	printf("query   %10.0f queries/s, %.0f points/s decoded, %.0f points a query\n", queries / decode,
+		   decoded / decode, (double)decoded / queries);
+	printf("min/max %10.0f queries/s, %.0f points/s summarised\n", queries / minmax, summed / minmax);
+	if (summed != decoded)
+		failed = 1;
+
+	// min and max from the index against those of the points
+	rng = seed;
+	for (k = 0; k < queries && k < 1000; k++)
+	{
+		series = Window(&rng, &from);
+		memset(&c, 0, sizeof (c));
+		c.min = INFINITY;
+		c.max = -INFINITY;
+		Store_Query(s, series, from, from + (int64_t)(window * 1000), On_Point, &c);
+		Store_MinMax(s, series, from, from + (int64_t)(window * 1000), &min, &max);
+		if (c.step && (min != c.min || max != c.max))
+		{
+			printf("min/max of series %u from %lld differ\n", series, (long long)from);
+			failed = 1;
+		}
+	}
+
+	// charts of a series over all the readings
+	charts = queries / 10 > 0 ? queries / 10 : 1;
+	memset(&ch, 0, sizeof (ch));
+	ch.span = (int64_t)(seconds * 1000 / CHART_BUCKETS);
+	if (ch.span < 1)
+		ch.span = 1;
+	rng = seed;
+	t = Now();
+	for (k = 0; k < charts; k++)
+	{
+		series = Window(&rng, &from);
+		ch.count = 0;
+		Store_Query(s, series, START_MS, START_MS + (int64_t)(seconds * 1000) + JITTER_MS, On_Raw, &ch);
+		ch.buckets += ch.count > 0;
+	}
+	raw = Now() - t;
+	rng = seed;
+	t = Now();
+	for (k = 0; k < charts; k++)
+	{
+		series = Window(&rng, &from);
+		Store_Rollup(s, series, START_MS, START_MS + (int64_t)(seconds * 1000) + JITTER_MS, ch.span, On_Chart,
+					 &buckets_rolled);
+	}
+	rolled = Now() - t;
+	printf("chart   %10.0f charts/s from the points, %.0f from the rollups, %.1fx, %ld s a bucket\n",
+		   charts / raw, charts / rolled, raw / rolled, (long)(ch.span / 1000));
+	printf("        %ld buckets a chart from the points, %ld from the rollups\n", ch.buckets / charts,
+		   buckets_rolled / charts);
+	Store_Close(s);
+
+	if (!keep)
+	{
+		snprintf(path, sizeof (path), "%s/data", dir);
+		unlink(path);
+		snprintf(path, sizeof (path), "%s/index", dir);
+		unlink(path);
+		for (level = 0; level < STORE_LEVELS; level++)
+		{
+			snprintf(path, sizeof (path), "%s/rollup.%lld", dir, (long long)span[level] / 1000);
+			unlink(path);
+		}
+		rmdir(dir);
+	}
+	return failed;
+}
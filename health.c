@@ -0,0 +1,89 @@
+#include "health.h"
+#include "config.h"
+#include "delay.h"
+#include "event.h"
+#include "gas_lighting.h"
+#include "rs485.h"
+#include "trace.h"
+#include "uart.h"
+
+uint16_t health_count[HEALTH_COUNTERS];
+uint8_t health_adc_seen;
+
+// values of the counters other modules keep, at the last reset
+uint32_t health_reset_ms;
+unsigned int health_base_tx_dropped;
+unsigned int health_base_trace_dropped;
+uint8_t health_base_events_dropped;
+
+static uint8_t Health_EventsDropped(void)
+{
+	return rs485_events.dropped + uart_events.dropped + timer_events.dropped + adc_events.dropped;
+}
+
+static uint8_t Health_EventHigh(void)
+{
+	uint8_t high = rs485_events.high;
+	
+	if (timer_events.high > high) high = timer_events.high;
+	if (adc_events.high > high) high = adc_events.high;
+	if (uart_events.high > high) high = uart_events.high;
+	return high;
+}
+
+void Health_Count(uint8_t counter)
+{
+	if (health_count[counter] != 0xFFFF)
+		health_count[counter]++;
+}
+
+void Health_AdcSeen(uint8_t channel)
+{
+	health_adc_seen |= 1 << channel;
+}
+
+void Health_AdcCheck(void)
+{
+	if (!(health_adc_seen & (1 << GAS_CHANNEL)))
+		Health_Count(HEALTH_ADC_TIMEOUT);
+	if (!(health_adc_seen & (1 << LIGHTING_CHANNEL)))
+		Health_Count(HEALTH_ADC_TIMEOUT);
+	health_adc_seen = 0;
+}
+
+void Health_Fill(struct HealthData * data)
+{
+	uint16_t boot = 0;
+	uint8_t i;
+	
+	Config_Read(CONFIG_KEY_BOOT, &boot, sizeof (boot));
+	data->uptime = Millis() / 1000;
+	data->since_reset = (Millis() - health_reset_ms) / 1000;
+	data->boot = boot;
+	for (i = 0; i < HEALTH_COUNTERS; i++)
+		data->counters[i] = health_count[i];
+	data->uart_tx_dropped = UART_TxDropped() - health_base_tx_dropped;
+	data->trace_dropped = Trace_Dropped() - health_base_trace_dropped;
+	data->events_dropped = (uint8_t)(Health_EventsDropped() - health_base_events_dropped);
+	data->rs485_rx_high = RS485_RxHigh();
+	data->uart_tx_high = UART_TxHigh();
+	data->event_high = Health_EventHigh();
+}
+
+void Health_Reset(void)
+{
+	uint8_t i;
+	
+	for (i = 0; i < HEALTH_COUNTERS; i++)
+		health_count[i] = 0;
+	health_reset_ms = Millis();
+	health_base_tx_dropped = UART_TxDropped();
+	health_base_trace_dropped = Trace_Dropped();
+	health_base_events_dropped = Health_EventsDropped();
+	RS485_ClearRxHigh();
+	UART_ClearTxHigh();
+	rs485_events.high = 0;
+	uart_events.high = 0;
+	timer_events.high = 0;
+	adc_events.high = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef _health_h_
+#define _health_h_
+
+#include "stm8s.h"
+#include "packet.h"
+
+// Link and sensor fault counters for CMD_QUERY_HEALTH, saturating at
+// 0xFFFF. Counted from the main loop only; the ISR side counters are
+// read from their modules when the reply is filled.
+#define HEALTH_FRAMES			0	// frames taken from the RS485 ring
+#define HEALTH_NOT_ADDRESSED	1	// neither our id nor broadcast
+#define HEALTH_BAD_CHECKSUM		2
+#define HEALTH_RX_OVERRUN		3	// bytes dropped on a full RS485 ring
+#define HEALTH_RX_TIMEOUT		4	// partial frames dropped
+#define HEALTH_ONEWIRE_CRC		5	// ROM or scratchpad CRC mismatch
+#define HEALTH_ONEWIRE_PRESENCE	6	// reset without a presence pulse
+#define HEALTH_ADC_TIMEOUT		7	// a channel gave no reading for a check period
+#define HEALTH_COUNTERS			8	// size of HealthData.counters
+
+// ms between ADC checks, well above the 32 ms a decimated reading takes
+#ifndef HEALTH_ADC_PERIOD
+#define HEALTH_ADC_PERIOD		1000
+#endif
+
+void Health_Count(uint8_t counter);
+
+// Marks a fresh reading on an ADC channel.
+void Health_AdcSeen(uint8_t channel);
+
+// Counts the channels not seen since the last call, every HEALTH_ADC_PERIOD.
+void Health_AdcCheck(void);
+
+void Health_Fill(struct HealthData * data);
+
+// Zeroes the counters and the high-water marks.
+void Health_Reset(void);
+
+#endif
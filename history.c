@@ -0,0 +1,277 @@
+#include "history.h"
+#include "codec.h"
+#include "config.h"
+#include "delay.h"
+#include "flash.h"
+#include "one_wire.h"
+#include <string.h>
+
+#define HISTORY_FIRST_BLOCK	((HISTORY_START - FLASH_PROG_START_PHYSICAL_ADDRESS) / FLASH_BLOCK_SIZE)
+#define HISTORY_ADDR(seq)	(HISTORY_START + (uint32_t)((seq) % HISTORY_BLOCKS) * FLASH_BLOCK_SIZE)
+
+union history_block
+{
+	struct
+	{
+		struct history_header header;
+		struct HistoryRecord records[HISTORY_RECORDS];
+	} b;
+	char raw[FLASH_BLOCK_SIZE];
+};
+
+// the block being filled, its seq is one past the newest block in flash
+static union history_block history_block;
+static uint8_t history_count;
+static uint32_t history_oldest;		// seq of the oldest block in flash
+
+static uint16_t history_boot;
+static uint32_t history_seconds;
+static uint32_t history_last_ms;
+static unsigned int history_ms;
+static uint32_t history_next_record;
+
+static uint8_t History_Crc(union history_block * block)
+{
+	uint8_t saved = block->b.header.crc;
+	uint8_t crc;
+	
+	block->b.header.crc = 0;
+	crc = OneWire_crc8((uint8_t *)block->raw, FLASH_BLOCK_SIZE);
+	block->b.header.crc = saved;
+	return crc;
+}
+
+static uint8_t History_Valid(struct history_header * header, uint32_t seq)
+{
+	return header->magic == HISTORY_MAGIC && header->seq == seq;
+}
+
+// Reads a flash block into buf, returns 1 if it holds block seq.
+static uint8_t History_Load(uint32_t seq, union history_block * buf)
+{
+	flash_read_prog(HISTORY_ADDR(seq), buf->raw, FLASH_BLOCK_SIZE);
+	return History_Valid(&buf->b.header, seq) && History_Crc(buf) == buf->b.header.crc;
+}
+
+static void History_Start(uint32_t seq)
+{
+	memset(&history_block, 0, sizeof (history_block));
+	history_block.b.header.magic = HISTORY_MAGIC;
+	history_block.b.header.boot = history_boot;
+	history_block.b.header.seq = seq;
+	history_block.b.header.start = history_seconds;
+	history_count = 0;
+}
+
+void History_Init(void)
+{
+	uint32_t newest = 0;
+	uint8_t found = 0;
+	uint8_t i;
+	
+	if (Config_Read(CONFIG_KEY_BOOT, &history_boot, sizeof (history_boot)) != sizeof (history_boot))
+		history_boot = 0;
+	history_boot++;
+	Config_Write(CONFIG_KEY_BOOT, &history_boot, sizeof (history_boot));
+	
+	// find the newest block, then walk back over the ones before it
+	for (i = 0; i < HISTORY_BLOCKS; i++)
+	{
+		struct history_header * header = &history_block.b.header;
+		
+		flash_read_prog(HISTORY_START + (uint32_t)i * FLASH_BLOCK_SIZE,
+						history_block.raw, sizeof (struct history_header));
+		if (header->magic == HISTORY_MAGIC && header->seq % HISTORY_BLOCKS == i &&
+			(!found || header->seq > newest) &&
+			History_Load(header->seq, &history_block))
+		{
+			newest = history_block.b.header.seq;
+			found = 1;
+		}
+	}
+	
+	history_oldest = newest;
+	while (found && history_oldest > 0 && newest - history_oldest < HISTORY_BLOCKS - 1 &&
+		   History_Load(history_oldest - 1, &history_block))
+		history_oldest--;
+	
+	history_last_ms = Millis();
+	history_next_record = HISTORY_PERIOD;
+	History_Start(found ? newest + 1 : 0);
+	if (!found)
+		history_oldest = 0;
+}
+
+uint8_t History_Due(void)
+{
+	uint32_t now = Millis();
+	
+	history_ms += (unsigned int)(now - history_last_ms);
+	history_last_ms = now;
+	while (history_ms >= 1000)
+	{
+		history_ms -= 1000;
+		history_seconds++;
+	}
+	
+	if ((int32_t)(history_seconds - history_next_record) < 0)
+		return 0;
+	history_next_record += HISTORY_PERIOD;
+	return 1;
+}
+
+void History_Add(int16_t temperature, uint16_t lighting, uint16_t gas)
+{
+	struct HistoryRecord * rec = &history_block.b.records[history_count++];
+	uint32_t seq = history_block.b.header.seq;
+	
+	rec->time = (uint16_t)(history_seconds - history_block.b.header.start);
+	rec->temperature = temperature;
+	rec->lighting = lighting;
+	rec->gas = gas;
+	if (history_count < HISTORY_RECORDS)
+		return;
+	
+	history_block.b.header.crc = History_Crc(&history_block);
+	flash_write_prog_block(HISTORY_FIRST_BLOCK + seq % HISTORY_BLOCKS, history_block.raw);
+	// the block overwrote seq - HISTORY_BLOCKS
+	if (seq - history_oldest >= HISTORY_BLOCKS)
+		history_oldest = seq + 1 - HISTORY_BLOCKS;
+	History_Start(seq + 1);
+}
+
+// Moves first to the oldest record still stored, or past blocks that
+// cannot be read back. Returns the records from first to the end of its
+// block, counting only what was added to the block in RAM.
+static uint8_t History_Locate(uint32_t * first, struct history_header * header)
+{
+	uint32_t head = history_block.b.header.seq;
+	uint32_t seq = *first / HISTORY_RECORDS;
+	uint8_t index = *first % HISTORY_RECORDS;
+	
+	if (seq < history_oldest)
+	{
+		seq = history_oldest;
+		index = 0;
+	}
+	
+	for (; seq < head; seq++, index = 0)
+	{
+		flash_read_prog(HISTORY_ADDR(seq), (char *)header, sizeof (struct history_header));
+		if (History_Valid(header, seq))
+		{
+			*first = seq * HISTORY_RECORDS + index;
+			return HISTORY_RECORDS - index;
+		}
+	}
+	
+	// the block still in RAM
+	*header = history_block.b.header;
+	if (seq > head || index > history_count)
+		index = history_count;
+	*first = head * HISTORY_RECORDS + index;
+	return history_count - index;
+}
+
+static void History_Copy(uint32_t first, struct HistoryRecord * out, uint8_t count)
+{
+	uint32_t seq = first / HISTORY_RECORDS;
+	uint8_t index = first % HISTORY_RECORDS;
+	
+	if (seq == history_block.b.header.seq)
+		memcpy(out, &history_block.b.records[index], count * sizeof (struct HistoryRecord));
+	else
+		flash_read_prog(HISTORY_ADDR(seq) + sizeof (struct history_header) + index * sizeof (struct HistoryRecord),
+						(char *)out, count * sizeof (struct HistoryRecord));
+}
+
+uint8_t History_Read(uint32_t first, uint8_t * out)
+{
+	struct history_header header;
+	struct HistoryData data;
+	struct HistoryRecord rec;
+	uint8_t count = History_Locate(&first, &header);
+	uint8_t i, len;
+	
+	data.first = first;
+	data.next = first + count;
+	data.boot = header.boot;
+	data.start = header.start;
+	data.count = count;
+	len = putHistoryData(out, &data);
+	for (i = 0; i < count; i++)
+	{
+		History_Copy(first + i, &rec, 1);
+		len += putHistoryRecord(out + len, &rec);
+	}
+	return len;
+}
+
+uint8_t History_ReadPacked(uint32_t first, uint8_t * out, uint8_t size)
+{
+	struct codec codec;
+	struct HistoryPacked data;
+	struct history_header header, next;
+	struct HistoryRecord rec[CODEC_GROUP];
+	int16_t rows[CODEC_GROUP][HISTORY_CHANNELS];
+	uint8_t count = History_Locate(&first, &header);
+	uint32_t pos = first;
+	uint8_t n = 0;
+	
+	data.first = first;
+	data.boot = header.boot;
+	data.start = header.start;
+	data.period = HISTORY_PERIOD;
+	Codec_Init(&codec, HISTORY_CHANNELS, out + HISTORY_PACKED_SIZE, size - HISTORY_PACKED_SIZE);
+	
+	while (n <= 0xFF - CODEC_GROUP)
+	{
+		uint8_t take = 0;
+		
+		// the decoder expects full groups up to the last one, so gather
+		// across blocks of the same boot
+		while (take < CODEC_GROUP)
+		{
+			uint8_t k, i;
+			
+			if (count == 0)
+			{
+				uint32_t at = pos;
+				
+				count = History_Locate(&at, &next);
+				if (at != pos || next.boot != header.boot)
+					count = 0;
+				if (count == 0)
+					break;
+				header = next;
+			}
+			k = count < CODEC_GROUP - take ? count : CODEC_GROUP - take;
+			History_Copy(pos, rec, k);
+			for (i = 0; i < k; i++)
+			{
+				uint8_t row = take + i;
+				
+				// time against the nominal schedule, constant while on time
+				rows[row][0] = (int16_t)(header.start + rec[i].time - data.start -
+										 (uint32_t)(n + row) * HISTORY_PERIOD);
+				rows[row][1] = rec[i].temperature;
+				rows[row][2] = (int16_t)rec[i].lighting;
+				rows[row][3] = (int16_t)rec[i].gas;
+			}
+			take += k;
+			count -= k;
+			pos += k;
+		}
+		
+		if (take == 0 || !Codec_Put(&codec, &rows[0][0], take))
+			break;
+		n += take;
+		if (take < CODEC_GROUP)
+			break;
+	}
+	
+	data.next = first + n;
+	data.count = n;
+	putHistoryPacked(out, &data);
+	return HISTORY_PACKED_SIZE + Codec_Length(&codec);
+}
@@ -0,0 +1,55 @@
+#ifndef _history_h_
+#define _history_h_
+
+#include "stm8s.h"
+#include "packet.h"
+
+// Ring of samples in the top HISTORY_BLOCKS blocks of program flash. The
+// application must link below HISTORY_START, where IAR/SenseHost.icf
+// ends the code regions; move that end with HISTORY_BLOCKS. Records
+// collect in a RAM block that is programmed in one cycle when it is
+// full; a reset loses at most the records in RAM.
+
+#ifndef HISTORY_PERIOD
+#define HISTORY_PERIOD		60		// s between records
+#endif
+#if HISTORY_PERIOD > 4000
+#error "a block of records must span less than the 16 bit record time"
+#endif
+#ifndef HISTORY_BLOCKS
+#define HISTORY_BLOCKS		64		// 8 KB
+#endif
+
+#define HISTORY_START		(FLASH_PROG_END_PHYSICAL_ADDRESS + 1 - (uint32_t)HISTORY_BLOCKS * FLASH_BLOCK_SIZE)
+#define HISTORY_MAGIC		0xB5
+
+struct history_header
+{
+	uint8_t magic;
+	uint8_t crc;		// OneWire_crc8 of the block with this byte 0
+	uint16_t boot;
+	uint32_t seq;		// block number since the log was started
+	uint32_t start;		// s after boot
+};
+
+#define HISTORY_RECORDS		((FLASH_BLOCK_SIZE - sizeof (struct history_header)) / sizeof (struct HistoryRecord))
+
+// Bumps the boot count and finds the newest block in flash.
+void History_Init(void);
+
+// Keeps the clock, call every second. Returns 1 when a record is due.
+uint8_t History_Due(void);
+
+void History_Add(int16_t temperature, uint16_t lighting, uint16_t gas);
+
+#define HISTORY_CHANNELS	4	// time, temperature, lighting, gas
+
+// Writes a struct HistoryData reply with the records from index first to
+// the end of its block at out, returns its length.
+uint8_t History_Read(uint32_t first, uint8_t * out);
+
+// Same from index first on, across the blocks of one boot, delta coded
+// by codec.c into a struct HistoryPacked of at most size bytes.
+uint8_t History_ReadPacked(uint32_t first, uint8_t * out, uint8_t size);
+
+#endif
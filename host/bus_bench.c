@@ -0,0 +1,590 @@
+// How many nodes one master can poll on a segment: N copies of the
+// firmware, each in its own process on the simulated part, share a half
+// duplex RS485 bus with a reference master that sends CMD_QUERY to each
+// id in turn.
+//
+//   cmake -S . -B build && cmake --build build
+//   ./build/bus_bench -n 1,2,4,8,16 -b 19200,57600,115200 -c 50
+//
+//   -n  node counts to try, ids DEV_MY_THESIS + 1 upwards
+//   -b  baud rates to try, the nodes' UART1 is forced to the rate
+//   -c  poll cycles per run, a cycle queries every node once
+//   -t  master turnaround in us: quiet time after a reply before it
+//       drives the bus again
+//   -w  master timeout in ms for the first byte of a reply; once it
+//       comes a gap of REPLY_GAP bytes ends the reply
+//   -B  ground every node's select pin and end each cycle with a
+//       broadcast query, which every node answers at once
+//
+// The bus moves in steps of a quarter byte. Each step the nodes run to
+// the end of it and report the bytes they shifted out and the edges of
+// their driver enable pin. A byte is settled once every driver has run
+// past its stop bit: it collided if it overlapped a byte of another
+// driver or another enabled driver, and then reaches the receivers
+// inverted, once for all the bytes it overlapped. Nodes with their own
+// driver enabled hear nothing. Nodes see a byte one step after its stop
+// bit, the master right at it; that step is what lockstep costs and is
+// part of the latency reported.
+//
+// Latency runs from the stop bit of the query to the stop bit of the
+// reply, the cycle from the first query of a cycle to the first of the
+// next. After anything but a good reply the master waits for the bus to
+// go quiet before the next query. Without -B a run with a timeout, a bad
+// reply or a collision fails.
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "hal.h"
+#include "eeprom_model.h"
+#include "packet.h"
+#include "config.h"
+#include "flash.h"
+#include "rs485.h"
+
+void firmware_main(void);
+
+#define MAX_NODES		32
+#define MASTER			MAX_NODES	// driver number of the master
+#define DRIVERS			(MAX_NODES + 1)
+#define BOOT_MS			2500		// 1-wire search and first conversion
+#define MASTER_HOLD		HAL_US(1)	// master enable after its stop bit
+#define REPLY_GAP		4			// bytes of silence that end a reply
+#define MAX_EVENTS		512
+#define MAX_BYTES		4096
+#define WINDOWS			16			// enable windows kept per driver
+#define NEVER			UINT64_MAX
+
+// one byte or enable edge, both ways over the socket of a node
+struct bus_event
+{
+	uint64_t time;
+	uint8_t c;
+	uint8_t kind;
+};
+
+#define EV_BYTE		0
+#define EV_RISE		1
+#define EV_FALL		2
+
+struct bus_msg
+{
+	uint64_t time;		// to the node: run until; back: where it stopped
+	uint16_t n;
+	struct bus_event ev[MAX_EVENTS];
+};
+
+#define MSG_SIZE(m)	(offsetof(struct bus_msg, ev) + (m)->n * sizeof (struct bus_event))
+
+struct bus_byte
+{
+	uint64_t start, end;
+	uint8_t c;
+	uint8_t driver;
+	uint8_t settled;
+	uint8_t collided;
+};
+
+struct window
+{
+	uint64_t rise, fall;
+};
+
+struct run
+{
+	int nodes;
+	uint32_t baud;
+	int cycles;
+	int polls, timeouts, bad;
+	uint32_t collided;
+	uint64_t cycle_sum;
+	uint64_t * latency;
+};
+
+static int sock[MAX_NODES];
+static pid_t pid[MAX_NODES];
+static struct bus_msg out[MAX_NODES];
+
+static struct bus_byte bus[MAX_BYTES];
+static int bus_n;
+static struct window window[DRIVERS][WINDOWS];
+static uint8_t window_n[DRIVERS];
+
+static uint64_t byte_time, step;
+static uint64_t turnaround = HAL_US(100);
+static uint64_t reply_timeout = HAL_MS(20);
+static int broadcast;
+
+/* Node side ----------------------------------------------------------------*/
+static struct bus_msg node_msg;
+static uint8_t node_de;
+
+static void Node_Output(GPIO_TypeDef * port)
+{
+	uint8_t de = (port->ODR & RS485_DIR_PIN) != 0;
+
+	if (port != RS485_DIR_PORT || de == node_de)
+		return;
+	node_de = de;
+	if (node_msg.n < MAX_EVENTS)
+	{
+		node_msg.ev[node_msg.n].time = HAL_Now();
+		node_msg.ev[node_msg.n].kind = de ? EV_RISE : EV_FALL;
+		node_msg.n++;
+	}
+}
+
+static void Node_Collect(void)
+{
+	uint8_t c[MAX_EVENTS];
+	uint64_t when[MAX_EVENTS];
+	int i, n;
+
+	n = HAL_UartSent(HAL_UART1, c, when, MAX_EVENTS - node_msg.n);
+	for (i = 0; i < n; i++)
+	{
+		node_msg.ev[node_msg.n].time = when[i];
+		node_msg.ev[node_msg.n].c = c[i];
+		node_msg.ev[node_msg.n].kind = EV_BYTE;
+		node_msg.n++;
+	}
+}
+
+static void Node(int s, uint8_t id, uint32_t baud)
+{
+	struct flash_data data;
+	struct bus_msg in;
+	int i;
+
+	EepromModel_Reset(0);
+	Config_Init();
+	data.id = id;
+	Config_Write(CONFIG_KEY_ID, &data, sizeof (data));
+	HAL_UartBaud(HAL_UART1, baud);
+	HAL_Reset();
+	if (broadcast)
+		HAL_SetPin(RS485_SEL_PORT, RS485_SEL_PIN, 0);
+	HAL_OnOutput(Node_Output);
+	HAL_Run(firmware_main, HAL_MS(BOOT_MS));
+	Node_Collect();
+	node_msg.n = 0;
+
+	for (;;)
+	{
+		if (recv(s, &in, sizeof (in), 0) <= 0 || in.time == 0)
+			_exit(0);
+		for (i = 0; i < in.n; i++)
+			HAL_UartReceiveAt(HAL_UART1, in.ev[i].c, in.ev[i].time);
+		if (in.time > HAL_Now())
+			HAL_Run(firmware_main, in.time - HAL_Now());
+		Node_Collect();
+		node_msg.time = HAL_Now();
+		send(s, &node_msg, MSG_SIZE(&node_msg), 0);
+		node_msg.n = 0;
+	}
+}
+
+/* Bus ----------------------------------------------------------------------*/
+static void Window_Edge(int d, uint64_t t, uint8_t rise)
+{
+	struct window * w = window[d];
+
+	if (rise)
+	{
+		if (window_n[d] == WINDOWS)
+		{
+			memmove(w, w + 1, (WINDOWS - 1) * sizeof (*w));
+			window_n[d]--;
+		}
+		w[window_n[d]].rise = t;
+		w[window_n[d]].fall = NEVER;
+		window_n[d]++;
+	}
+	else if (window_n[d])
+		w[window_n[d] - 1].fall = t;
+}
+
+// whether driver d was enabled at some point of [from, to)
+static int Window_Overlaps(int d, uint64_t from, uint64_t to)
+{
+	int i;
+
+	for (i = 0; i < window_n[d]; i++)
+		if (window[d][i].rise < to && window[d][i].fall > from)
+			return 1;
+	return 0;
+}
+
+static void Bus_Add(int d, uint64_t start, uint8_t c)
+{
+	struct bus_byte * b;
+
+	if (bus_n == MAX_BYTES)
+	{
+		fprintf(stderr, "bus_bench: more than %d bytes in flight\n", MAX_BYTES);
+		exit(2);
+	}
+	b = &bus[bus_n++];
+	b->start = start;
+	b->end = start + byte_time;
+	b->c = c;
+	b->driver = (uint8_t)d;
+	b->settled = b->collided = 0;
+}
+
+static int By_End(const void * a, const void * b)
+{
+	const struct bus_byte * x = *(const struct bus_byte **)a, * y = *(const struct bus_byte **)b;
+
+	return x->end < y->end ? -1 : x->end > y->end;
+}
+
+// Settles the bytes whose stop bit every driver has run past, hands them
+// to the receivers and returns how many collided. The master's receiver
+// gets its bytes in rx.
+static int Bus_Settle(struct run * r, uint64_t horizon, uint8_t * rx, uint64_t * rx_end, int * rx_n)
+{
+	static struct bus_byte * ready[MAX_BYTES];
+	int i, j, k, n = 0, collided = 0;
+
+	for (i = 0; i < bus_n; i++)
+		if (!bus[i].settled && bus[i].end <= horizon)
+			ready[n++] = &bus[i];
+	qsort(ready, n, sizeof (ready[0]), By_End);
+
+	for (k = 0; k < n; k++)
+	{
+		struct bus_byte * b = ready[k];
+		uint8_t c;
+
+		for (j = 0; j < bus_n; j++)
+			if (bus[j].driver != b->driver && bus[j].start < b->end && bus[j].end > b->start)
+				b->collided = 1;
+		for (j = 0; j <= MASTER; j++)
+			if (j != b->driver && (j < r->nodes || j == MASTER) && Window_Overlaps(j, b->start, b->end))
+				b->collided = 1;
+		b->settled = 1;
+		collided += b->collided;
+		c = b->collided ? (uint8_t)~b->c : b->c;
+
+		// bytes on top of each other reach a receiver as one
+		for (j = 0; j < bus_n; j++)
+			if (&bus[j] != b && bus[j].settled && bus[j].driver != b->driver &&
+				bus[j].start < b->end && bus[j].end > b->start)
+				break;
+		if (j < bus_n)
+			continue;
+
+		for (j = 0; j < r->nodes; j++)
+		{
+			struct bus_msg * m = &out[j];
+
+			if (j == b->driver || Window_Overlaps(j, b->end - 1, b->end))
+				continue;
+			m->ev[m->n].time = b->end + step;
+			m->ev[m->n].c = c;
+			m->ev[m->n].kind = EV_BYTE;
+			m->n++;
+		}
+		if (b->driver != MASTER && !Window_Overlaps(MASTER, b->end - 1, b->end) && *rx_n < 256)
+		{
+			rx[*rx_n] = c;
+			rx_end[*rx_n] = b->end;
+			(*rx_n)++;
+		}
+	}
+	return collided;
+}
+
+static void Bus_Prune(uint64_t now)
+{
+	int i, n = 0;
+
+	for (i = 0; i < bus_n; i++)
+		if (!bus[i].settled || bus[i].end + 2 * byte_time >= now)
+			bus[n++] = bus[i];
+	bus_n = n;
+}
+
+/* Master -------------------------------------------------------------------*/
+#define M_IDLE		0
+#define M_WAIT		1
+
+static struct
+{
+	uint8_t state;
+	int node;			// next to poll, nodes for the broadcast
+	int cycle;
+	uint64_t next;		// earliest time to drive the bus again
+	uint64_t sent;		// stop bit of the query
+	uint64_t cycle_start;
+	uint8_t rx[256];
+	uint64_t rx_end[256];
+	int rx_n;
+} m;
+
+static void Master_Send(uint64_t now, uint8_t id)
+{
+	uint8_t frame[5];
+	int i;
+
+	frame[0] = id;
+	frame[1] = CMD_QUERY;
+	frame[2] = TYPE_BYTE;
+	frame[3] = 0;
+	frame[4] = checksum_len((char *)frame, 4);
+	for (i = 0; i < 5; i++)
+		Bus_Add(MASTER, now + i * byte_time, frame[i]);
+	Window_Edge(MASTER, now, 1);
+	Window_Edge(MASTER, now + 5 * byte_time + MASTER_HOLD, 0);
+	m.sent = now + 5 * byte_time;
+	m.rx_n = 0;
+	m.state = M_WAIT;
+}
+
+// whether the bytes so far are a whole, good reply from id
+static int Master_Reply(uint8_t id)
+{
+	int len;
+
+	if (m.rx_n < 4)
+		return 0;
+	len = IS_TYPE_BLOCK(m.rx[2]) ? 5 + m.rx[3] : 4 + getTypeLength(m.rx[2]);
+	return m.rx_n == len && m.rx[0] == id && m.rx[1] == CMD_QUERY &&
+		(uint8_t)checksum_len((char *)m.rx, len - 1) == m.rx[len - 1];
+}
+
+// Polls the nodes in turn, returns 1 once the last cycle is over.
+static int Master_Step(struct run * r, uint64_t now)
+{
+	int nodes = r->nodes + (broadcast ? 1 : 0);
+
+	if (m.state == M_IDLE)
+	{
+		if (now < m.next)
+			return 0;
+		if (m.node == nodes)
+		{
+			m.node = 0;
+			if (m.cycle > 0)
+				r->cycle_sum += now - m.cycle_start;
+			if (++m.cycle > r->cycles)
+				return 1;
+		}
+		if (m.node == 0)
+			m.cycle_start = now;
+		Master_Send(now, m.node < r->nodes ? (DEV_MY_THESIS + m.node + 1) : BROADCAST_ID);
+		return 0;
+	}
+
+	if (m.node < r->nodes && Master_Reply(DEV_MY_THESIS + m.node + 1))
+	{
+		uint64_t end = m.rx_end[m.rx_n - 1];
+
+		r->latency[r->polls++] = end - m.sent;
+		m.next = end + turnaround;
+		m.state = M_IDLE;
+		m.node++;
+	}
+	else if (m.rx_n ? now >= m.rx_end[m.rx_n - 1] + REPLY_GAP * byte_time : now >= m.sent + reply_timeout)
+	{
+		// garbage or nothing, or the end of the answers to a broadcast
+		if (m.node < r->nodes && m.rx_n)
+			r->bad++;
+		else if (m.node < r->nodes)
+			r->timeouts++;
+		m.next = now + turnaround;
+		m.state = M_IDLE;
+		m.node++;
+	}
+	return 0;
+}
+
+/* Runs ---------------------------------------------------------------------*/
+static void Run(struct run * r)
+{
+	struct bus_msg in;
+	uint64_t now = HAL_MS(BOOT_MS), horizon;
+	int i, j, done = 0;
+
+	byte_time = HAL_CPU_HZ * 10 / r->baud;
+	step = byte_time / 4;
+	bus_n = 0;
+	memset(window_n, 0, sizeof (window_n));
+	memset(&m, 0, sizeof (m));
+	m.next = now;
+	m.node = r->nodes + (broadcast ? 1 : 0);
+
+	fflush(stdout);
+	for (i = 0; i < r->nodes; i++)
+	{
+		int sv[2];
+
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+		{
+			perror("socketpair");
+			exit(2);
+		}
+		pid[i] = fork();
+		if (pid[i] == 0)
+		{
+			for (j = 0; j < i; j++)
+				close(sock[j]);
+			close(sv[0]);
+			Node(sv[1], DEV_MY_THESIS + i + 1, r->baud);
+		}
+		close(sv[1]);
+		sock[i] = sv[0];
+		out[i].n = 0;
+	}
+
+	while (!done)
+	{
+		done = Master_Step(r, now);
+		now += step;
+		horizon = now;
+		for (i = 0; i < r->nodes; i++)
+		{
+			out[i].time = done ? 0 : now;
+			send(sock[i], &out[i], MSG_SIZE(&out[i]), 0);
+			out[i].n = 0;
+		}
+		if (done)
+			break;
+		for (i = 0; i < r->nodes; i++)
+		{
+			if (recv(sock[i], &in, sizeof (in), 0) <= 0)
+			{
+				fprintf(stderr, "bus_bench: node %d is gone\n", i);
+				exit(2);
+			}
+			for (j = 0; j < in.n; j++)
+			{
+				if (in.ev[j].kind == EV_BYTE)
+					Bus_Add(i, in.ev[j].time, in.ev[j].c);
+				else
+					Window_Edge(i, in.ev[j].time, in.ev[j].kind == EV_RISE);
+			}
+			if (in.time < horizon)
+				horizon = in.time;
+		}
+		r->collided += Bus_Settle(r, horizon, m.rx, m.rx_end, &m.rx_n);
+		Bus_Prune(now);
+	}
+
+	for (i = 0; i < r->nodes; i++)
+	{
+		close(sock[i]);
+		waitpid(pid[i], NULL, 0);
+	}
+}
+
+static int By_Value(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double Us(uint64_t cycles)
+{
+	return cycles / (double)(HAL_CPU_HZ / 1000000);
+}
+
+static uint64_t Percentile(const struct run * r, int p)
+{
+	if (r->polls == 0)
+		return 0;
+	return r->latency[(r->polls - 1) * p / 100];
+}
+
+static int Parse(const char * s, long * v, int max)
+{
+	int n = 0;
+	char * end;
+
+	while (*s && n < max)
+	{
+		v[n++] = strtol(s, &end, 10);
+		if (end == s)
+			return 0;
+		s = *end == ',' ? end + 1 : end;
+	}
+	return n;
+}
+
+int main(int argc, char * argv[])
+{
+	long nodes[16] = {1, 2, 4, 8}, bauds[16] = {115200};
+	int nodes_n = 4, bauds_n = 1, cycles = 20, failed = 0;
+	int i, j, opt;
+
+	while ((opt = getopt(argc, argv, "n:b:c:t:w:B")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			nodes_n = Parse(optarg, nodes, 16);
+			break;
+		case 'b':
+			bauds_n = Parse(optarg, bauds, 16);
+			break;
+		case 'c':
+			cycles = atoi(optarg);
+			break;
+		case 't':
+			turnaround = HAL_US(atol(optarg));
+			break;
+		case 'w':
+			reply_timeout = HAL_MS(atol(optarg));
+			break;
+		case 'B':
+			broadcast = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n nodes,...] [-b baud,...] [-c cycles] [-t us] [-w ms] [-B]\n",
+					argv[0]);
+			return 2;
+		}
+	}
+	for (i = 0; i < nodes_n; i++)
+		if (nodes[i] < 1 || nodes[i] > MAX_NODES)
+		{
+			fprintf(stderr, "bus_bench: 1 to %d nodes\n", MAX_NODES);
+			return 2;
+		}
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("turnaround %.0f us, reply timeout %.0f ms, %d cycles%s\n", Us(turnaround),
+		   Us(reply_timeout) / 1000, cycles, broadcast ? ", broadcast" : "");
+	printf("nodes    baud  cycle ms  polls/s  p50 us  p90 us  p99 us  max us  timeouts  bad  collided\n");
+	for (j = 0; j < bauds_n; j++)
+	{
+		for (i = 0; i < nodes_n; i++)
+		{
+			struct run r;
+
+			memset(&r, 0, sizeof (r));
+			r.nodes = (int)nodes[i];
+			r.baud = (uint32_t)bauds[j];
+			r.cycles = cycles;
+			r.latency = malloc(sizeof (uint64_t) * (cycles + 1) * r.nodes);
+			Run(&r);
+			qsort(r.latency, r.polls, sizeof (uint64_t), By_Value);
+			printf("%5d  %6lu  %8.2f  %7.0f  %6.0f  %6.0f  %6.0f  %6.0f  %8d  %3d  %8lu\n",
+				   r.nodes, (unsigned long)r.baud, Us(r.cycle_sum / cycles) / 1000,
+				   r.polls ? r.nodes * 1e6 / Us(r.cycle_sum / cycles) : 0.0,
+				   Us(Percentile(&r, 50)), Us(Percentile(&r, 90)), Us(Percentile(&r, 99)),
+				   Us(Percentile(&r, 100)), r.timeouts, r.bad, (unsigned long)r.collided);
+			if (!broadcast && (r.timeouts || r.bad || r.collided))
+				failed = 1;
+			free(r.latency);
+		}
+	}
+	return failed;
+}
@@ -0,0 +1,214 @@
+// Captures the traffic of an RS485 segment through a Linux serial
+// adapter into a capture file (host/capture.h), for bus_replay.
+//
+//   ./bus_capture [-b baud] [-t seconds] -o field.cap /dev/ttyUSB0
+//   ./bus_capture -p field.cap        prints a capture, one record a line
+//
+// The adapter only listens, its driver stays off. Capture runs until
+// Ctrl-C or for -t seconds. Each read() becomes one record, stamped
+// when the read returns: a record may hold several frames or part of
+// one, and the time carries the latency of the adapter. For FTDI parts
+// set /sys/bus/usb-serial/devices/ttyUSB0/latency_timer to 1 first, or
+// bursts that were apart on the bus end up in one record.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "capture.h"
+
+static volatile sig_atomic_t stop;
+
+static void Stop(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+static speed_t Speed(long baud)
+{
+	switch (baud)
+	{
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	default: return 0;
+	}
+}
+
+static int Open(const char * dev, long baud)
+{
+	struct termios tio;
+	int fd = open(dev, O_RDONLY | O_NOCTTY);
+
+	if (fd < 0)
+	{
+		perror(dev);
+		return -1;
+	}
+	if (tcgetattr(fd, &tio) < 0)
+	{
+		perror(dev);
+		close(fd);
+		return -1;
+	}
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, Speed(baud));
+	cfsetospeed(&tio, Speed(baud));
+	if (tcsetattr(fd, TCSANOW, &tio) < 0)
+	{
+		perror(dev);
+		close(fd);
+		return -1;
+	}
+	tcflush(fd, TCIFLUSH);
+	return fd;
+}
+
+static uint64_t Now_Us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int Capture(const char * dev, long baud, const char * out, int seconds)
+{
+	static struct capture_record r;
+	struct sigaction sa;
+	uint64_t start;
+	unsigned long records = 0, bytes = 0;
+	FILE * f;
+	int fd, n;
+
+	fd = Open(dev, baud);
+	if (fd < 0)
+		return 1;
+	f = fopen(out, "wb");
+	if (f == NULL)
+	{
+		perror(out);
+		return 1;
+	}
+	// no SA_RESTART, so the signal ends a blocked read
+	memset(&sa, 0, sizeof (sa));
+	sa.sa_handler = Stop;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGALRM, &sa, NULL);
+	if (seconds > 0)
+		alarm(seconds);
+
+	Capture_WriteHeader(f, (uint32_t)baud);
+	start = Now_Us();
+	while (!stop)
+	{
+		n = read(fd, r.data, sizeof (r.data));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			perror(dev);
+			break;
+		}
+		r.time_us = Now_Us() - start;
+		r.dir = CAPTURE_RX;
+		r.len = (uint16_t)n;
+		if (Capture_Write(f, &r) < 0)
+		{
+			perror(out);
+			break;
+		}
+		records++;
+		bytes += n;
+	}
+	fclose(f);
+	close(fd);
+	fprintf(stderr, "bus_capture: %lu bytes in %lu records\n", bytes, records);
+	return 0;
+}
+
+static int Print(const char * name)
+{
+	static struct capture_record r;
+	FILE * f = fopen(name, "rb");
+	uint32_t baud;
+	int i, ret;
+
+	if (f == NULL)
+	{
+		perror(name);
+		return 1;
+	}
+	if (Capture_ReadHeader(f, &baud) < 0)
+	{
+		fprintf(stderr, "%s: not a capture file\n", name);
+		fclose(f);
+		return 1;
+	}
+	printf("baud %lu\n", (unsigned long)baud);
+	while ((ret = Capture_Read(f, &r)) > 0)
+	{
+		printf("%12.3f ms %c %3u:", r.time_us / 1000.0, r.dir, r.len);
+		for (i = 0; i < r.len; i++)
+			printf(" %02x", r.data[i]);
+		printf("\n");
+	}
+	fclose(f);
+	if (ret < 0)
+	{
+		fprintf(stderr, "%s: damaged record\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char * argv[])
+{
+	const char * out = NULL, * print = NULL;
+	long baud = 115200;
+	int seconds = 0, bad = 0, opt;
+
+	while ((opt = getopt(argc, argv, "b:t:o:p:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'b':
+			baud = atol(optarg);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'o':
+			out = optarg;
+			break;
+		case 'p':
+			print = optarg;
+			break;
+		default:
+			bad = 1;
+			break;
+		}
+	}
+	if (print && !bad)
+		return Print(print);
+	if (bad || out == NULL || optind != argc - 1 || Speed(baud) == 0)
+	{
+		fprintf(stderr, "usage: %s [-b baud] [-t seconds] -o file.cap device\n"
+				"       %s -p file.cap\n", argv[0], argv[0]);
+		return 2;
+	}
+	return Capture(argv[optind], baud, out, seconds);
+}
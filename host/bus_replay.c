@@ -0,0 +1,615 @@
+// Replays a capture file (host/capture.h) against one node of the host
+// build and reports how it handled each frame addressed to it, for field
+// incidents turned into repeatable runs.
+//
+//   ./bus_replay [-i id] [-s] [-r] [-q] field.cap
+//   ./bus_replay -g session.cap       captures a scripted session instead
+//
+//   -i  id of the node under test, DEV_MY_THESIS + 1 by default
+//   -s  ground its select pin, so it answers broadcast queries
+//   -r  real speed, the replay keeps to the gaps of the capture on the
+//       wall clock; without it, as fast as it goes. Time in the node is
+//       virtual either way, so both give the same results.
+//   -q  the summary only
+//
+// The bytes of the capture are split into frames the way the RX ISR in
+// rs485.c splits them, by the type byte and RS485_FRAME_TIMEOUT. After a
+// frame to the node under test, bytes heard from its id with the same
+// command within REPLY_WINDOW are the reply it gave in the field: a
+// block as long as its length byte says, else the longest run of them up
+// to a BURST_GAP of silence that ends in a good checksum. The node puts
+// a byte order in the type of every reply, which tells a reply from the
+// master's next request to the same id on a capture of a passive tap.
+// The replayed node does not hear that reply, it is held against its
+// own. Everything else reaches the node at the recorded time, the
+// capture starting once it has booted.
+//
+// Latency runs from the stop bit of a request to the start bit of the
+// reply, for the host build and as captured in the field. The field one
+// counts the adapter's latency too; the host one the waits the simulated
+// part models and the run times of its cost model, as hal.h has it. A reply
+// diverges if it is missing, unexpected or differs in length, id,
+// command or type; data alone, such as sensor readings, is counted
+// apart. Exits with 1 on a divergence.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "eeprom_model.h"
+#include "capture.h"
+#include "packet.h"
+#include "config.h"
+#include "flash.h"
+#include "rs485.h"
+
+void firmware_main(void);
+
+#define BOOT_MS			2500		// 1-wire search and first conversion
+#define FRAME_GAP		HAL_MS(3)	// RS485_FRAME_TIMEOUT
+#define REPLY_WINDOW	HAL_MS(50)	// longest a field reply may take to start
+#define BURST_GAP		HAL_MS(1)	// silence that ends a recorded reply
+#define HOLD			HAL_MS(100)	// run after the last frame
+#define MAX_FRAME		255
+
+#define F_INPUT			0	// reaches the node
+#define F_REPLY			1	// the reply of the node in the field
+
+struct frame
+{
+	int first, len;
+	uint8_t role;
+	uint8_t addressed;	// to the node under test
+	int reply;			// frame of its field reply, -1 for none
+};
+
+// a reply of the replayed node
+struct burst
+{
+	int first, len;
+	uint8_t paired;
+};
+
+// the capture, one entry a byte, time at its end relative to the start
+static uint8_t * cap_c, * cap_dir;
+static uint64_t * cap_t;
+static int cap_n;
+static struct frame * frames;
+static int frames_n;
+
+// what the replayed node sent, time at the start of each byte
+static uint8_t * out_c;
+static uint64_t * out_t;
+static int out_n;
+static struct burst * bursts;
+static int bursts_n;
+
+static uint64_t byte_time, base;
+static int quiet;
+
+static void * Grow(void * p, int n, size_t size)
+{
+	// doubles at every power of two
+	if (n == 0 || (n & (n - 1)) == 0)
+	{
+		p = realloc(p, (n ? 2 * n : 64) * size);
+		if (p == NULL)
+		{
+			fprintf(stderr, "bus_replay: out of memory\n");
+			exit(1);
+		}
+	}
+	return p;
+}
+
+static double Us(uint64_t cycles)
+{
+	return cycles / (double)(HAL_CPU_HZ / 1000000);
+}
+
+static int Valid(const uint8_t * c, int len)
+{
+	return len >= 5 && (uint8_t)checksum_len((char *)c, len - 1) == c[len - 1];
+}
+
+/* Capture ------------------------------------------------------------------*/
+static void Cap_Add(uint8_t c, uint64_t t, uint8_t dir)
+{
+	cap_c = Grow(cap_c, cap_n, 1);
+	cap_dir = Grow(cap_dir, cap_n, 1);
+	cap_t = Grow(cap_t, cap_n, sizeof (uint64_t));
+	// records stamped late by the adapter must not put bytes out of order
+	if (cap_n && t < cap_t[cap_n - 1] + byte_time)
+		t = cap_t[cap_n - 1] + byte_time;
+	cap_c[cap_n] = c;
+	cap_t[cap_n] = t;
+	cap_dir[cap_n] = dir;
+	cap_n++;
+}
+
+// Byte i of a record ends i bytes before its last, the one the time is of.
+static uint64_t Byte_End(const struct capture_record * r, int i)
+{
+	uint64_t end = HAL_US(r->time_us), back = (uint64_t)(r->len - 1 - i) * byte_time;
+
+	return end > back ? end - back : 0;
+}
+
+static int Load(const char * name)
+{
+	static struct capture_record r;
+	FILE * f = fopen(name, "rb");
+	uint32_t baud;
+	int i, ret;
+
+	if (f == NULL)
+	{
+		perror(name);
+		return -1;
+	}
+	if (Capture_ReadHeader(f, &baud) < 0 || baud == 0)
+	{
+		fprintf(stderr, "%s: not a capture file\n", name);
+		fclose(f);
+		return -1;
+	}
+	HAL_UartBaud(HAL_UART1, baud);
+	byte_time = HAL_CPU_HZ * 10 / baud;
+	while ((ret = Capture_Read(f, &r)) > 0)
+		for (i = 0; i < r.len; i++)
+			Cap_Add(r.data[i], Byte_End(&r, i), r.dir);
+	fclose(f);
+	if (ret < 0)
+	{
+		fprintf(stderr, "%s: damaged record\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+static int Frame_Add(int first, int len, uint8_t role)
+{
+	frames = Grow(frames, frames_n, sizeof (struct frame));
+	frames[frames_n].first = first;
+	frames[frames_n].len = len;
+	frames[frames_n].role = role;
+	frames[frames_n].addressed = 0;
+	frames[frames_n].reply = -1;
+	return frames_n++;
+}
+
+// Looks for the field reply to frame k in the bytes from i, returns
+// where the next frame starts.
+static int Frame_Reply(int k, int i, uint8_t id)
+{
+	const uint8_t * c = cap_c + frames[k].first;
+	uint8_t reply_id = IS_BROADCAST_ID(c[0]) ? id : c[0];
+	int e, p;
+
+	if (i + 4 >= cap_n || cap_dir[i] != CAPTURE_RX || cap_t[i] > cap_t[i - 1] + byte_time + REPLY_WINDOW ||
+		cap_c[i] != reply_id || cap_c[i + 1] != c[1] || !(cap_c[i + 2] & 0xF0))
+		return i;
+	for (e = i + 1; e < cap_n && e - i < MAX_FRAME && cap_dir[e] == CAPTURE_RX &&
+		 cap_t[e] <= cap_t[e - 1] + byte_time + BURST_GAP; e++);
+	if (IS_TYPE_BLOCK(cap_c[i + 2]))
+	{
+		// a block gives its length
+		p = i + 5 + cap_c[i + 3];
+		if (p > e || !Valid(cap_c + i, p - i))
+			return i;
+	}
+	else
+	{
+		for (p = e; p > i; p--)
+			if (Valid(cap_c + i, p - i))
+				break;
+	}
+	if (p == i)
+		return i;
+	frames[k].reply = Frame_Add(i, p - i, F_REPLY);
+	return p;
+}
+
+static void Frame_Split(uint8_t id, int sel)
+{
+	int i = 0, start = 0, len = 0, expected = 0, k;
+
+	while (i < cap_n)
+	{
+		if (len && cap_t[i] > cap_t[i - 1] + FRAME_GAP)
+		{
+			Frame_Add(start, len, F_INPUT);
+			len = 0;
+		}
+		if (len == 0)
+			start = i;
+		len++;
+		if (len == 3)
+			expected = IS_TYPE_BLOCK(cap_c[i]) ? 0 : 4 + getTypeLength(cap_c[i]);
+		else if (len == 4 && expected == 0)
+			expected = 5 + cap_c[i];
+		i++;
+		if (len > 3 && len == expected)
+		{
+			k = Frame_Add(start, len, F_INPUT);
+			len = 0;
+			if (cap_c[start] == id || (IS_BROADCAST_ID(cap_c[start]) && sel))
+			{
+				frames[k].addressed = 1;
+				i = Frame_Reply(k, i, id);
+			}
+		}
+	}
+	if (len)
+		Frame_Add(start, len, F_INPUT);
+}
+
+/* Node ---------------------------------------------------------------------*/
+static void Node_Boot(uint8_t id, int sel)
+{
+	struct flash_data data;
+	uint8_t drop[64];
+
+	EepromModel_Reset(0);
+	Config_Init();
+	data.id = id;
+	Config_Write(CONFIG_KEY_ID, &data, sizeof (data));
+	HAL_Reset();
+	if (sel)
+		HAL_SetPin(RS485_SEL_PORT, RS485_SEL_PIN, 0);
+	HAL_Run(firmware_main, HAL_MS(BOOT_MS));
+	while (HAL_UartRead(HAL_UART1, drop, sizeof (drop)) > 0);
+	base = HAL_Now();
+}
+
+static void Node_Collect(void)
+{
+	uint8_t c[64];
+	uint64_t t[64];
+	int n, i;
+
+	while ((n = HAL_UartSent(HAL_UART1, c, t, 64)) > 0)
+		for (i = 0; i < n; i++)
+		{
+			out_c = Grow(out_c, out_n, 1);
+			out_t = Grow(out_t, out_n, sizeof (uint64_t));
+			out_c[out_n] = c[i];
+			out_t[out_n] = t[i] - base;
+			// bytes of one reply follow each other without a gap
+			if (out_n == 0 || out_t[out_n] > out_t[out_n - 1] + byte_time + byte_time / 2)
+			{
+				bursts = Grow(bursts, bursts_n, sizeof (struct burst));
+				bursts[bursts_n].first = out_n;
+				bursts[bursts_n].len = 0;
+				bursts[bursts_n].paired = 0;
+				bursts_n++;
+			}
+			bursts[bursts_n - 1].len++;
+			out_n++;
+		}
+}
+
+// Runs the node up to t after the start of the capture.
+static void Node_Run(uint64_t t, const struct timespec * wall)
+{
+	if (base + t <= HAL_Now())
+		return;
+	if (wall)
+	{
+		struct timespec at = *wall;
+		uint64_t ns = (uint64_t)(Us(t) * 1000);
+
+		at.tv_sec += ns / 1000000000;
+		at.tv_nsec += ns % 1000000000;
+		if (at.tv_nsec >= 1000000000)
+		{
+			at.tv_sec++;
+			at.tv_nsec -= 1000000000;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL);
+	}
+	HAL_Run(firmware_main, base + t - HAL_Now());
+	Node_Collect();
+}
+
+static void Node_Feed(const struct frame * f)
+{
+	int i;
+
+	for (i = f->first; i < f->first + f->len; i++)
+		HAL_UartReceiveAt(HAL_UART1, cap_c[i], base + cap_t[i]);
+}
+
+/* Report -------------------------------------------------------------------*/
+static int By_Value(const void * a, const void * b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void Percentiles(const char * name, uint64_t * v, int n)
+{
+	if (n == 0)
+		return;
+	qsort(v, n, sizeof (uint64_t), By_Value);
+	printf(", %s latency p50 %.0f us p99 %.0f us max %.0f us", name, Us(v[(n - 1) / 2]),
+		   Us(v[(n - 1) * 99 / 100]), Us(v[n - 1]));
+}
+
+static const char * Compare(const struct frame * rec, const struct burst * got, int * diverged)
+{
+	static char text[48];
+	const uint8_t * r, * g;
+
+	*diverged = 1;
+	if (rec == NULL && got == NULL)
+	{
+		*diverged = 0;
+		return "ok, no reply";
+	}
+	if (got == NULL)
+		return "no reply";
+	if (rec == NULL)
+		return "unexpected reply";
+	if (rec->len != got->len)
+	{
+		snprintf(text, sizeof (text), "length %d, was %d", got->len, rec->len);
+		return text;
+	}
+	r = cap_c + rec->first;
+	g = out_c + got->first;
+	if (memcmp(r, g, 3))
+		return "header differs";
+	*diverged = 0;
+	return memcmp(r, g, rec->len) ? "data differs" : "ok";
+}
+
+static int Report(void)
+{
+	uint64_t * latency = malloc(sizeof (uint64_t) * (frames_n + 1));
+	uint64_t * field = malloc(sizeof (uint64_t) * (frames_n + 1));
+	int addressed = 0, replies = 0, diverged = 0, data = 0, inputs = 0;
+	int k, next, b = 0, d, n = 0, m = 0;
+
+	if (!quiet)
+		printf("    time ms  id cmd  len    host us   field us  result\n");
+	for (k = 0; k < frames_n; k++)
+	{
+		const struct frame * f = &frames[k];
+		const struct frame * rec = f->reply >= 0 ? &frames[f->reply] : NULL;
+		const struct burst * got = NULL;
+		uint64_t end = cap_t[f->first + f->len - 1], until;
+		const char * result;
+
+		if (f->role != F_INPUT)
+			continue;
+		inputs++;
+		if (!f->addressed)
+			continue;
+		addressed++;
+		// the node's reply starts after this request ends, before the next one does
+		for (next = k + 1; next < frames_n && !(frames[next].role == F_INPUT && frames[next].addressed); next++);
+		until = next < frames_n ? cap_t[frames[next].first + frames[next].len - 1] : end + HOLD;
+		while (b < bursts_n && out_t[bursts[b].first] < end)
+			b++;
+		if (b < bursts_n && out_t[bursts[b].first] < until)
+		{
+			got = &bursts[b];
+			bursts[b++].paired = 1;
+			latency[n++] = out_t[got->first] - end;
+			replies++;
+		}
+		if (rec)
+			field[m++] = cap_t[rec->first] - byte_time - end;
+		result = Compare(rec, got, &d);
+		diverged += d;
+		data += !strcmp(result, "data differs");
+		if (quiet)
+			continue;
+		printf("%11.3f  %02x  %02x  %3d", Us(cap_t[f->first]) / 1000, cap_c[f->first],
+			   f->len > 1 ? cap_c[f->first + 1] : 0, f->len);
+		if (got)
+			printf("  %9.0f", Us(out_t[got->first] - end));
+		else
+			printf("  %9s", "-");
+		if (rec)
+			printf("  %9.0f", Us(field[m - 1]));
+		else
+			printf("  %9s", "-");
+		printf("  %s\n", result);
+	}
+	for (k = 0; k < bursts_n; k++)
+		if (!bursts[k].paired)
+		{
+			if (!quiet)
+				printf("%11.3f  unprompted output of %d bytes\n", Us(out_t[bursts[k].first]) / 1000,
+					   bursts[k].len);
+			diverged++;
+		}
+
+	printf("%d frames, %d to the node, %d replies", inputs, addressed, replies);
+	Percentiles("host", latency, n);
+	Percentiles("field", field, m);
+	printf("\n%d diverged, %d with other data\n", diverged, data);
+	free(latency);
+	free(field);
+	return diverged ? 1 : 0;
+}
+
+static int Replay(const char * name, uint8_t id, int sel, int real)
+{
+	struct timespec wall;
+	int k, next;
+
+	if (Load(name) < 0)
+		return 2;
+	Frame_Split(id, sel);
+	Node_Boot(id, sel);
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	for (k = 0; k < frames_n; k++)
+	{
+		if (frames[k].role != F_INPUT)
+			continue;
+		Node_Feed(&frames[k]);
+		for (next = k + 1; next < frames_n && frames[next].role != F_INPUT; next++);
+		if (next < frames_n)
+			Node_Run(cap_t[frames[next].first] - byte_time, real ? &wall : NULL);
+	}
+	Node_Run((cap_n ? cap_t[cap_n - 1] : 0) + HOLD, real ? &wall : NULL);
+	return Report();
+}
+
+/* Scripted session ---------------------------------------------------------*/
+#define SESSION_STEPS	200
+#define SESSION_STEP	50000		// us between requests
+#define OTHER_ID		(DEV_MY_THESIS + 2)
+#define ADAPTER_US		400			// a USB adapter's latency, hand set
+#define JITTER_US		600			// on top, spread over the replies
+
+// Writes a record, and hands its bytes to the node if it hears them.
+static int Record(FILE * f, uint64_t time_us, uint8_t dir, const uint8_t * c, int len, int heard)
+{
+	static struct capture_record r;
+	int i;
+
+	r.time_us = time_us;
+	r.dir = dir;
+	r.len = (uint16_t)len;
+	memcpy(r.data, c, len);
+	// where a replay puts them
+	if (heard)
+		for (i = 0; i < len; i++)
+			HAL_UartReceiveAt(HAL_UART1, c[i], base + Byte_End(&r, i));
+	return Capture_Write(f, &r);
+}
+
+static int Request(uint8_t * c, uint8_t id, uint8_t cmd, uint8_t type, uint32_t value)
+{
+	int n = getTypeLength(type), i;
+
+	c[0] = id;
+	c[1] = cmd;
+	c[2] = type;
+	for (i = 0; i < n; i++)
+		c[3 + i] = (uint8_t)(value >> (8 * (n - 1 - i)));
+	c[3 + n] = checksum_len((char *)c, 3 + n);
+	return 4 + n;
+}
+
+// A master polling the node the way a gateway does, with a second node
+// answering on the bus, a long block among its answers, line noise and
+// a corrupt frame. Its replies are taken from the host build and heard
+// late by ADAPTER_US and up to JITTER_US, as a field capture through a
+// USB adapter would have them, so the two latencies differ. The file
+// made this way is kept as host/session.cap, which the replay test runs
+// against the current build; make it again only when a reply changes
+// on purpose.
+static int Session(const char * name)
+{
+	static const uint8_t noise[3] = {0x55, 0xAA, 0x00};
+	uint8_t id = DEV_MY_THESIS + 1, c[16], block[200];
+	uint64_t at;
+	int s, len, b = 0, i;
+	FILE * f = fopen(name, "wb");
+
+	if (f == NULL)
+	{
+		perror(name);
+		return 2;
+	}
+	HAL_UartBaud(HAL_UART1, 115200);
+	byte_time = HAL_CPU_HZ * 10 / 115200;
+	Node_Boot(id, 0);
+	Capture_WriteHeader(f, 115200);
+	for (s = 0; s < SESSION_STEPS; s++)
+	{
+		at = (uint64_t)s * SESSION_STEP;
+		switch (s % 8)
+		{
+		case 0: len = Request(c, id, CMD_QUERY, TYPE_BYTE, 0); break;
+		case 1:
+			if (s % 16 == 9)
+				len = Request(c, OTHER_ID, CMD_HISTORY, TYPE_UINT32, 0);
+			else
+				len = Request(c, OTHER_ID, CMD_QUERY, TYPE_BYTE, 0);
+			break;
+		case 2: len = Request(c, id, CMD_QUERY_STATS, TYPE_BYTE, 0); break;
+		case 3: len = Request(c, id, CMD_QUERY_HEALTH, TYPE_BYTE, 0); break;
+		case 4: len = Request(c, id, CMD_HISTORY_PACKED, TYPE_UINT32, 0); break;
+		case 5: len = Request(c, id, CMD_QUERY_POWER, TYPE_BYTE, 0); break;
+		case 6: len = 3; memcpy(c, noise, 3); break;
+		default: len = Request(c, id, CMD_QUERY, TYPE_BYTE, 0); c[len - 1] ^= 0x5A; break;
+		}
+		at += Us(len * byte_time);
+		Record(f, at, CAPTURE_TX, c, len, 1);
+		if (s % 16 == 9)
+		{
+			// the other node's history, a block far longer than the RX
+			// ring of the node, with its own frame inside
+			memset(block, 0, sizeof (block));
+			Request(block, OTHER_ID, CMD_HISTORY, TYPE_BLOCK | BIG_ENDIAN_BYTE_ORDER, sizeof (block) - 5);
+			Request(block + 20, id, CMD_QUERY, TYPE_BYTE, 0);
+			block[sizeof (block) - 1] = checksum_len((char *)block, sizeof (block) - 1);
+			Record(f, at + 2000 + Us(sizeof (block) * byte_time), CAPTURE_RX, block, sizeof (block), 1);
+		}
+		else if (s % 8 == 1)
+		{
+			// the other node's answer, a reading of 0
+			len = Request(c, OTHER_ID, CMD_QUERY, TYPE_FLOAT | BIG_ENDIAN_BYTE_ORDER, 0);
+			Record(f, at + 2000 + Us(len * byte_time), CAPTURE_RX, c, len, 1);
+		}
+		Node_Run(HAL_US((uint64_t)(s + 1) * SESSION_STEP), NULL);
+		for (; b < bursts_n; b++)
+		{
+			i = bursts[b].first + bursts[b].len - 1;
+			Record(f, (uint64_t)Us(out_t[i] + byte_time) + ADAPTER_US + (b * 137) % JITTER_US, CAPTURE_RX,
+				   out_c + bursts[b].first, bursts[b].len, 0);
+		}
+	}
+	fclose(f);
+	printf("%d requests, %d replies in %s\n", SESSION_STEPS, bursts_n, name);
+	return 0;
+}
+
+int main(int argc, char * argv[])
+{
+	uint8_t id = DEV_MY_THESIS + 1;
+	int sel = 0, real = 0, bad = 0, opt;
+	const char * session = NULL;
+
+	while ((opt = getopt(argc, argv, "i:srqg:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i':
+			id = (uint8_t)strtol(optarg, NULL, 0);
+			break;
+		case 's':
+			sel = 1;
+			break;
+		case 'r':
+			real = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'g':
+			session = optarg;
+			break;
+		default:
+			bad = 1;
+			break;
+		}
+	}
+	if (!bad && session && optind == argc)
+		return Session(session);
+	if (bad || session || optind != argc - 1)
+	{
+		fprintf(stderr, "usage: %s [-i id] [-s] [-r] [-q] file.cap\n       %s -g file.cap\n", argv[0], argv[0]);
+		return 2;
+	}
+	return Replay(argv[optind], id, sel, real);
+}
@@ -0,0 +1,70 @@
+#include <string.h>
+#include "capture.h"
+
+static void Put(uint8_t * p, uint64_t v, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t Get(const uint8_t * p, int n)
+{
+	uint64_t v = 0;
+	int i;
+
+	for (i = n - 1; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+int Capture_WriteHeader(FILE * f, uint32_t baud)
+{
+	uint8_t head[CAPTURE_MAGIC_SIZE + 4];
+
+	memcpy(head, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+	Put(head + CAPTURE_MAGIC_SIZE, baud, 4);
+	return fwrite(head, sizeof (head), 1, f) == 1 ? 0 : -1;
+}
+
+int Capture_Write(FILE * f, const struct capture_record * r)
+{
+	uint8_t head[11];
+
+	Put(head, r->time_us, 8);
+	head[8] = r->dir;
+	Put(head + 9, r->len, 2);
+	if (fwrite(head, sizeof (head), 1, f) != 1)
+		return -1;
+	return r->len == 0 || fwrite(r->data, r->len, 1, f) == 1 ? 0 : -1;
+}
+
+int Capture_ReadHeader(FILE * f, uint32_t * baud)
+{
+	uint8_t head[CAPTURE_MAGIC_SIZE + 4];
+
+	if (fread(head, sizeof (head), 1, f) != 1 || memcmp(head, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE))
+		return -1;
+	*baud = (uint32_t)Get(head + CAPTURE_MAGIC_SIZE, 4);
+	return 0;
+}
+
+int Capture_Read(FILE * f, struct capture_record * r)
+{
+	uint8_t head[11];
+	size_t n = fread(head, 1, sizeof (head), f);
+
+	if (n == 0)
+		return 0;
+	if (n != sizeof (head))
+		return -1;
+	r->time_us = Get(head, 8);
+	r->dir = head[8];
+	r->len = (uint16_t)Get(head + 9, 2);
+	if (r->len > CAPTURE_MAX || (r->dir != CAPTURE_RX && r->dir != CAPTURE_TX))
+		return -1;
+	if (r->len && fread(r->data, r->len, 1, f) != 1)
+		return -1;
+	return 1;
+}
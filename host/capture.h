@@ -0,0 +1,42 @@
+#ifndef _capture_h_
+#define _capture_h_
+
+#include <stdio.h>
+#include <stdint.h>
+
+// RS485 capture files, written by bus_capture from a serial adapter on
+// the bus and by bus_replay -g, read by bus_replay. A header, then one
+// record per burst of bytes:
+//
+//   header  CAPTURE_MAGIC, then the baud rate as uint32
+//   record  time as uint64, us since the capture started, taken at the
+//           end of the last byte; direction; length as uint16; the bytes
+//
+// Numbers are little endian. A passive tap writes CAPTURE_RX only; a
+// capture made by the master marks what it sent CAPTURE_TX.
+
+#define CAPTURE_MAGIC		"SHCAP\x01\x00\x00"	// version 1
+#define CAPTURE_MAGIC_SIZE	8
+#define CAPTURE_RX			'R'		// heard on the bus
+#define CAPTURE_TX			'T'		// sent by the host that captured
+#define CAPTURE_MAX			1024	// bytes in one record
+
+struct capture_record
+{
+	uint64_t time_us;
+	uint8_t dir;
+	uint16_t len;
+	uint8_t data[CAPTURE_MAX];
+};
+
+// 0 on success, -1 on a write error
+int Capture_WriteHeader(FILE * f, uint32_t baud);
+int Capture_Write(FILE * f, const struct capture_record * r);
+
+// 0 on a good header, -1 if f does not hold a capture
+int Capture_ReadHeader(FILE * f, uint32_t * baud);
+
+// 1 with the next record in r, 0 at the end, -1 on a damaged file
+int Capture_Read(FILE * f, struct capture_record * r);
+
+#endif
@@ -0,0 +1,118 @@
+// Round trip and throughput of codec.c on synthetic history: slow random
+// walks for temperature, lighting and gas and an on time sample clock,
+// packed into CMD_HISTORY_PACKED sized frames.
+//
+//   cc -O2 -I host -I . -o codec_bench host/codec_bench.c codec.c
+//   ./codec_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "codec.h"
+
+#define ROWS			100000
+#define CHANNELS		4
+#define FRAME_BYTES		233		// 255 byte frame less the packet, block length and HistoryPacked headers
+#define FRAME_OVERHEAD	22
+#define RECORD_SIZE		8		// struct HistoryRecord
+#define RAW_PER_FRAME	14		// records per CMD_HISTORY frame
+#define RAW_OVERHEAD	20
+#define BAUD_BYTES		11520	// 115200 baud, 10 bits a byte
+
+static int16_t rows[ROWS][CHANNELS];
+static int16_t back[ROWS][CHANNELS];
+static uint8_t frames[ROWS][FRAME_BYTES];
+static uint16_t frame_rows[ROWS];
+static uint8_t frame_len[ROWS];
+
+static int16_t Walk(int16_t v, int step, int lo, int hi)
+{
+	v += rand() % (2 * step + 1) - step;
+	if (v < lo)
+		v = lo;
+	if (v > hi)
+		v = hi;
+	return v;
+}
+
+int main(void)
+{
+	long i, nframes = 0, bytes = 0;
+	long row;
+	clock_t t0, t1, t2;
+	double enc_s, dec_s, raw_rate, packed_rate;
+	
+	srand(1);
+	rows[0][1] = 22 * 16;
+	rows[0][2] = 2400;
+	rows[0][3] = 150;
+	for (i = 1; i < ROWS; i++)
+	{
+		rows[i][0] = (rand() % 50 == 0) ? 1 : 0;	// late now and then
+		rows[i][1] = Walk(rows[i - 1][1], 2, -40 * 16, 85 * 16);
+		rows[i][2] = Walk(rows[i - 1][2], 6, 0, 20000);
+		rows[i][3] = Walk(rows[i - 1][3], 4, 0, 10000);
+	}
+	
+	t0 = clock();
+	for (row = 0; row < ROWS; nframes++)
+	{
+		struct codec c;
+		long start = row;
+		
+		Codec_Init(&c, CHANNELS, frames[nframes], FRAME_BYTES);
+		while (row < ROWS)
+		{
+			uint8_t take = ROWS - row < CODEC_GROUP ? (uint8_t)(ROWS - row) : CODEC_GROUP;
+			
+			if (row - start + take > 255 || !Codec_Put(&c, &rows[row][0], take))
+				break;
+			row += take;
+		}
+		frame_rows[nframes] = (uint16_t)(row - start);
+		frame_len[nframes] = Codec_Length(&c);
+		bytes += frame_len[nframes] + FRAME_OVERHEAD;
+	}
+	t1 = clock();
+	
+	for (row = 0, i = 0; i < nframes; i++)
+	{
+		struct codec c;
+		long end = row + frame_rows[i];
+		
+		Codec_Init(&c, CHANNELS, frames[i], frame_len[i]);
+		while (row < end)
+		{
+			uint8_t take = end - row < CODEC_GROUP ? (uint8_t)(end - row) : CODEC_GROUP;
+			
+			if (!Codec_Get(&c, &back[row][0], take))
+			{
+				printf("FAIL frame %ld ends early\n", i);
+				return 1;
+			}
+			row += take;
+		}
+	}
+	t2 = clock();
+	
+	if (memcmp(rows, back, sizeof (rows)) != 0)
+	{
+		printf("FAIL decoded rows differ\n");
+		return 1;
+	}
+	
+	enc_s = (double)(t1 - t0) / CLOCKS_PER_SEC;
+	dec_s = (double)(t2 - t1) / CLOCKS_PER_SEC;
+	raw_rate = (double)BAUD_BYTES * RAW_PER_FRAME / (RAW_PER_FRAME * RECORD_SIZE + RAW_OVERHEAD);
+	packed_rate = (double)BAUD_BYTES * ROWS / bytes;
+	
+	printf("%d records in %ld frames, %.1f records a frame\n", ROWS, nframes, (double)ROWS / nframes);
+	printf("%.2f bytes a record, %d unpacked\n", (double)bytes / ROWS, RECORD_SIZE);
+	printf("encode %.1f Mrecords/s, decode %.1f Mrecords/s\n",
+		   ROWS / enc_s / 1e6, ROWS / dec_s / 1e6);
+	printf("at 115200 baud: %.0f records/s packed, %.0f unpacked (%.1fx)\n",
+		   packed_rate, raw_rate, packed_rate / raw_rate);
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,193 @@
+#include "eeprom_model.h"
+#include <string.h>
+
+// Behaviour of the FLASH functions of the StdPeriph library on the data
+// EEPROM: standard mode erases before it programs, every cycle works on
+// whole 4 byte words and words go to memory most significant byte first.
+// Program flash is only written a block at a time, as the history log does.
+
+struct eeprom_model eeprom_model;
+
+static uint8_t eop;
+
+__attribute__((weak)) void EepromModel_Busy(uint32_t us)
+{
+	(void)us;
+}
+
+void EepromModel_Reset(uint8_t fill)
+{
+	memset(&eeprom_model, 0, sizeof (eeprom_model));
+	memset(eeprom_model.mem, fill, sizeof (eeprom_model.mem));
+	eop = 0;
+}
+
+static int Model_Offset(uint32_t addr)
+{
+	if (addr < FLASH_DATA_START_PHYSICAL_ADDRESS ||
+		addr >= FLASH_DATA_START_PHYSICAL_ADDRESS + MODEL_EEPROM_SIZE)
+		return -1;
+	return (int)(addr - FLASH_DATA_START_PHYSICAL_ADDRESS);
+}
+
+static int Model_Cycle(uint32_t addr, uint16_t words)
+{
+	int offset = Model_Offset(addr);
+	
+	if (offset < 0 || !eeprom_model.unlocked)
+	{
+		// the part would never raise EOP, let the driver go on and
+		// report the error instead of hanging the host
+		eeprom_model.errors++;
+		eop = 1;
+		return -1;
+	}
+	while (words--)
+		eeprom_model.cycles[offset / 4 + words]++;
+	eeprom_model.busy_us += MODEL_TPROG_US;
+	EepromModel_Busy(MODEL_TPROG_US);
+	eop = 1;
+	return offset;
+}
+
+void FLASH_Unlock(FLASH_MemType_TypeDef MemType)
+{
+	if (MemType == FLASH_MEMTYPE_DATA)
+		eeprom_model.unlocked = 1;
+	else
+		eeprom_model.prog_unlocked = 1;
+}
+
+void FLASH_Lock(FLASH_MemType_TypeDef MemType)
+{
+	if (MemType == FLASH_MEMTYPE_DATA)
+		eeprom_model.unlocked = 0;
+	else
+		eeprom_model.prog_unlocked = 0;
+}
+
+void FLASH_SetProgrammingTime(FLASH_ProgramTime_TypeDef ProgTime)
+{
+	(void)ProgTime;
+}
+
+void FLASH_EraseBlock(uint16_t BlockNum, FLASH_MemType_TypeDef MemType)
+{
+	int offset;
+	
+	if (MemType != FLASH_MEMTYPE_DATA || BlockNum >= FLASH_DATA_BLOCKS_NUMBER)
+	{
+		eeprom_model.errors++;
+		return;
+	}
+	offset = Model_Cycle(FLASH_DATA_START_PHYSICAL_ADDRESS + (uint32_t)BlockNum * FLASH_BLOCK_SIZE,
+						 FLASH_BLOCK_SIZE / 4);
+	if (offset < 0)
+		return;
+	eeprom_model.block_ops++;
+	memset(eeprom_model.mem + offset, 0, FLASH_BLOCK_SIZE);
+}
+
+void FLASH_ProgramBlock(uint16_t BlockNum, FLASH_MemType_TypeDef MemType,
+						FLASH_ProgramMode_TypeDef ProgMode, uint8_t * Buffer)
+{
+	int offset;
+	
+	(void)ProgMode;
+	if (MemType == FLASH_MEMTYPE_PROG && BlockNum < FLASH_PROG_BLOCKS_NUMBER)
+	{
+		if (!eeprom_model.prog_unlocked)
+		{
+			eeprom_model.errors++;
+			eop = 1;
+			return;
+		}
+		eeprom_model.prog_block_ops++;
+		eeprom_model.busy_us += MODEL_TPROG_US;
+		EepromModel_Busy(MODEL_TPROG_US);
+		memcpy(eeprom_model.prog + (uint32_t)BlockNum * FLASH_BLOCK_SIZE, Buffer, FLASH_BLOCK_SIZE);
+		eop = 1;
+		return;
+	}
+	if (MemType != FLASH_MEMTYPE_DATA || BlockNum >= FLASH_DATA_BLOCKS_NUMBER)
+	{
+		eeprom_model.errors++;
+		return;
+	}
+	offset = Model_Cycle(FLASH_DATA_START_PHYSICAL_ADDRESS + (uint32_t)BlockNum * FLASH_BLOCK_SIZE,
+						 FLASH_BLOCK_SIZE / 4);
+	if (offset < 0)
+		return;
+	eeprom_model.block_ops++;
+	memcpy(eeprom_model.mem + offset, Buffer, FLASH_BLOCK_SIZE);
+}
+
+void FLASH_ProgramByte(uint32_t Address, uint8_t Data)
+{
+	int offset = Model_Cycle(Address, 1);
+	
+	if (offset < 0)
+		return;
+	eeprom_model.byte_ops++;
+	eeprom_model.mem[offset] = Data;
+}
+
+void FLASH_ProgramWord(uint32_t Address, uint32_t Data)
+{
+	int offset;
+	
+	if (Address & 3)
+	{
+		eeprom_model.errors++;
+		eop = 1;
+		return;
+	}
+	offset = Model_Cycle(Address, 1);
+	if (offset < 0)
+		return;
+	eeprom_model.word_ops++;
+	eeprom_model.mem[offset] = (uint8_t)(Data >> 24);
+	eeprom_model.mem[offset + 1] = (uint8_t)(Data >> 16);
+	eeprom_model.mem[offset + 2] = (uint8_t)(Data >> 8);
+	eeprom_model.mem[offset + 3] = (uint8_t)Data;
+}
+
+uint8_t FLASH_ReadByte(uint32_t Address)
+{
+	int offset = Model_Offset(Address);
+	
+	if (Address >= FLASH_PROG_START_PHYSICAL_ADDRESS && Address <= FLASH_PROG_END_PHYSICAL_ADDRESS)
+		return eeprom_model.prog[Address - FLASH_PROG_START_PHYSICAL_ADDRESS];
+	if (offset < 0)
+	{
+		eeprom_model.errors++;
+		return 0;
+	}
+	return eeprom_model.mem[offset];
+}
+
+FlagStatus FLASH_GetFlagStatus(FLASH_Flag_TypeDef FLASH_FLAG)
+{
+	switch (FLASH_FLAG)
+	{
+	case FLASH_FLAG_EOP:
+		// cleared by reading, as FLASH_IAPSR
+		if (!eop)
+			return RESET;
+		eop = 0;
+		return SET;
+	case FLASH_FLAG_DUL:
+		return eeprom_model.unlocked ? SET : RESET;
+	case FLASH_FLAG_PUL:
+		return eeprom_model.prog_unlocked ? SET : RESET;
+	default:
+		return SET;
+	}
+}
+
+FLASH_Status_TypeDef FLASH_WaitForLastOperation(FLASH_MemType_TypeDef FLASH_MemType)
+{
+	(void)FLASH_MemType;
+	eop = 0;
+	return FLASH_STATUS_SUCCESSFUL_OPERATION;
+}
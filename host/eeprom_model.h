@@ -0,0 +1,39 @@
+#ifndef _eeprom_model_h_
+#define _eeprom_model_h_
+
+#include "stm8s.h"
+
+// Data EEPROM of the model, 4 byte words as on the STM8S
+#define MODEL_EEPROM_SIZE	(FLASH_DATA_BLOCKS_NUMBER * FLASH_BLOCK_SIZE)
+#define MODEL_EEPROM_WORDS	(MODEL_EEPROM_SIZE / 4)
+
+// program flash, erased to 0 as well
+#define MODEL_PROG_SIZE		(FLASH_PROG_BLOCKS_NUMBER * FLASH_BLOCK_SIZE)
+
+// standard programming, erase and write, per byte, word or block cycle
+#define MODEL_TPROG_US		6000
+
+struct eeprom_model
+{
+	uint8_t mem[MODEL_EEPROM_SIZE];
+	uint32_t cycles[MODEL_EEPROM_WORDS];	// wear per word
+	uint32_t byte_ops, word_ops, block_ops;
+	uint32_t busy_us;						// time the CPU waits on EOP
+	uint32_t errors;						// writes while locked, misaligned words
+	uint8_t unlocked;
+	
+	uint8_t prog[MODEL_PROG_SIZE];
+	uint32_t prog_block_ops;
+	uint8_t prog_unlocked;
+};
+
+extern struct eeprom_model eeprom_model;
+
+// Clears the statistics, fills the memory with a value.
+void EepromModel_Reset(uint8_t fill);
+
+// Called with the time each cycle keeps the CPU waiting. Does nothing
+// unless host/hal.c is linked, which moves its virtual clock on.
+void EepromModel_Busy(uint32_t us);
+
+#endif
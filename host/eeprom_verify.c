@@ -0,0 +1,93 @@
+// Checks flash_program_at against the EEPROM model: after every write the
+// memory must match a plain copy, nothing may be programmed while locked
+// and the driver must use fewer cycles than one byte program per byte.
+//
+//   cc -I host -I . -o eeprom_verify host/eeprom_verify.c host/eeprom_model.c flash.c
+//   ./eeprom_verify
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "eeprom_model.h"
+#include "flash.h"
+
+#define TRIALS		20000
+#define MAX_WRITE	48
+
+static uint8_t shadow[MODEL_EEPROM_SIZE];
+
+int main(void)
+{
+	uint32_t trial, naive_ops = 0, max_wear = 0;
+	uint32_t i;
+	
+	srand(1);
+	EepromModel_Reset(0);
+	memset(shadow, 0, sizeof (shadow));
+	
+	for (trial = 0; trial < TRIALS; trial++)
+	{
+		char buf[MAX_WRITE];
+		int size = 1 + rand() % MAX_WRITE;
+		unsigned int offset = rand() % (MODEL_EEPROM_SIZE - size + 1);
+		int j;
+		
+		// mostly small edits of what is stored, as a config save is
+		memcpy(buf, shadow + offset, size);
+		switch (rand() % 4)
+		{
+		case 0:
+			break;
+		case 1:
+			buf[rand() % size] ^= 1 + rand() % 255;
+			break;
+		default:
+			for (j = 0; j < size; j++)
+				buf[j] = (char)rand();
+			break;
+		}
+		
+		flash_program_at(offset, buf, size);
+		memcpy(shadow + offset, buf, size);
+		naive_ops += size;
+		
+		if (memcmp(shadow, eeprom_model.mem, sizeof (shadow)) != 0)
+		{
+			printf("FAIL trial %lu: %d bytes at %u differ from the model\n",
+				   (unsigned long)trial, size, offset);
+			return 1;
+		}
+		if (eeprom_model.unlocked)
+		{
+			printf("FAIL trial %lu: EEPROM left unlocked\n", (unsigned long)trial);
+			return 1;
+		}
+	}
+	
+	if (eeprom_model.errors)
+	{
+		printf("FAIL %lu locked or misaligned writes\n", (unsigned long)eeprom_model.errors);
+		return 1;
+	}
+	
+	for (i = 0; i < MODEL_EEPROM_WORDS; i++)
+		if (eeprom_model.cycles[i] > max_wear)
+			max_wear = eeprom_model.cycles[i];
+	
+	printf("%u writes, %lu bytes\n", TRIALS, (unsigned long)naive_ops);
+	printf("byte programs %lu, word programs %lu\n",
+		   (unsigned long)eeprom_model.byte_ops, (unsigned long)eeprom_model.word_ops);
+	printf("program time %lu ms, byte by byte %lu ms (%.1f%%)\n",
+		   (unsigned long)(eeprom_model.busy_us / 1000),
+		   (unsigned long)(naive_ops * (MODEL_TPROG_US / 1000)),
+		   100.0 * eeprom_model.busy_us / ((double)naive_ops * MODEL_TPROG_US));
+	printf("most cycled word %lu\n", (unsigned long)max_wear);
+	
+	if (eeprom_model.byte_ops + eeprom_model.word_ops >= naive_ops)
+	{
+		printf("FAIL no fewer cycles than byte programming\n");
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
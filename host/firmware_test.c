@@ -0,0 +1,169 @@
+// Boots the firmware on the simulated part and talks to it over RS485:
+// a query answered with the DS18B20 temperature, corrupt and foreign
+// frames showing up in the health counters, a long block from another
+// node passed over, a history block framed by its length byte, a stats
+// window set from the request, and the id carried over into the
+// EEPROM log. The debug UART stream is written to the file named on the
+// command line, for trace_decode.
+//
+//   cmake -S . -B build && cmake --build build && ./build/firmware_test trace.bin
+//
+// Replies are big endian on every machine and are read back with the
+// get functions of packet.c.
+
+#include <stdio.h>
+#include <string.h>
+#include "hal.h"
+#include "eeprom_model.h"
+#include "packet.h"
+#include "config.h"
+#include "flash.h"
+#include "sched.h"
+
+void firmware_main(void);
+extern struct sched_task tasks[];	// main.c, Task_RS485 first
+
+static int failures;
+
+#define CHECK(cond, ...) \
+	do { if (!(cond)) { printf("FAIL " __VA_ARGS__); printf("\n"); failures++; } } while (0)
+
+static uint8_t reply[256];
+static int reply_len;
+
+static void Send(uint8_t id, uint8_t cmd, uint8_t type, const uint8_t * data, uint8_t corrupt)
+{
+	uint8_t frame[16];
+	int len = getTypeLength(type);
+
+	frame[0] = id;
+	frame[1] = cmd;
+	frame[2] = type;
+	memcpy(frame + 3, data, len);
+	frame[3 + len] = checksum_len((char *)frame, 3 + len) + corrupt;
+	HAL_UartWrite(HAL_UART1, frame, 4 + len);
+	HAL_Run(firmware_main, HAL_MS(20));
+	reply_len = HAL_UartRead(HAL_UART1, reply, sizeof (reply));
+}
+
+static int ReplyValid(void)
+{
+	return reply_len >= 4 && (uint8_t)checksum_len((char *)reply, reply_len - 1) == reply[reply_len - 1];
+}
+
+int main(int argc, char * argv[])
+{
+	static const uint8_t zero[4];
+	uint8_t id = DEV_MY_THESIS | 0x01, window = 8;
+	struct HealthData health;
+	struct StatsData stats;
+	struct flash_data stored;
+	float temperature;
+	uint8_t block[200], trace[HAL_UART_LOG];
+	int n;
+
+	EepromModel_Reset(0);
+	HAL_Reset();
+	HAL_SetAdc(ADC2_CHANNEL_9, 400);
+	HAL_SetAdc(ADC2_CHANNEL_8, 600);
+	HAL_OneWireTemperature(-10 * 16 - 8);	// -10.5 C
+
+	// search, convert at 12 bit and read back
+	HAL_Run(firmware_main, HAL_MS(2000));
+	CHECK(HAL_OneWireErrors() == 0, "1-wire slots the device did not understand: %u",
+		  (unsigned)HAL_OneWireErrors());
+
+	Send(id, CMD_QUERY, TYPE_BYTE, zero, 0);
+	CHECK(reply_len == 4 + (int)sizeof (float) && ReplyValid(), "query reply of %d bytes", reply_len);
+	temperature = getFloat(reply + 3);
+	CHECK(temperature == -10.5f, "temperature %.4f, want -10.5", temperature);
+
+	Send(id, CMD_QUERY, TYPE_BYTE, zero, 1);
+	CHECK(reply_len == 0, "answered a frame with a bad checksum");
+	Send(id ^ 0x02, CMD_QUERY, TYPE_BYTE, zero, 0);
+	CHECK(reply_len == 0, "answered a frame for another id");
+
+	// a neighbour's block, far longer than the RX ring, with a frame to
+	// us in its data
+	memset(block, 0, sizeof (block));
+	block[0] = id ^ 0x02;
+	block[1] = CMD_HISTORY;
+	block[2] = TYPE_BLOCK | BIG_ENDIAN_BYTE_ORDER;
+	block[3] = sizeof (block) - 5;
+	block[10] = id;
+	block[11] = CMD_QUERY;
+	block[12] = TYPE_BYTE;
+	block[14] = checksum_len((char *)block + 10, 4);
+	block[sizeof (block) - 1] = checksum_len((char *)block, sizeof (block) - 1);
+	HAL_UartWrite(HAL_UART1, block, sizeof (block));
+	HAL_Run(firmware_main, HAL_MS(40));
+	reply_len = HAL_UartRead(HAL_UART1, reply, sizeof (reply));
+	CHECK(reply_len == 0, "answered a frame inside another node's block");
+
+	Send(id, CMD_RESET_HEALTH, TYPE_BYTE, zero, 0);
+	CHECK(reply_len == 5 + HEALTH_DATA_SIZE && IS_TYPE_BLOCK(reply[2]) && ReplyValid(),
+		  "health reply of %d bytes", reply_len);
+	getHealthData(reply + 4, &health);
+	CHECK(health.counters[2] == 1, "bad checksums %u, want 1", health.counters[2]);
+	CHECK(health.counters[1] == 1, "frames not addressed %u, want 1", health.counters[1]);
+	CHECK(health.counters[3] == 0 && health.counters[4] == 0, "RX overruns %u timeouts %u",
+		  health.counters[3], health.counters[4]);
+	CHECK(health.counters[5] == 0 && health.counters[6] == 0, "1-wire crc %u presence %u",
+		  health.counters[5], health.counters[6]);
+	CHECK(health.counters[7] == 0, "ADC timeouts %u", health.counters[7]);
+	CHECK(health.uptime >= 2, "uptime %lu s", (unsigned long)health.uptime);
+
+	Send(id, CMD_QUERY_HEALTH, TYPE_BYTE, zero, 0);
+	getHealthData(reply + 4, &health);
+	CHECK(health.counters[0] == 1 && health.counters[2] == 0, "after reset frames %u bad %u",
+		  health.counters[0], health.counters[2]);
+
+	Send(id, CMD_HISTORY, TYPE_UINT32, zero, 0);
+	CHECK(reply_len >= 5 && IS_TYPE_BLOCK(reply[2]) && reply_len == 5 + reply[3] && ReplyValid(),
+		  "history reply of %d bytes", reply_len);
+	CHECK(reply_len >= 5 + HISTORY_DATA_SIZE && getUint32(reply + 4) == 0 &&
+		  reply[3] == HISTORY_DATA_SIZE + reply[4 + 14] * HISTORY_RECORD_SIZE,
+		  "history of %u records in %u bytes from %lu", reply[4 + 14], reply[3], (unsigned long)getUint32(reply + 4));
+
+	// 8 samples forget the old lighting level well within a second
+	Send(id, CMD_QUERY_STATS, TYPE_BYTE, &window, 0);
+	CHECK(reply_len == 5 + STATS_DATA_SIZE && IS_TYPE_BLOCK(reply[2]) && ReplyValid(),
+		  "stats reply of %d bytes", reply_len);
+	HAL_SetAdc(ADC2_CHANNEL_8, 1000);
+	HAL_Run(firmware_main, HAL_MS(1000));
+	Send(id, CMD_QUERY_STATS, TYPE_BYTE, &window, 0);
+	getStatsData(reply + 4, &stats);
+	CHECK(stats.lighting.min == stats.lighting.max && stats.lighting.stddev == 0,
+		  "lighting min %.2f max %.2f stddev %.4f over a steady window", stats.lighting.min, stats.lighting.max,
+		  stats.lighting.stddev);
+
+	// the id of the old flash layout, logged by the EEPROM task
+	memset(&stored, 0, sizeof (stored));
+	Config_Read(CONFIG_KEY_ID, &stored, sizeof (stored));
+	CHECK(stored.id == id, "EEPROM holds id %02x, want %02x", stored.id, id);
+
+	CHECK(eeprom_model.errors == 0, "%u flash operations while locked", (unsigned)eeprom_model.errors);
+	// replies go out behind Task_RS485, the longest one included
+	CHECK(tasks[0].overruns == 0, "Task_RS485 missed its %u ms deadline %u times, longest run %lu us",
+		  tasks[0].deadline, tasks[0].overruns, (unsigned long)tasks[0].wcet_us);
+
+	n = HAL_UartRead(HAL_UART3, trace, sizeof (trace));
+	if (argc > 1)
+	{
+		FILE * f = fopen(argv[1], "wb");
+
+		if (f == NULL)
+		{
+			perror(argv[1]);
+			return 1;
+		}
+		fwrite(trace, 1, n, f);
+		fclose(f);
+	}
+
+	printf("%.3f s simulated, %d debug UART bytes\n", HAL_Now() / (double)HAL_CPU_HZ, n);
+	if (failures)
+		return 1;
+	printf("OK\n");
+	return 0;
+}
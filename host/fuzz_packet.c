@@ -0,0 +1,319 @@
+// Fuzzes the RS485 receive and dispatch path of the host build: input
+// bytes go through the simulated UART1 one at a time into the RX ISR,
+// the frame events, RS485_GetFrame and Packet_Handle, on a firmware
+// that booted once. After every input the node must have released the
+// bus and must still answer a broadcast query (its select pin is
+// grounded, so the id it was given does not matter).
+// Memory errors are left to the sanitizers.
+//
+//   ./fuzz_packet                 mutates the seed frames, -n runs, -s seed
+//   ./fuzz_packet file...         runs each file as one input (AFL @@ too)
+//   ./fuzz_packet -               runs stdin as one input
+//   ./fuzz_packet -t              frames per second through the parser
+//
+// libFuzzer: configure with -DFUZZ_LIBFUZZER=ON and CC=clang. AFL: build
+// with afl-clang-fast as CC, then afl-fuzz -i seeds -o out ./fuzz_packet @@
+// where -w writes the seed frames into an existing seeds/.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hal.h"
+#include "eeprom_model.h"
+#include "packet.h"
+#include "rs485.h"
+
+void firmware_main(void);
+
+#define MAX_INPUT		512			// the UART1 RX queue of the HAL holds 1024
+#define BYTE			(HAL_CPU_HZ * 10 / 115200)
+#define QUIET_MS		20			// longer than a one-wire conversion holds the loop
+#define QUIET			HAL_MS(QUIET_MS)
+#define HOLD_MS			200			// longest the node may keep answering an input
+#define MY_ID			(DEV_MY_THESIS | 0x01)
+
+static uint8_t reply[HAL_UART_LOG];
+static int booted;
+
+static void Frame(uint8_t * out, int * len, uint8_t id, uint8_t cmd, uint8_t type, const uint8_t * data)
+{
+	int n = getTypeLength(type);
+
+	out[0] = id;
+	out[1] = cmd;
+	out[2] = type;
+	memcpy(out + 3, data, n);
+	out[3 + n] = checksum_len((char *)out, 3 + n);
+	*len = 4 + n;
+}
+
+static void Boot(void)
+{
+	EepromModel_Reset(0);
+	HAL_Reset();
+	HAL_SetPin(RS485_SEL_PORT, RS485_SEL_PIN, 0);
+	HAL_Run(firmware_main, HAL_MS(2000));
+	HAL_UartRead(HAL_UART1, reply, sizeof (reply));
+	booted = 1;
+}
+
+static void Fail(const char * what, const uint8_t * data, size_t size)
+{
+	size_t i;
+
+	fprintf(stderr, "fuzz_packet: %s after input of %u bytes:", what, (unsigned)size);
+	for (i = 0; i < size; i++)
+		fprintf(stderr, " %02x", data[i]);
+	fprintf(stderr, "\n");
+	abort();
+}
+
+// Collects what the node sends until it has released the bus and kept
+// quiet for QUIET_MS; a one-wire conversion may hold a reply back for
+// some 13 ms and a history reply is over 20 ms long. -1 if it is still
+// talking after HOLD_MS.
+static int Drain(void)
+{
+	int n = 0, len, t;
+
+	for (t = 0; t < HOLD_MS; t += QUIET_MS)
+	{
+		HAL_Run(firmware_main, QUIET);
+		len = HAL_UartRead(HAL_UART1, reply + n, sizeof (reply) - n);
+		n += len;
+		if (len == 0 && !(RS485_DIR_PORT->ODR & RS485_DIR_PIN))
+			return n;
+	}
+	return -1;
+}
+
+// Runs one input and the checks, returns the bytes the node sent.
+static int One(const uint8_t * data, size_t size)
+{
+	static const uint8_t zero[1];
+	uint8_t query[8];
+	int n, len;
+
+	if (!booted)
+		Boot();
+	if (size > MAX_INPUT)
+		size = MAX_INPUT;
+
+	HAL_UartWrite(HAL_UART1, data, (int)size);
+	HAL_Run(firmware_main, size * BYTE);
+	n = Drain();
+	if (n < 0)
+		Fail("node still talking", data, size);
+
+	Frame(query, &len, BROADCAST_ID, CMD_QUERY, TYPE_BYTE, zero);
+	HAL_UartWrite(HAL_UART1, query, len);
+	HAL_Run(firmware_main, len * BYTE);
+	len = Drain();
+	if (len != 4 + (int)sizeof (float) || (uint8_t)checksum_len((char *)reply, len - 1) != reply[len - 1])
+		Fail("no answer to a broadcast query", data, size);
+	return n;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+	One(data, size);
+	return 0;
+}
+
+#ifndef LIBFUZZER
+/* Seeds and mutation --------------------------------------------------------*/
+#define SEEDS		16
+
+static uint8_t seed[SEEDS][16];
+static int seed_len[SEEDS];
+
+static void Seeds(void)
+{
+	static const uint8_t cmds[] = {
+		CMD_CONTROL, CMD_QUERY, CMD_QUERY_STATS, CMD_QUERY_POWER, CMD_HISTORY,
+		CMD_HISTORY_PACKED, CMD_QUERY_PROFILE, CMD_QUERY_HEALTH
+	};
+	static const uint8_t first[4] = {0, 0, 0, 0};
+	uint8_t id = MY_ID;
+	int i;
+
+	for (i = 0; i < 8; i++)
+	{
+		uint8_t type = cmds[i] == CMD_HISTORY || cmds[i] == CMD_HISTORY_PACKED ? TYPE_UINT32 : TYPE_BYTE;
+
+		Frame(seed[i], &seed_len[i], MY_ID, cmds[i], type, cmds[i] == CMD_CONTROL ? &id : first);
+		Frame(seed[8 + i], &seed_len[8 + i], i & 1 ? BROADCAST_ID : MY_ID ^ 0x02, cmds[i], TYPE_FLOAT, first);
+	}
+}
+
+static int Mutate(uint8_t * buf)
+{
+	int len = 0, parts = 1 + rand() % 4, i, k;
+
+	// a few seed frames back to back, then damage
+	while (parts--)
+	{
+		k = rand() % SEEDS;
+		memcpy(buf + len, seed[k], seed_len[k]);
+		len += seed_len[k];
+	}
+	for (k = rand() % 4; k > 0; k--)
+	{
+		i = rand() % len;
+		switch (rand() % 5)
+		{
+		case 0:
+			buf[i] ^= 1 << (rand() % 8);
+			break;
+		case 1:
+			buf[i] = (uint8_t)rand();
+			break;
+		case 2:
+			// type byte, the one the parser trusts for the length
+			if (len > 2)
+				buf[2] = (uint8_t)rand();
+			break;
+		case 3:
+			memmove(buf + i, buf + i + 1, len - i - 1);
+			len--;
+			break;
+		case 4:
+			memmove(buf + i + 1, buf + i, len - i);
+			buf[i] = (uint8_t)rand();
+			len++;
+			break;
+		}
+		if (len == 0)
+			len = 1;
+	}
+	return len;
+}
+
+static int RunFile(FILE * f)
+{
+	uint8_t buf[MAX_INPUT];
+	size_t n = fread(buf, 1, sizeof (buf), f);
+
+	One(buf, n);
+	return 0;
+}
+
+static void WriteSeeds(void)
+{
+	char name[32];
+	int i;
+
+	for (i = 0; i < SEEDS; i++)
+	{
+		FILE * f;
+
+		snprintf(name, sizeof (name), "seeds/%02d", i);
+		f = fopen(name, "wb");
+		if (f == NULL)
+		{
+			perror(name);
+			exit(1);
+		}
+		fwrite(seed[i], 1, seed_len[i], f);
+		fclose(f);
+	}
+}
+
+// Well formed frames back to back: queries to this node and to others,
+// health queries. Wall clock, so it includes the cost of the simulation.
+static void Throughput(long frames)
+{
+	static const uint8_t zero[1];
+	uint8_t stream[MAX_INPUT];
+	uint64_t start_virtual = HAL_Now();
+	long sent = 0;
+	clock_t start;
+	double s;
+
+	Boot();
+	start = clock();
+	while (sent < frames)
+	{
+		int len = 0, n, k;
+
+		for (k = 0; k < 32 && sent < frames; k++, sent++)
+		{
+			static const uint8_t cmds[] = {CMD_QUERY, CMD_QUERY, CMD_QUERY_HEALTH, CMD_QUERY_STATS};
+
+			Frame(stream + len, &n, k & 1 ? MY_ID : MY_ID ^ 0x04, cmds[(k >> 1) & 3], TYPE_BYTE, zero);
+			len += n;
+		}
+		HAL_UartWrite(HAL_UART1, stream, len);
+		HAL_Run(firmware_main, len * BYTE + QUIET);
+		HAL_UartRead(HAL_UART1, reply, sizeof (reply));
+	}
+	s = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("%ld frames in %.3f s: %.0f frames/s, %.1f s of bus time simulated\n", sent, s,
+		   sent / s, (HAL_Now() - start_virtual) / (double)HAL_CPU_HZ);
+}
+
+int main(int argc, char * argv[])
+{
+	long runs = 20000, frames = 100000;
+	unsigned seed_value = 1;
+	int i, throughput = 0;
+	uint8_t buf[MAX_INPUT];
+
+	Seeds();
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			runs = atol(argv[++i]);
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+			seed_value = (unsigned)atol(argv[++i]);
+		else if (!strcmp(argv[i], "-t"))
+			throughput = 1;
+		else if (!strcmp(argv[i], "-w"))
+		{
+			WriteSeeds();
+			return 0;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [-n runs] [-s seed] [-t] [-w] [file... | -]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (throughput)
+	{
+		Throughput(frames);
+		return 0;
+	}
+	if (i < argc)
+	{
+		for (; i < argc; i++)
+		{
+			FILE * f = strcmp(argv[i], "-") ? fopen(argv[i], "rb") : stdin;
+
+			if (f == NULL)
+			{
+				perror(argv[i]);
+				return 1;
+			}
+			RunFile(f);
+			if (f != stdin)
+				fclose(f);
+		}
+		return 0;
+	}
+
+	srand(seed_value);
+	for (i = 0; i < SEEDS; i++)
+		One(seed[i], seed_len[i]);
+	for (; runs > 0; runs--)
+	{
+		int len = Mutate(buf);
+
+		One(buf, len);
+	}
+	printf("OK, %.1f s of bus time\n", HAL_Now() / (double)HAL_CPU_HZ);
+	return 0;
+}
+#endif
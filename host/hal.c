@@ -0,0 +1,1134 @@
+#include "hal.h"
+#include "eeprom_model.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+// handlers of the firmware
+void TIM3_UPD_OVF_BRK_IRQHandler(void);
+void UART1_TX_IRQHandler(void);
+void UART1_RX_IRQHandler(void);
+void UART3_TX_IRQHandler(void);
+void UART3_RX_IRQHandler(void);
+void ADC2_IRQHandler(void);
+
+#define NEVER		UINT64_MAX
+#define POLL_CYCLES	16		// what a flag poll that comes back RESET costs
+
+GPIO_TypeDef hal_gpio[6];
+ADC2_TypeDef hal_adc2;
+
+static uint64_t now;
+static uint8_t masked;
+static uint8_t in_isr;
+
+/* Cost model ---------------------------------------------------------------*/
+// Cycles the part spends on code the simulation does not otherwise time,
+// so that a reply leaves as late after its request as it would on the
+// part rather than at the stop bit. Estimates for the IAR build at
+// 16 MHz; a PROFILE build on the part reports the regions with
+// CMD_QUERY_PROFILE, and these follow when those numbers move.
+#define ISR_ENTRY		20		// 9 to stack the context, 11 for IRET
+#define COST_TIM3		(ISR_ENTRY + 180)	// tick, RS485 timeout, releases
+#define COST_UART1_RX	(ISR_ENTRY + 140)	// frame state machine, event
+#define COST_UART1_TX	(ISR_ENTRY + 50)
+#define COST_UART3_TX	(ISR_ENTRY + 50)
+#define COST_UART3_RX	(ISR_ENTRY + 40)
+#define COST_ADC		(ISR_ENTRY + 120)	// oversampling accumulate
+
+// charged as a region is entered, so the work lands before what it
+// leads to, such as a reply
+static const uint32_t region_cycles[PROFILE_COUNT] =
+{
+	2400,	// packet: Task_RS485 taking the frame off the ring, Packet_Handle
+	900,	// adc: decimation and calibration of a reading
+	3000,	// 1-wire search: the ROM tree walk between the slots
+	1600,	// 1-wire read: scratchpad CRC and conversion to float
+	700,	// history: a record into the RAM block
+};
+
+/* Coroutine ----------------------------------------------------------------*/
+#define FIRMWARE_STACK	(1024 * 1024)
+
+static ucontext_t test_ctx, fw_ctx;
+static void (*fw_entry)(void);
+static uint8_t fw_started, fw_running;
+static uint64_t run_end;
+
+static void Hal_Entry(void)
+{
+	fw_entry();
+	// main returned, park the coroutine
+	for (;;)
+		swapcontext(&fw_ctx, &test_ctx);
+}
+
+static void Hal_Yield(void)
+{
+	if (fw_running && !in_isr && now >= run_end)
+	{
+		fw_running = 0;
+		swapcontext(&fw_ctx, &test_ctx);
+	}
+}
+
+/* Timers -------------------------------------------------------------------*/
+struct hal_timer
+{
+	uint8_t on;
+	uint8_t it;
+	uint8_t uif;
+	uint32_t tick;		// cycles per count
+	uint16_t arr;
+	uint64_t start;
+	uint64_t next;		// next update event
+};
+
+static struct hal_timer tim1, tim2, tim3;
+static uint8_t tim1_trgo;
+
+static void Timer_Base(struct hal_timer * t, uint32_t tick, uint16_t arr)
+{
+	t->tick = tick;
+	t->arr = arr;
+}
+
+static void Timer_Cmd(struct hal_timer * t, FunctionalState state)
+{
+	t->on = state == ENABLE;
+	t->start = now;
+	t->next = t->on ? now + (uint64_t)t->tick * (t->arr + 1) : NEVER;
+}
+
+static uint16_t Timer_Counter(struct hal_timer * t)
+{
+	if (!t->on || !t->tick)
+		return 0;
+	return (uint16_t)(((now - t->start) / t->tick) % ((uint32_t)t->arr + 1));
+}
+
+/* ADC2 ---------------------------------------------------------------------*/
+static uint16_t adc_value[16];
+static uint8_t adc_on, adc_exttrig;
+
+static void Adc_Trigger(void)
+{
+	uint16_t v;
+
+	if (!adc_on || !adc_exttrig)
+		return;
+	v = adc_value[ADC2->CSR & ADC2_CSR_CH] & 0x3FF;
+	ADC2->DRH = (uint8_t)(v >> 8);
+	ADC2->DRL = (uint8_t)v;
+	ADC2->CSR |= ADC2_CSR_EOC;
+}
+
+/* UARTs --------------------------------------------------------------------*/
+#define RX_QUEUE	1024
+
+struct hal_uart
+{
+	uint32_t byte;			// cycles per 10 bit frame
+	uint8_t it_txe, it_tc, it_rxne;
+
+	// transmitter: data register and shift register
+	uint8_t dr_full, dr;
+	uint64_t shift_end;
+	uint8_t log[HAL_UART_LOG];
+	uint64_t log_time[HAL_UART_LOG];	// when the byte started to shift out
+	int log_head, log_tail;
+	uint32_t forced_baud;
+
+	// receiver
+	uint8_t rxne, overrun, rx_dr;
+	uint8_t rx_byte[RX_QUEUE];
+	uint64_t rx_time[RX_QUEUE];
+	int rx_head, rx_tail;
+	uint64_t rx_last;
+};
+
+static struct hal_uart uart[HAL_UARTS];
+
+static void Uart_Init(struct hal_uart * u, uint32_t baud)
+{
+	if (u->forced_baud)
+		baud = u->forced_baud;
+	u->byte = (uint32_t)(HAL_CPU_HZ * 10 / baud);
+	u->dr_full = 0;
+	u->shift_end = now;
+	u->rxne = u->overrun = 0;
+}
+
+static void Uart_Shift(struct hal_uart * u, uint8_t c)
+{
+	uint64_t start = u->shift_end > now ? u->shift_end : now;
+
+	u->shift_end = start + u->byte;
+	u->log[u->log_head] = c;
+	u->log_time[u->log_head] = start;
+	u->log_head = (u->log_head + 1) % HAL_UART_LOG;
+	if (u->log_head == u->log_tail)
+		u->log_tail = (u->log_tail + 1) % HAL_UART_LOG;
+}
+
+static void Uart_Send(struct hal_uart * u, uint8_t c)
+{
+	if (!u->dr_full && now >= u->shift_end)
+	{
+		Uart_Shift(u, c);
+		return;
+	}
+	// a second write before TXE overwrites the data register
+	u->dr = c;
+	u->dr_full = 1;
+}
+
+static FlagStatus Uart_Flag(struct hal_uart * u, uint16_t flag)
+{
+	FlagStatus s = RESET;
+
+	switch (flag)
+	{
+	case 0x0080:
+		s = u->dr_full ? RESET : SET;
+		break;
+	case 0x0040:
+		s = !u->dr_full && now >= u->shift_end ? SET : RESET;
+		break;
+	case 0x0020:
+		s = u->rxne ? SET : RESET;
+		break;
+	case 0x0008:
+		s = u->overrun ? SET : RESET;
+		break;
+	}
+	return s;
+}
+
+static uint8_t Uart_Receive(struct hal_uart * u)
+{
+	u->rxne = 0;
+	u->overrun = 0;
+	return u->rx_dr;
+}
+
+static void Uart_Step(struct hal_uart * u)
+{
+	if (u->dr_full && now >= u->shift_end)
+	{
+		u->dr_full = 0;
+		Uart_Shift(u, u->dr);
+	}
+	while (u->rx_tail != u->rx_head && u->rx_time[u->rx_tail] <= now)
+	{
+		if (u->rxne)
+			u->overrun = 1;		// the byte is lost, as on the part
+		else
+		{
+			u->rx_dr = u->rx_byte[u->rx_tail];
+			u->rxne = 1;
+		}
+		u->rx_tail = (u->rx_tail + 1) % RX_QUEUE;
+	}
+}
+
+static uint64_t Uart_Next(struct hal_uart * u)
+{
+	uint64_t t = NEVER;
+
+	if (u->dr_full || (u->it_tc && u->shift_end > now))
+		t = u->shift_end;
+	if (u->rx_tail != u->rx_head && u->rx_time[u->rx_tail] < t)
+		t = u->rx_time[u->rx_tail];
+	return t;
+}
+
+/* 1-wire DS18B20 -----------------------------------------------------------*/
+#define OW_IDLE		0	// waits for a reset
+#define OW_ROM		1	// receives the ROM command
+#define OW_MATCH	2
+#define OW_SEARCH	3
+#define OW_FUNC		4	// receives the function command
+#define OW_TX		5
+#define OW_RX		6
+#define OW_CONVERT	7	// read slots give 0 until the conversion ends
+#define OW_ONES		8	// read slots give 1
+
+static struct
+{
+	uint8_t present;
+	uint8_t rom[8];
+	uint8_t pad[9];
+	int16_t temperature;
+
+	uint8_t state;
+	uint8_t shift, bits;		// command being received
+	uint8_t search_phase;		// bit, complement, next slot direction, direction slot
+	uint8_t tx[9], tx_len;
+	uint8_t tx_bit;
+	uint64_t fall, low_until, presence_start, presence_end, conv_end;
+	uint8_t master_low;
+	uint32_t errors;
+} ow;
+
+static uint8_t Ow_Crc8(const uint8_t * p, uint8_t len)
+{
+	uint8_t crc = 0, i;
+
+	while (len--)
+	{
+		uint8_t in = *p++;
+		for (i = 0; i < 8; i++)
+		{
+			uint8_t mix = (crc ^ in) & 1;
+			crc >>= 1;
+			if (mix)
+				crc ^= 0x8C;
+			in >>= 1;
+		}
+	}
+	return crc;
+}
+
+static uint8_t Ow_RomBit(uint8_t n)
+{
+	return (ow.rom[n >> 3] >> (n & 7)) & 1;
+}
+
+static void Ow_Transmit(const uint8_t * data, uint8_t len)
+{
+	memcpy(ow.tx, data, len);
+	ow.tx_len = len;
+	ow.tx_bit = 0;
+	ow.state = OW_TX;
+}
+
+static void Ow_Function(uint8_t cmd)
+{
+	static const uint16_t conv_ms[4] = {94, 188, 375, 750};
+	uint8_t res = (ow.pad[4] >> 5) & 3;
+	int16_t raw;
+
+	switch (cmd)
+	{
+	case 0x44:	// convert T
+		raw = ow.temperature & (int16_t)(0xFFFF << (3 - res));
+		ow.pad[0] = (uint8_t)raw;
+		ow.pad[1] = (uint8_t)((uint16_t)raw >> 8);
+		ow.conv_end = now + HAL_MS(conv_ms[res]);
+		ow.state = OW_CONVERT;
+		break;
+	case 0xBE:	// read scratchpad
+		ow.pad[8] = Ow_Crc8(ow.pad, 8);
+		Ow_Transmit(ow.pad, 9);
+		break;
+	case 0x4E:	// write scratchpad: TH, TL, configuration
+		ow.bits = 0;
+		ow.shift = 2;		// next pad byte
+		ow.state = OW_RX;
+		break;
+	case 0xB4:	// read power supply, externally powered
+	case 0x48:	// copy scratchpad
+	case 0xB8:	// recall
+		ow.state = OW_ONES;
+		break;
+	default:
+		ow.errors++;
+		ow.state = OW_IDLE;
+		break;
+	}
+}
+
+static void Ow_Rom(uint8_t cmd)
+{
+	switch (cmd)
+	{
+	case 0x33:	// read ROM
+		Ow_Transmit(ow.rom, 8);
+		break;
+	case 0x55:	// match ROM
+		ow.bits = 0;
+		ow.state = OW_MATCH;
+		break;
+	case 0xCC:	// skip ROM
+		ow.bits = 0;
+		ow.shift = 0;
+		ow.state = OW_FUNC;
+		break;
+	case 0xF0:	// search ROM
+		ow.bits = 0;
+		ow.search_phase = 0;
+		ow.state = OW_SEARCH;
+		break;
+	case 0xEC:	// alarm search, no alarm set
+		ow.state = OW_IDLE;
+		break;
+	default:
+		ow.errors++;
+		ow.state = OW_IDLE;
+		break;
+	}
+}
+
+// master pulled the line low: a slot starts, the device drives its bit
+static void Ow_Fall(void)
+{
+	int bit = -1;
+
+	ow.fall = now;
+	if (!ow.present)
+		return;
+	switch (ow.state)
+	{
+	case OW_SEARCH:
+		if (ow.search_phase == 0)
+			bit = Ow_RomBit(ow.bits);
+		else if (ow.search_phase == 1)
+			bit = !Ow_RomBit(ow.bits);
+		ow.search_phase++;
+		break;
+	case OW_TX:
+		bit = (ow.tx[ow.tx_bit >> 3] >> (ow.tx_bit & 7)) & 1;
+		if (++ow.tx_bit == ow.tx_len * 8)
+			ow.state = OW_ONES;
+		break;
+	case OW_CONVERT:
+		bit = now >= ow.conv_end;
+		break;
+	}
+	if (bit == 0)
+		ow.low_until = now + HAL_US(30);
+
+}
+
+// master let go: the width tells a reset, a 0 or a 1
+static void Ow_Release(void)
+{
+	uint64_t width = now - ow.fall;
+	uint8_t bit;
+
+	if (width >= HAL_US(480))
+	{
+		if (ow.present)
+		{
+			ow.presence_start = now + HAL_US(30);
+			ow.presence_end = now + HAL_US(150);
+		}
+		ow.state = OW_ROM;
+		ow.shift = ow.bits = 0;
+		return;
+	}
+	if (!ow.present)
+		return;
+	if (width > HAL_US(120))
+	{
+		ow.errors++;
+		return;
+	}
+	bit = width < HAL_US(15);
+
+	switch (ow.state)
+	{
+	case OW_ROM:
+	case OW_FUNC:
+		ow.shift |= bit << ow.bits;
+		if (++ow.bits == 8)
+		{
+			uint8_t cmd = ow.shift;
+
+			ow.shift = ow.bits = 0;
+			if (ow.state == OW_ROM)
+				Ow_Rom(cmd);
+			else
+				Ow_Function(cmd);
+		}
+		break;
+	case OW_MATCH:
+		if (bit != Ow_RomBit(ow.bits))
+			ow.state = OW_IDLE;
+		else if (++ow.bits == 64)
+		{
+			ow.shift = ow.bits = 0;
+			ow.state = OW_FUNC;
+		}
+		break;
+	case OW_SEARCH:
+		if (ow.search_phase != 3)
+			break;
+		ow.search_phase = 0;
+		if (bit != Ow_RomBit(ow.bits))
+			ow.state = OW_IDLE;
+		else if (++ow.bits == 64)
+		{
+			ow.shift = ow.bits = 0;
+			ow.state = OW_FUNC;
+		}
+		break;
+	case OW_RX:
+		if (bit)
+			ow.pad[ow.shift] |= 1 << ow.bits;
+		else
+			ow.pad[ow.shift] &= ~(1 << ow.bits);
+		if (++ow.bits == 8)
+		{
+			ow.bits = 0;
+			if (++ow.shift == 5)
+			{
+				ow.pad[4] |= 0x1F;
+				ow.state = OW_ONES;
+			}
+		}
+		break;
+	}
+}
+
+static uint8_t Ow_Line(void)
+{
+	if (ow.master_low)
+		return 0;
+	if (ow.present && (now < ow.low_until || (now >= ow.presence_start && now < ow.presence_end)))
+		return 0;
+	return 1;
+}
+
+/* GPIO ---------------------------------------------------------------------*/
+static uint8_t pin_level[6];
+static void (*output_hook)(GPIO_TypeDef * port);
+
+#define OW_PORT		GPIOC
+#define OW_PIN		GPIO_PIN_1
+
+static void Gpio_Changed(GPIO_TypeDef * port)
+{
+	uint8_t low;
+
+	if (output_hook)
+		output_hook(port);
+	if (port != OW_PORT)
+		return;
+	low = (port->DDR & OW_PIN) && !(port->ODR & OW_PIN);
+	if (low == ow.master_low)
+		return;
+	ow.master_low = low;
+	if (low)
+		Ow_Fall();
+	else
+		Ow_Release();
+}
+
+/* Time ---------------------------------------------------------------------*/
+static void Hal_Step(void)
+{
+	uint8_t i;
+
+	while (tim3.on && tim3.next <= now)
+	{
+		tim3.uif = 1;
+		tim3.next += (uint64_t)tim3.tick * (tim3.arr + 1);
+	}
+	while (tim1.on && tim1.next <= now)
+	{
+		if (tim1_trgo)
+			Adc_Trigger();
+		tim1.next += (uint64_t)tim1.tick * (tim1.arr + 1);
+	}
+	for (i = 0; i < HAL_UARTS; i++)
+		Uart_Step(&uart[i]);
+}
+
+static uint64_t Hal_Next(void)
+{
+	uint64_t t = NEVER, u;
+	uint8_t i;
+
+	if (tim3.on && tim3.next < t)
+		t = tim3.next;
+	if (tim1.on && tim1.next < t)
+		t = tim1.next;
+	for (i = 0; i < HAL_UARTS; i++)
+		if ((u = Uart_Next(&uart[i])) < t)
+			t = u;
+	return t;
+}
+
+// A handler's run time: what falls due meanwhile is pending when the
+// next handler is picked, as it is on the part.
+static void Hal_Busy(uint32_t cycles)
+{
+	now += cycles;
+	Hal_Step();
+}
+
+// Runs the pending handlers in vector order, returns how many ran.
+static int Hal_Deliver(void)
+{
+	int ran = 0;
+
+	if (masked || in_isr)
+		return 0;
+	in_isr = 1;
+	for (;;)
+	{
+		if (tim3.it && tim3.uif)
+		{
+			TIM3_UPD_OVF_BRK_IRQHandler();
+			Hal_Busy(COST_TIM3);
+		}
+		else if ((uart[HAL_UART1].it_txe && !uart[HAL_UART1].dr_full) ||
+				 (uart[HAL_UART1].it_tc && Uart_Flag(&uart[HAL_UART1], UART1_FLAG_TC) == SET))
+		{
+			UART1_TX_IRQHandler();
+			Hal_Busy(COST_UART1_TX);
+		}
+		else if (uart[HAL_UART1].it_rxne && (uart[HAL_UART1].rxne || uart[HAL_UART1].overrun))
+		{
+			UART1_RX_IRQHandler();
+			Hal_Busy(COST_UART1_RX);
+		}
+		else if (uart[HAL_UART3].it_txe && !uart[HAL_UART3].dr_full)
+		{
+			UART3_TX_IRQHandler();
+			Hal_Busy(COST_UART3_TX);
+		}
+		else if (uart[HAL_UART3].it_rxne && (uart[HAL_UART3].rxne || uart[HAL_UART3].overrun))
+		{
+			UART3_RX_IRQHandler();
+			Hal_Busy(COST_UART3_RX);
+		}
+		else if ((ADC2->CSR & ADC2_CSR_EOCIE) && (ADC2->CSR & ADC2_CSR_EOC))
+		{
+			ADC2_IRQHandler();
+			Hal_Busy(COST_ADC);
+		}
+		else
+			break;
+		if (++ran > 100000)
+		{
+			fprintf(stderr, "hal: an interrupt handler does not clear its flag\n");
+			abort();
+		}
+	}
+	in_isr = 0;
+	return ran;
+}
+
+static void Hal_AdvanceTo(uint64_t target)
+{
+	uint64_t t;
+
+	if (in_isr)
+	{
+		// handlers only poll flags, which do not depend on time here
+		if (target > now)
+			now = target;
+		return;
+	}
+	for (;;)
+	{
+		Hal_Deliver();
+		t = Hal_Next();
+		if (t > target)
+			break;
+		if (t > now)
+			now = t;
+		Hal_Step();
+	}
+	if (target > now)
+		now = target;
+	Hal_Step();
+	Hal_Deliver();
+	Hal_Yield();
+}
+
+void EepromModel_Busy(uint32_t us)
+{
+	Hal_AdvanceTo(now + HAL_US(us));
+}
+
+void HAL_ProfileEnter(uint8_t region)
+{
+	Hal_AdvanceTo(now + region_cycles[region]);
+}
+
+/* Test side ----------------------------------------------------------------*/
+void HAL_Reset(void)
+{
+	static const uint8_t rom[8] = {0x28, 0x53, 0x45, 0x4E, 0x53, 0x45, 0x00, 0x00};
+	uint32_t baud;
+	uint8_t i;
+
+	now = 0;
+	masked = 1;
+	in_isr = 0;
+	memset(hal_gpio, 0, sizeof (hal_gpio));
+	memset(&hal_adc2, 0, sizeof (hal_adc2));
+	memset(&tim1, 0, sizeof (tim1));
+	memset(&tim2, 0, sizeof (tim2));
+	memset(&tim3, 0, sizeof (tim3));
+	for (i = 0; i < HAL_UARTS; i++)
+	{
+		baud = uart[i].forced_baud;
+		memset(&uart[i], 0, sizeof (uart[i]));
+		uart[i].forced_baud = baud;
+	}
+	memset(pin_level, 0xFF, sizeof (pin_level));
+	memset(adc_value, 0, sizeof (adc_value));
+	adc_on = adc_exttrig = 0;
+	tim1_trgo = 0;
+
+	memset(&ow, 0, sizeof (ow));
+	HAL_OneWireDevice(rom, 1);
+	HAL_OneWireTemperature(25 * 16);
+	// power up scratchpad: 85 C, alarms, 12 bit
+	ow.pad[0] = 0x50;
+	ow.pad[1] = 0x05;
+	ow.pad[2] = 0x4B;
+	ow.pad[3] = 0x46;
+	ow.pad[4] = 0x7F;
+	ow.pad[5] = 0xFF;
+	ow.pad[6] = 0x0C;
+	ow.pad[7] = 0x10;
+}
+
+void HAL_Run(void (*entry)(void), uint64_t cycles)
+{
+	static char stack[FIRMWARE_STACK];
+
+	run_end = now + cycles;
+	if (!fw_started)
+	{
+		fw_started = 1;
+		fw_entry = entry;
+		getcontext(&fw_ctx);
+		fw_ctx.uc_stack.ss_sp = stack;
+		fw_ctx.uc_stack.ss_size = sizeof (stack);
+		fw_ctx.uc_link = 0;
+		makecontext(&fw_ctx, Hal_Entry, 0);
+	}
+	fw_running = 1;
+	swapcontext(&test_ctx, &fw_ctx);
+}
+
+uint64_t HAL_Now(void)
+{
+	return now;
+}
+
+void HAL_UartWrite(uint8_t port, const uint8_t * data, int len)
+{
+	struct hal_uart * u = &uart[port];
+	uint32_t byte = u->byte ? u->byte : HAL_CPU_HZ * 10 / 115200;
+
+	if (u->rx_last < now)
+		u->rx_last = now;
+	while (len--)
+	{
+		int next = (u->rx_head + 1) % RX_QUEUE;
+
+		if (next == u->rx_tail)
+			break;
+		u->rx_last += byte;
+		u->rx_byte[u->rx_head] = *data++;
+		u->rx_time[u->rx_head] = u->rx_last;
+		u->rx_head = next;
+	}
+}
+
+void HAL_UartReceiveAt(uint8_t port, uint8_t c, uint64_t when)
+{
+	struct hal_uart * u = &uart[port];
+	int next = (u->rx_head + 1) % RX_QUEUE;
+
+	if (next == u->rx_tail)
+		return;
+	if (when > u->rx_last)
+		u->rx_last = when;
+	u->rx_byte[u->rx_head] = c;
+	u->rx_time[u->rx_head] = u->rx_last;
+	u->rx_head = next;
+}
+
+int HAL_UartRead(uint8_t port, uint8_t * data, int size)
+{
+	return HAL_UartSent(port, data, NULL, size);
+}
+
+int HAL_UartSent(uint8_t port, uint8_t * data, uint64_t * when, int size)
+{
+	struct hal_uart * u = &uart[port];
+	int n = 0;
+
+	while (n < size && u->log_tail != u->log_head)
+	{
+		if (when)
+			when[n] = u->log_time[u->log_tail];
+		data[n++] = u->log[u->log_tail];
+		u->log_tail = (u->log_tail + 1) % HAL_UART_LOG;
+	}
+	return n;
+}
+
+void HAL_UartBaud(uint8_t port, uint32_t baud)
+{
+	uart[port].forced_baud = baud;
+}
+
+uint32_t HAL_UartByteTime(uint8_t port)
+{
+	return uart[port].byte;
+}
+
+void HAL_OnOutput(void (*hook)(GPIO_TypeDef * port))
+{
+	output_hook = hook;
+}
+
+void HAL_SetPin(GPIO_TypeDef * port, uint8_t pin, uint8_t level)
+{
+	uint8_t * l = &pin_level[port - hal_gpio];
+
+	*l = level ? *l | pin : *l & ~pin;
+}
+
+void HAL_SetAdc(uint8_t channel, uint16_t value)
+{
+	adc_value[channel & 0x0F] = value;
+}
+
+void HAL_OneWireDevice(const uint8_t rom[8], uint8_t present)
+{
+	memcpy(ow.rom, rom, 7);
+	ow.rom[7] = Ow_Crc8(ow.rom, 7);
+	ow.present = present;
+}
+
+void HAL_OneWireTemperature(int16_t sixteenths)
+{
+	ow.temperature = sixteenths;
+}
+
+uint32_t HAL_OneWireErrors(void)
+{
+	return ow.errors;
+}
+
+/* Core ---------------------------------------------------------------------*/
+void rim(void)
+{
+	masked = 0;
+	Hal_Deliver();
+}
+
+void sim(void)
+{
+	masked = 1;
+}
+
+void wfi(void)
+{
+	uint64_t t;
+
+	masked = 0;
+	if (Hal_Deliver())
+	{
+		// the handlers' cost moved the clock, the run may be over
+		Hal_Yield();
+		return;
+	}
+	t = Hal_Next();
+	if (t > run_end)
+		t = run_end;
+	Hal_AdvanceTo(t > now ? t : now);
+}
+
+void halt(void)
+{
+	wfi();
+}
+
+void nop(void)
+{
+	Hal_AdvanceTo(now + HAL_US(1));
+}
+
+/* GPIO ---------------------------------------------------------------------*/
+void GPIO_Init(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef GPIO_Pin, GPIO_Mode_TypeDef GPIO_Mode)
+{
+	if (GPIO_Mode & 0x80)
+	{
+		if (GPIO_Mode & 0x10)
+			GPIOx->ODR |= GPIO_Pin;
+		else
+			GPIOx->ODR &= ~GPIO_Pin;
+		GPIOx->DDR |= GPIO_Pin;
+	}
+	else
+	{
+		GPIOx->DDR &= ~GPIO_Pin;
+	}
+	Gpio_Changed(GPIOx);
+}
+
+void GPIO_WriteHigh(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef PortPins)
+{
+	GPIOx->ODR |= PortPins;
+	Gpio_Changed(GPIOx);
+}
+
+void GPIO_WriteLow(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef PortPins)
+{
+	GPIOx->ODR &= ~PortPins;
+	Gpio_Changed(GPIOx);
+}
+
+void GPIO_WriteReverse(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef PortPins)
+{
+	GPIOx->ODR ^= PortPins;
+	Gpio_Changed(GPIOx);
+}
+
+BitStatus GPIO_ReadInputPin(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef GPIO_Pin)
+{
+	uint8_t level;
+
+	if (GPIOx == OW_PORT && GPIO_Pin == OW_PIN)
+		level = Ow_Line();
+	else if (GPIOx->DDR & GPIO_Pin)
+		level = (GPIOx->ODR & GPIO_Pin) != 0;
+	else
+		level = (pin_level[GPIOx - hal_gpio] & GPIO_Pin) != 0;
+	return level ? SET : RESET;
+}
+
+/* CLK ----------------------------------------------------------------------*/
+void CLK_HSIPrescalerConfig(CLK_Prescaler_TypeDef HSIPrescaler)
+{
+	(void)HSIPrescaler;
+}
+
+void CLK_PeripheralClockConfig(CLK_Peripheral_TypeDef CLK_Peripheral, FunctionalState NewState)
+{
+	// a gated TIM2 stops counting
+	if (CLK_Peripheral == CLK_PERIPHERAL_TIMER2 && NewState == DISABLE)
+		tim2.on = 0;
+}
+
+/* TIM1 ---------------------------------------------------------------------*/
+void TIM1_DeInit(void)
+{
+	memset(&tim1, 0, sizeof (tim1));
+	tim1_trgo = 0;
+}
+
+void TIM1_TimeBaseInit(uint16_t TIM1_Prescaler, TIM1_CounterMode_TypeDef TIM1_CounterMode,
+					   uint16_t TIM1_Period, uint8_t TIM1_RepetitionCounter)
+{
+	(void)TIM1_CounterMode;
+	(void)TIM1_RepetitionCounter;
+	Timer_Base(&tim1, (uint32_t)TIM1_Prescaler + 1, TIM1_Period);
+}
+
+void TIM1_SelectOutputTrigger(TIM1_TRGOSource_TypeDef TIM1_TRGOSource)
+{
+	tim1_trgo = TIM1_TRGOSource == TIM1_TRGOSOURCE_UPDATE;
+}
+
+void TIM1_Cmd(FunctionalState NewState)
+{
+	Timer_Cmd(&tim1, NewState);
+}
+
+/* TIM2 ---------------------------------------------------------------------*/
+void TIM2_TimeBaseInit(TIM2_Prescaler_TypeDef TIM2_Prescaler, uint16_t TIM2_Period)
+{
+	Timer_Base(&tim2, 1UL << TIM2_Prescaler, TIM2_Period);
+}
+
+void TIM2_Cmd(FunctionalState NewState)
+{
+	Timer_Cmd(&tim2, NewState);
+}
+
+uint16_t TIM2_GetCounter(void)
+{
+	return Timer_Counter(&tim2);
+}
+
+/* TIM3 ---------------------------------------------------------------------*/
+void TIM3_TimeBaseInit(TIM3_Prescaler_TypeDef TIM3_Prescaler, uint16_t TIM3_Period)
+{
+	Timer_Base(&tim3, 1UL << TIM3_Prescaler, TIM3_Period);
+}
+
+void TIM3_ClearFlag(TIM3_FLAG_TypeDef TIM3_FLAG)
+{
+	(void)TIM3_FLAG;
+	tim3.uif = 0;
+}
+
+FlagStatus TIM3_GetFlagStatus(TIM3_FLAG_TypeDef TIM3_FLAG)
+{
+	(void)TIM3_FLAG;
+	Hal_Step();
+	return tim3.uif ? SET : RESET;
+}
+
+void TIM3_ITConfig(TIM3_IT_TypeDef TIM3_IT, FunctionalState NewState)
+{
+	(void)TIM3_IT;
+	tim3.it = NewState == ENABLE;
+}
+
+void TIM3_Cmd(FunctionalState NewState)
+{
+	Timer_Cmd(&tim3, NewState);
+}
+
+uint16_t TIM3_GetCounter(void)
+{
+	return Timer_Counter(&tim3);
+}
+
+void TIM3_ClearITPendingBit(TIM3_IT_TypeDef TIM3_IT)
+{
+	(void)TIM3_IT;
+	tim3.uif = 0;
+}
+
+/* UART1 --------------------------------------------------------------------*/
+void UART1_DeInit(void)
+{
+	uart[HAL_UART1].it_rxne = uart[HAL_UART1].it_txe = uart[HAL_UART1].it_tc = 0;
+}
+
+void UART1_Init(uint32_t BaudRate, UART1_WordLength_TypeDef WordLength, UART1_StopBits_TypeDef StopBits,
+				UART1_Parity_TypeDef Parity, UART1_SyncMode_TypeDef SyncMode, UART1_Mode_TypeDef Mode)
+{
+	(void)WordLength; (void)StopBits; (void)Parity; (void)SyncMode; (void)Mode;
+	Uart_Init(&uart[HAL_UART1], BaudRate);
+}
+
+void UART1_ITConfig(UART1_IT_TypeDef UART1_IT, FunctionalState NewState)
+{
+	if (UART1_IT == UART1_IT_RXNE_OR || UART1_IT == UART1_IT_RXNE)
+		uart[HAL_UART1].it_rxne = NewState == ENABLE;
+	else if (UART1_IT == UART1_IT_TXE)
+		uart[HAL_UART1].it_txe = NewState == ENABLE;
+	else if (UART1_IT == UART1_IT_TC)
+		uart[HAL_UART1].it_tc = NewState == ENABLE;
+	if (NewState == ENABLE)
+		Hal_Deliver();
+}
+
+uint8_t UART1_ReceiveData8(void)
+{
+	return Uart_Receive(&uart[HAL_UART1]);
+}
+
+void UART1_SendData8(uint8_t Data)
+{
+	Uart_Send(&uart[HAL_UART1], Data);
+}
+
+FlagStatus UART1_GetFlagStatus(UART1_Flag_TypeDef UART1_FLAG)
+{
+	FlagStatus s = Uart_Flag(&uart[HAL_UART1], UART1_FLAG);
+
+	if (s == RESET)
+		Hal_AdvanceTo(now + POLL_CYCLES);
+	return s;
+}
+
+void UART1_ClearITPendingBit(UART1_IT_TypeDef UART1_IT)
+{
+	if (UART1_IT == UART1_IT_RXNE)
+		uart[HAL_UART1].rxne = 0;
+}
+
+/* UART3 --------------------------------------------------------------------*/
+void UART3_DeInit(void)
+{
+	uart[HAL_UART3].it_rxne = uart[HAL_UART3].it_txe = 0;
+}
+
+void UART3_Init(uint32_t BaudRate, UART3_WordLength_TypeDef WordLength, UART3_StopBits_TypeDef StopBits,
+				UART3_Parity_TypeDef Parity, UART3_Mode_TypeDef Mode)
+{
+	(void)WordLength; (void)StopBits; (void)Parity; (void)Mode;
+	Uart_Init(&uart[HAL_UART3], BaudRate);
+}
+
+void UART3_ITConfig(UART3_IT_TypeDef UART3_IT, FunctionalState NewState)
+{
+	if (UART3_IT == UART3_IT_RXNE_OR || UART3_IT == UART3_IT_RXNE)
+		uart[HAL_UART3].it_rxne = NewState == ENABLE;
+	else if (UART3_IT == UART3_IT_TXE)
+		uart[HAL_UART3].it_txe = NewState == ENABLE;
+	if (NewState == ENABLE)
+		Hal_Deliver();
+}
+
+uint8_t UART3_ReceiveData8(void)
+{
+	return Uart_Receive(&uart[HAL_UART3]);
+}
+
+void UART3_SendData8(uint8_t Data)
+{
+	Uart_Send(&uart[HAL_UART3], Data);
+}
+
+FlagStatus UART3_GetFlagStatus(UART3_Flag_TypeDef UART3_FLAG)
+{
+	FlagStatus s = Uart_Flag(&uart[HAL_UART3], UART3_FLAG);
+
+	if (s == RESET)
+		Hal_AdvanceTo(now + POLL_CYCLES);
+	return s;
+}
+
+void UART3_ClearITPendingBit(UART3_IT_TypeDef UART3_IT)
+{
+	if (UART3_IT == UART3_IT_RXNE)
+		uart[HAL_UART3].rxne = 0;
+}
+
+/* ADC2 ---------------------------------------------------------------------*/
+void ADC2_DeInit(void)
+{
+	memset(&hal_adc2, 0, sizeof (hal_adc2));
+	adc_on = adc_exttrig = 0;
+}
+
+void ADC2_Init(ADC2_ConvMode_TypeDef ADC2_ConversionMode, ADC2_Channel_TypeDef ADC2_Channel,
+			   ADC2_PresSel_TypeDef ADC2_PrescalerSelection, ADC2_ExtTrig_TypeDef ADC2_ExtTrigger,
+			   FunctionalState ADC2_ExtTriggerState, ADC2_Align_TypeDef ADC2_Align,
+			   ADC2_SchmittTrigg_TypeDef ADC2_SchmittTriggerChannel, FunctionalState ADC2_SchmittTriggerState)
+{
+	(void)ADC2_ConversionMode; (void)ADC2_PrescalerSelection; (void)ADC2_Align;
+	(void)ADC2_SchmittTriggerChannel; (void)ADC2_SchmittTriggerState;
+	ADC2->CSR = (uint8_t)((ADC2->CSR & ~ADC2_CSR_CH) | ADC2_Channel);
+	adc_exttrig = ADC2_ExtTrigger == ADC2_EXTTRIG_TIM && ADC2_ExtTriggerState == ENABLE;
+	adc_on = 1;
+}
+
+void ADC2_SchmittTriggerConfig(ADC2_SchmittTrigg_TypeDef ADC2_SchmittTriggerChannel, FunctionalState NewState)
+{
+	(void)ADC2_SchmittTriggerChannel;
+	(void)NewState;
+}
+
+void ADC2_ITConfig(FunctionalState NewState)
+{
+	if (NewState == ENABLE)
+		ADC2->CSR |= ADC2_CSR_EOCIE;
+	else
+		ADC2->CSR &= (uint8_t)~ADC2_CSR_EOCIE;
+}
+
+uint16_t ADC2_GetConversionValue(void)
+{
+	return (uint16_t)(((uint16_t)ADC2->DRH << 8) | ADC2->DRL);
+}
@@ -0,0 +1,78 @@
+#ifndef _hal_h_
+#define _hal_h_
+
+#include "stm8s.h"
+
+// Simulated STM8S207 for host builds of the firmware. Time is virtual,
+// in CPU cycles at 16 MHz: it moves when the firmware waits (WFI, the
+// 1-wire delay loops, polled UART flags, flash cycles) and by a cost
+// model for computation, fixed cycles per interrupt handler and per
+// profile.h region (hal.c), so runs are exact and repeatable.
+// Interrupts are taken when time moves with the mask clear.
+//
+// The firmware main loop runs as a coroutine beside the test: HAL_Run
+// lets it go until the virtual clock reaches a point, then returns.
+// Globals of the firmware live in the process, so there is one boot
+// per process.
+
+#define HAL_CPU_HZ			16000000UL
+#define HAL_US(us)			((uint64_t)(us) * (HAL_CPU_HZ / 1000000))
+#define HAL_MS(ms)			((uint64_t)(ms) * (HAL_CPU_HZ / 1000))
+
+#define HAL_UART1			0	// RS485
+#define HAL_UART3			1	// debug
+#define HAL_UARTS			2
+
+#define HAL_UART_LOG		8192	// bytes kept of what a port sent
+
+// Puts the peripherals in their reset state and the clock at 0. The
+// EEPROM and program flash of host/eeprom_model.c are left alone.
+void HAL_Reset(void);
+
+// Runs entry, normally the firmware main, until the clock reaches
+// HAL_Now() + cycles. Later calls carry on where it stopped.
+void HAL_Run(void (*entry)(void), uint64_t cycles);
+
+uint64_t HAL_Now(void);
+
+// Queues bytes for a port's receiver, back to back at its baud rate
+// after whatever is already queued.
+void HAL_UartWrite(uint8_t port, const uint8_t * data, int len);
+
+// Queues one byte that completes at when, or right after the bytes
+// already queued if they end later.
+void HAL_UartReceiveAt(uint8_t port, uint8_t c, uint64_t when);
+
+// Takes up to size bytes the port sent since the last call.
+int HAL_UartRead(uint8_t port, uint8_t * data, int size);
+
+// The same, with the time each byte started to shift out if when is not
+// NULL. The byte is on the line for HAL_UartByteTime cycles from then.
+int HAL_UartSent(uint8_t port, uint8_t * data, uint64_t * when, int size);
+
+// Runs the port at baud whatever the firmware asks for, 0 to follow the
+// firmware. Kept across HAL_Reset; call before the firmware sets it up.
+void HAL_UartBaud(uint8_t port, uint32_t baud);
+
+// Cycles per 10 bit frame at the rate the port was set up with.
+uint32_t HAL_UartByteTime(uint8_t port);
+
+// Called with the port each time the firmware writes an output latch,
+// with HAL_Now() at the time of the write. NULL to stop.
+void HAL_OnOutput(void (*hook)(GPIO_TypeDef * port));
+
+// Level an input pin sees when nothing drives it, 1 by default.
+void HAL_SetPin(GPIO_TypeDef * port, uint8_t pin, uint8_t level);
+
+// 10 bit reading of an ADC2 channel, ADC2_CHANNEL_8 or _9.
+void HAL_SetAdc(uint8_t channel, uint16_t value);
+
+// DS18B20 on the 1-wire pin: ROM code (the CRC byte is filled in),
+// whether it answers and the temperature it converts, in 1/16 C.
+void HAL_OneWireDevice(const uint8_t rom[8], uint8_t present);
+void HAL_OneWireTemperature(int16_t sixteenths);
+
+// 1-wire slots that the device could not make sense of, 0 on a clean run
+uint32_t HAL_OneWireErrors(void);
+
+#endif
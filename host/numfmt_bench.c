@@ -0,0 +1,162 @@
+// Checks numfmt.c against printf and times it against the digit loop
+// UART_SendNum and RS485_SendNum used before, in host cycles per value.
+// Cycle counts on the STM8 differ, the ratio is what to look at.
+//
+//   cc -O2 -I host -I . -o numfmt_bench host/numfmt_bench.c numfmt.c
+//   ./numfmt_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "numfmt.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES()	__rdtsc()
+#else
+static unsigned long long CYCLES(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static char out[64];
+static int out_len;
+
+static void Put(char c)
+{
+	out[out_len++] = c;
+}
+
+// the former UART_SendNum, int narrowed to 16 bit as on the STM8
+static void Old_SendNum(int16_t num)
+{
+	unsigned long tmp = 10000000;
+	if (num == 0)
+	{
+		Put('0');
+		return;
+	}
+	if (num < 0)
+	{
+		Put('-');
+		num = -num;
+	}
+	while (tmp > 0)
+	{
+		if (tmp <= (unsigned long)(long)num)
+		{
+			Put((num/tmp)%10 + '0');
+		}
+		tmp = tmp / 10;
+	}
+}
+
+static void Old_SendFloat(float num)
+{
+	int16_t __int = (int16_t) num;
+	Old_SendNum(__int);
+	Put('.');
+	__int = (int16_t)((num-__int)*100);
+	if (__int < 0)
+		__int = 0;
+	Old_SendNum(__int);
+}
+
+static int Check(const char * what, const char * want, const char * buf, int len)
+{
+	if ((int)strlen(want) == len && memcmp(want, buf, len) == 0)
+		return 0;
+	printf("FAIL %s: want \"%s\" got \"%.*s\"\n", what, want, len, buf);
+	return 1;
+}
+
+int main(void)
+{
+	char buf[NUMFMT_MAX], want[32];
+	long v, errors = 0, old_float_wrong = 0;
+	unsigned long long t0, t1, t2;
+	volatile uint8_t sink = 0;
+	int i;
+	
+	for (v = -32768; v <= 32767; v++)
+	{
+		sprintf(want, "%ld", v);
+		errors += Check("I16", want, buf, NumFmt_I16(buf, (int16_t)v));
+	}
+	for (i = 0; i < 200000; i++)
+	{
+		uint32_t u = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+		
+		u >>= rand() % 32;
+		sprintf(want, "%lu", (unsigned long)u);
+		errors += Check("U32", want, buf, NumFmt_U32(buf, u));
+	}
+	sprintf(want, "%lu", 4294967295UL);
+	errors += Check("U32", want, buf, NumFmt_U32(buf, 4294967295UL));
+	for (i = 0; i < 100000; i++)
+	{
+		// four decimals a third of a step off any rounding tie, small
+		// enough for float to tell
+		float f = ((rand() % 2000001) - 1000000) / 10000.0f + 0.00003f;
+		int d;
+		
+		for (d = 0; d <= 4; d++)
+		{
+			sprintf(want, "%.*f", d, f);
+			if (strcmp(want, "-0") == 0 || strncmp(want, "-0.", 3) == 0)
+				if (strspn(want + 1, "0.") == strlen(want + 1))
+					memmove(want, want + 1, strlen(want));
+			errors += Check("Fixed", want, buf, NumFmt_Fixed(buf, f, d));
+		}
+		sprintf(want, "%.2f", f);
+		out_len = 0;
+		if (f < 0)
+			continue;	// the old code cannot print these at all
+		Old_SendFloat(f);
+		if (out_len != (int)strlen(want) || memcmp(out, want, out_len) != 0)
+			old_float_wrong++;
+	}
+	for (i = 0; i < 256; i++)
+	{
+		char bin[9];
+		int b;
+		
+		for (b = 0; b < 8; b++)
+			bin[b] = (i & (0x80 >> b)) ? '1' : '0';
+		bin[8] = 0;
+		errors += Check("BIN", bin, buf, NumFmt_Byte(buf, (uint8_t)i, BIN));
+		sprintf(want, "%03o", i);
+		errors += Check("OCT", want, buf, NumFmt_Byte(buf, (uint8_t)i, OCT));
+		sprintf(want, "%02X", i);
+		errors += Check("HEX", want, buf, NumFmt_Byte(buf, (uint8_t)i, HEX));
+		sprintf(want, "%d", i);
+		errors += Check("DEC", want, buf, NumFmt_Byte(buf, (uint8_t)i, DEC));
+	}
+	if (errors)
+		return 1;
+	
+	t0 = CYCLES();
+	for (v = -32768; v <= 32767; v++)
+	{
+		out_len = 0;
+		Old_SendNum((int16_t)v);
+		sink ^= out[0];
+	}
+	t1 = CYCLES();
+	for (v = -32768; v <= 32767; v++)
+	{
+		sink ^= buf[NumFmt_I16(buf, (int16_t)v) - 1];
+	}
+	t2 = CYCLES();
+	
+	printf("all int16, 200000 uint32, 500000 fixed and 1024 byte conversions match printf\n");
+	printf("old SendFloat wrong on %ld of 100000 values (fraction zeros, sign)\n", old_float_wrong);
+	printf("int16: old %.1f, new %.1f cycles per value (%.1fx)\n",
+		   (t1 - t0) / 65536.0, (t2 - t1) / 65536.0, (double)(t1 - t0) / (t2 - t1));
+	printf("OK\n");
+	return sink == 0xFF ? 0 : 0;
+}
@@ -0,0 +1,238 @@
+// Host stand-in for the parts of the STM8S StdPeriph headers the
+// firmware modules use when they are built natively under host/. The
+// peripherals behind it are simulated by host/hal.c on a virtual clock
+// and the flash by host/eeprom_model.c.
+#ifndef __STM8S_H
+#define __STM8S_H
+
+#include <stdint.h>
+
+#define STM8S207
+#define __IO volatile
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+
+typedef enum {FALSE = 0, TRUE = !FALSE} bool;
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus, BitStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+
+/* Core */
+// Interrupts are delivered by the simulation whenever virtual time moves
+// with the interrupt mask clear, as between two instructions on the part.
+#define INTERRUPT
+#define INTERRUPT_HANDLER(a, b)		void a(void)
+#define INTERRUPT_HANDLER_TRAP(a)	void a(void)
+
+void rim(void);
+void sim(void);
+void wfi(void);
+void halt(void);
+void nop(void);
+// the profile.h regions charge the cycles host/hal.c models for them
+void HAL_ProfileEnter(uint8_t region);
+#define HAL_PROFILE_ENTER(region)	HAL_ProfileEnter(region)
+#define enableInterrupts()	rim()
+#define disableInterrupts()	sim()
+// the 1-wire delay loops count one nop per microsecond
+#define asm(x)				nop()
+
+/* GPIO */
+typedef struct
+{
+	__IO uint8_t ODR;
+	__IO uint8_t IDR;
+	__IO uint8_t DDR;
+	__IO uint8_t CR1;
+	__IO uint8_t CR2;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef hal_gpio[6];
+#define GPIOA	(&hal_gpio[0])
+#define GPIOB	(&hal_gpio[1])
+#define GPIOC	(&hal_gpio[2])
+#define GPIOD	(&hal_gpio[3])
+#define GPIOE	(&hal_gpio[4])
+#define GPIOF	(&hal_gpio[5])
+
+typedef enum
+{
+	GPIO_PIN_0 = 0x01, GPIO_PIN_1 = 0x02, GPIO_PIN_2 = 0x04, GPIO_PIN_3 = 0x08,
+	GPIO_PIN_4 = 0x10, GPIO_PIN_5 = 0x20, GPIO_PIN_6 = 0x40, GPIO_PIN_7 = 0x80
+} GPIO_Pin_TypeDef;
+typedef enum
+{
+	GPIO_MODE_IN_FL_NO_IT = 0x00, GPIO_MODE_IN_PU_NO_IT = 0x40,
+	GPIO_MODE_OUT_PP_LOW_FAST = 0xE0, GPIO_MODE_OUT_PP_HIGH_FAST = 0xF0
+} GPIO_Mode_TypeDef;
+
+void GPIO_Init(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef GPIO_Pin, GPIO_Mode_TypeDef GPIO_Mode);
+void GPIO_WriteHigh(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef PortPins);
+void GPIO_WriteLow(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef PortPins);
+void GPIO_WriteReverse(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef PortPins);
+BitStatus GPIO_ReadInputPin(GPIO_TypeDef * GPIOx, GPIO_Pin_TypeDef GPIO_Pin);
+
+/* CLK */
+typedef enum { CLK_PRESCALER_HSIDIV1 = 0x00 } CLK_Prescaler_TypeDef;
+typedef enum
+{
+	CLK_PERIPHERAL_I2C = 0x00, CLK_PERIPHERAL_SPI = 0x01, CLK_PERIPHERAL_UART1 = 0x02,
+	CLK_PERIPHERAL_UART3 = 0x03, CLK_PERIPHERAL_TIMER4 = 0x04, CLK_PERIPHERAL_TIMER2 = 0x05,
+	CLK_PERIPHERAL_TIMER3 = 0x06, CLK_PERIPHERAL_TIMER1 = 0x07, CLK_PERIPHERAL_AWU = 0x12,
+	CLK_PERIPHERAL_ADC = 0x13
+} CLK_Peripheral_TypeDef;
+
+void CLK_HSIPrescalerConfig(CLK_Prescaler_TypeDef HSIPrescaler);
+void CLK_PeripheralClockConfig(CLK_Peripheral_TypeDef CLK_Peripheral, FunctionalState NewState);
+
+/* TIM1 */
+typedef enum { TIM1_COUNTERMODE_UP = 0x00 } TIM1_CounterMode_TypeDef;
+typedef enum { TIM1_TRGOSOURCE_UPDATE = 0x20 } TIM1_TRGOSource_TypeDef;
+
+void TIM1_DeInit(void);
+void TIM1_TimeBaseInit(uint16_t TIM1_Prescaler, TIM1_CounterMode_TypeDef TIM1_CounterMode,
+					   uint16_t TIM1_Period, uint8_t TIM1_RepetitionCounter);
+void TIM1_SelectOutputTrigger(TIM1_TRGOSource_TypeDef TIM1_TRGOSource);
+void TIM1_Cmd(FunctionalState NewState);
+
+/* TIM2 */
+typedef enum { TIM2_PRESCALER_1 = 0x00, TIM2_PRESCALER_16 = 0x04 } TIM2_Prescaler_TypeDef;
+
+void TIM2_TimeBaseInit(TIM2_Prescaler_TypeDef TIM2_Prescaler, uint16_t TIM2_Period);
+void TIM2_Cmd(FunctionalState NewState);
+uint16_t TIM2_GetCounter(void);
+
+/* TIM3 */
+typedef enum { TIM3_PRESCALER_1 = 0x00, TIM3_PRESCALER_16 = 0x04 } TIM3_Prescaler_TypeDef;
+typedef enum { TIM3_FLAG_UPDATE = 0x0001 } TIM3_FLAG_TypeDef;
+typedef enum { TIM3_IT_UPDATE = 0x01 } TIM3_IT_TypeDef;
+
+void TIM3_TimeBaseInit(TIM3_Prescaler_TypeDef TIM3_Prescaler, uint16_t TIM3_Period);
+void TIM3_ClearFlag(TIM3_FLAG_TypeDef TIM3_FLAG);
+FlagStatus TIM3_GetFlagStatus(TIM3_FLAG_TypeDef TIM3_FLAG);
+void TIM3_ITConfig(TIM3_IT_TypeDef TIM3_IT, FunctionalState NewState);
+void TIM3_Cmd(FunctionalState NewState);
+uint16_t TIM3_GetCounter(void);
+void TIM3_ClearITPendingBit(TIM3_IT_TypeDef TIM3_IT);
+
+/* UART1 */
+typedef enum { UART1_WORDLENGTH_8D = 0x00 } UART1_WordLength_TypeDef;
+typedef enum { UART1_STOPBITS_1 = 0x00 } UART1_StopBits_TypeDef;
+typedef enum { UART1_PARITY_NO = 0x00 } UART1_Parity_TypeDef;
+typedef enum { UART1_SYNCMODE_CLOCK_DISABLE = 0x80 } UART1_SyncMode_TypeDef;
+typedef enum { UART1_MODE_TXRX_ENABLE = 0x0C } UART1_Mode_TypeDef;
+typedef enum
+{
+	UART1_IT_TXE = 0x0277, UART1_IT_TC = 0x0266, UART1_IT_RXNE = 0x0255, UART1_IT_RXNE_OR = 0x0205
+} UART1_IT_TypeDef;
+typedef enum
+{
+	UART1_FLAG_TXE = 0x0080, UART1_FLAG_TC = 0x0040, UART1_FLAG_RXNE = 0x0020, UART1_FLAG_OR = 0x0008
+} UART1_Flag_TypeDef;
+
+void UART1_DeInit(void);
+void UART1_Init(uint32_t BaudRate, UART1_WordLength_TypeDef WordLength, UART1_StopBits_TypeDef StopBits,
+				UART1_Parity_TypeDef Parity, UART1_SyncMode_TypeDef SyncMode, UART1_Mode_TypeDef Mode);
+void UART1_ITConfig(UART1_IT_TypeDef UART1_IT, FunctionalState NewState);
+uint8_t UART1_ReceiveData8(void);
+void UART1_SendData8(uint8_t Data);
+FlagStatus UART1_GetFlagStatus(UART1_Flag_TypeDef UART1_FLAG);
+void UART1_ClearITPendingBit(UART1_IT_TypeDef UART1_IT);
+
+/* UART3 */
+typedef enum { UART3_WORDLENGTH_8D = 0x00 } UART3_WordLength_TypeDef;
+typedef enum { UART3_STOPBITS_1 = 0x00 } UART3_StopBits_TypeDef;
+typedef enum { UART3_PARITY_NO = 0x00 } UART3_Parity_TypeDef;
+typedef enum { UART3_MODE_TXRX_ENABLE = 0x0C } UART3_Mode_TypeDef;
+typedef enum
+{
+	UART3_IT_TXE = 0x0277, UART3_IT_TC = 0x0266, UART3_IT_RXNE = 0x0255, UART3_IT_RXNE_OR = 0x0205
+} UART3_IT_TypeDef;
+typedef enum
+{
+	UART3_FLAG_TXE = 0x0080, UART3_FLAG_TC = 0x0040, UART3_FLAG_RXNE = 0x0020, UART3_FLAG_OR_ERROR = 0x0008
+} UART3_Flag_TypeDef;
+
+void UART3_DeInit(void);
+void UART3_Init(uint32_t BaudRate, UART3_WordLength_TypeDef WordLength, UART3_StopBits_TypeDef StopBits,
+				UART3_Parity_TypeDef Parity, UART3_Mode_TypeDef Mode);
+void UART3_ITConfig(UART3_IT_TypeDef UART3_IT, FunctionalState NewState);
+uint8_t UART3_ReceiveData8(void);
+void UART3_SendData8(uint8_t Data);
+FlagStatus UART3_GetFlagStatus(UART3_Flag_TypeDef UART3_FLAG);
+void UART3_ClearITPendingBit(UART3_IT_TypeDef UART3_IT);
+
+/* ADC2 */
+typedef struct
+{
+	__IO uint8_t CSR;
+	__IO uint8_t CR1;
+	__IO uint8_t CR2;
+	uint8_t RESERVED;
+	__IO uint8_t DRH;
+	__IO uint8_t DRL;
+} ADC2_TypeDef;
+
+extern ADC2_TypeDef hal_adc2;
+#define ADC2	(&hal_adc2)
+
+#define ADC2_CSR_EOC	((uint8_t)0x80)
+#define ADC2_CSR_EOCIE	((uint8_t)0x20)
+#define ADC2_CSR_CH		((uint8_t)0x0F)
+
+typedef enum { ADC2_CONVERSIONMODE_SINGLE = 0x00, ADC2_CONVERSIONMODE_CONTINUOUS = 0x01 } ADC2_ConvMode_TypeDef;
+typedef enum { ADC2_CHANNEL_8 = 0x08, ADC2_CHANNEL_9 = 0x09 } ADC2_Channel_TypeDef;
+typedef enum { ADC2_PRESSEL_FCPU_D2 = 0x00 } ADC2_PresSel_TypeDef;
+typedef enum { ADC2_EXTTRIG_TIM = 0x00, ADC2_EXTTRIG_GPIO = 0x01 } ADC2_ExtTrig_TypeDef;
+typedef enum { ADC2_ALIGN_LEFT = 0x00, ADC2_ALIGN_RIGHT = 0x08 } ADC2_Align_TypeDef;
+typedef enum { ADC2_SCHMITTTRIG_CHANNEL8 = 0x08, ADC2_SCHMITTTRIG_CHANNEL9 = 0x09 } ADC2_SchmittTrigg_TypeDef;
+
+void ADC2_DeInit(void);
+void ADC2_Init(ADC2_ConvMode_TypeDef ADC2_ConversionMode, ADC2_Channel_TypeDef ADC2_Channel,
+			   ADC2_PresSel_TypeDef ADC2_PrescalerSelection, ADC2_ExtTrig_TypeDef ADC2_ExtTrigger,
+			   FunctionalState ADC2_ExtTriggerState, ADC2_Align_TypeDef ADC2_Align,
+			   ADC2_SchmittTrigg_TypeDef ADC2_SchmittTriggerChannel, FunctionalState ADC2_SchmittTriggerState);
+void ADC2_SchmittTriggerConfig(ADC2_SchmittTrigg_TypeDef ADC2_SchmittTriggerChannel, FunctionalState NewState);
+void ADC2_ITConfig(FunctionalState NewState);
+uint16_t ADC2_GetConversionValue(void);
+
+/* FLASH */
+#define FLASH_DATA_START_PHYSICAL_ADDRESS	((uint32_t)0x004000)
+#define FLASH_DATA_END_PHYSICAL_ADDRESS		((uint32_t)0x0047FF)
+#define FLASH_PROG_START_PHYSICAL_ADDRESS	((uint32_t)0x008000)
+#define FLASH_PROG_END_PHYSICAL_ADDRESS		((uint32_t)0x017FFF)
+#define FLASH_BLOCK_SIZE					((uint8_t)128)
+#define FLASH_DATA_BLOCKS_NUMBER			((uint16_t)16)
+#define FLASH_PROG_BLOCKS_NUMBER			((uint16_t)512)
+
+typedef enum { FLASH_MEMTYPE_PROG = 0xFD, FLASH_MEMTYPE_DATA = 0xF7 } FLASH_MemType_TypeDef;
+typedef enum { FLASH_PROGRAMMODE_STANDARD = 0x00, FLASH_PROGRAMMODE_FAST = 0x10 } FLASH_ProgramMode_TypeDef;
+typedef enum { FLASH_PROGRAMTIME_STANDARD = 0x00, FLASH_PROGRAMTIME_TPROG = 0x01 } FLASH_ProgramTime_TypeDef;
+typedef enum
+{
+	FLASH_FLAG_HVOFF = 0x40, FLASH_FLAG_DUL = 0x08, FLASH_FLAG_EOP = 0x04,
+	FLASH_FLAG_PUL = 0x02, FLASH_FLAG_WR_PG_DIS = 0x01
+} FLASH_Flag_TypeDef;
+typedef enum
+{
+	FLASH_STATUS_END_HIGH_VOLTAGE = 0x40, FLASH_STATUS_SUCCESSFUL_OPERATION = 0x04,
+	FLASH_STATUS_TIMEOUT = 0x02, FLASH_STATUS_WRITE_PROTECTION_ERROR = 0x01
+} FLASH_Status_TypeDef;
+
+void FLASH_Unlock(FLASH_MemType_TypeDef MemType);
+void FLASH_Lock(FLASH_MemType_TypeDef MemType);
+void FLASH_SetProgrammingTime(FLASH_ProgramTime_TypeDef ProgTime);
+void FLASH_EraseBlock(uint16_t BlockNum, FLASH_MemType_TypeDef MemType);
+void FLASH_ProgramBlock(uint16_t BlockNum, FLASH_MemType_TypeDef MemType,
+						FLASH_ProgramMode_TypeDef ProgMode, uint8_t * Buffer);
+void FLASH_ProgramByte(uint32_t Address, uint8_t Data);
+void FLASH_ProgramWord(uint32_t Address, uint32_t Data);
+uint8_t FLASH_ReadByte(uint32_t Address);
+FlagStatus FLASH_GetFlagStatus(FLASH_Flag_TypeDef FLASH_FLAG);
+FLASH_Status_TypeDef FLASH_WaitForLastOperation(FLASH_MemType_TypeDef FLASH_MemType);
+
+#endif
@@ -0,0 +1,142 @@
+// Turns the debug UART stream back into text. Trace records become one
+// line each, with the time since boot; any other bytes, such as the DEBUG
+// build prints, pass through unchanged.
+//
+//   cc -I host -I . -o trace_decode host/trace_decode.c
+//   stty -F /dev/ttyUSB0 115200 raw && ./trace_decode < /dev/ttyUSB0
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "trace_events.h"
+
+#define TRACE_ROW(name, args, format)	{#name, args, format},
+
+static const struct
+{
+	const char * name;
+	int args;
+	const char * format;
+} trace_table[TRACE_COUNT] = { TRACE_EVENTS(TRACE_ROW) };
+
+static uint64_t time_us;
+static uint32_t last_us;
+static int started;
+
+// Returns the record length if buf holds a whole valid record, 0 if it
+// is not one and -1 if more bytes are needed to tell.
+static int Trace_Check(const uint8_t * buf, int n)
+{
+	int len, i;
+	uint8_t check = 0;
+	
+	if (buf[0] != TRACE_SYNC)
+		return 0;
+	if (n < 2)
+		return -1;
+	if (buf[1] >= TRACE_COUNT)
+		return 0;
+	len = TRACE_RECORD_SIZE(trace_table[buf[1]].args);
+	if (n < len)
+		return -1;
+	for (i = 1; i < len - 1; i++)
+		check ^= buf[i];
+	return check == buf[len - 1] ? len : 0;
+}
+
+static void Trace_Print(const uint8_t * rec)
+{
+	const char * f = trace_table[rec[1]].format;
+	uint32_t t = ((uint32_t)rec[2] << 24) | ((uint32_t)rec[3] << 16) | ((uint32_t)rec[4] << 8) | rec[5];
+	uint16_t arg[2];
+	int used = 0;
+	
+	arg[0] = (uint16_t)((rec[6] << 8) | rec[7]);
+	arg[1] = (uint16_t)((rec[8] << 8) | rec[9]);
+	
+	// Micros() wraps every 71 minutes, a reset starts over at 0
+	if (!started || t >= last_us)
+		time_us += started ? t - last_us : t;
+	else if (last_us - t > 0x80000000u)
+		time_us += t - last_us;
+	else
+		time_us = t;
+	last_us = t;
+	started = 1;
+	
+	printf("%12.6f  ", time_us / 1e6);
+	for (; *f; f++)
+	{
+		if (*f != '%' || f[1] == 0 || used >= trace_table[rec[1]].args)
+		{
+			putchar(*f);
+			continue;
+		}
+		f++;
+		switch (*f)
+		{
+		case 'd':
+			printf("%d", (int16_t)arg[used++]);
+			break;
+		case 'x':
+			printf("0x%02x", arg[used++]);
+			break;
+		case 'u':
+			printf("%u", arg[used++]);
+			break;
+		default:
+			putchar('%');
+			putchar(*f);
+			break;
+		}
+	}
+	putchar('\n');
+}
+
+int main(int argc, char * argv[])
+{
+	FILE * in = stdin;
+	uint8_t buf[4096];
+	int n = 0, eof = 0;
+	
+	if (argc > 1 && (in = fopen(argv[1], "rb")) == NULL)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	
+	while (!eof || n > 0)
+	{
+		int i = 0;
+		
+		if (!eof)
+		{
+			size_t got = fread(buf + n, 1, sizeof (buf) - n, in);
+			
+			if (got == 0)
+				eof = 1;
+			n += (int)got;
+		}
+		
+		while (i < n)
+		{
+			int len = Trace_Check(buf + i, n - i);
+			
+			if (len < 0 && !eof)
+				break;
+			if (len > 0)
+			{
+				Trace_Print(buf + i);
+				i += len;
+			}
+			else
+			{
+				putchar(buf[i++]);
+			}
+		}
+		memmove(buf, buf + i, n - i);
+		n -= i;
+		fflush(stdout);
+	}
+	return 0;
+}
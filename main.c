@@ -29,10 +29,21 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm8s.h"
 #include "flash.h"
+#include "config.h"
+#include "history.h"
+#include "trace.h"
+#include "profile.h"
+#include "health.h"
 #include "delay.h"
 #include "packet.h"
 #include "rs485.h"
 #include "gas_lighting.h"
+#include "calib.h"
+#include "stats.h"
+#include "sched.h"
+#include "temperature.h"
+#include "power.h"
+#include "event.h"
 #include "one_wire.h"
 #include "uart.h"
 
@@ -50,17 +61,279 @@
 typedef unsigned char byte;
 
 // 
-struct ThesisData mydata, * pdata;
+struct ThesisData mydata;
 struct flash_data flash_data;
 
 #if !DEBUG
-#define PACKET_BUFFER_SIZE 128
+#define PACKET_BUFFER_SIZE 255	// largest frame checksum_len covers
 char packet_buff[PACKET_BUFFER_SIZE];
 unsigned char packet_len;
 struct Packet * packet;	
-unsigned int tmp_time;
+uint8_t flash_dirty;
+
+/* Tasks ---------------------------------------------------------------------*/
+#define TASK_RS485		0
+#define TASK_ADC		1
+
+// the replies written in place over the frame must fit the buffer; a
+// typedef, PROFILE_COUNT is an enum the preprocessor cannot see
+typedef char packet_reply_fits[STATS_DATA_SIZE <= PACKET_BUFFER_SIZE - 5 &&
+							   POWER_DATA_SIZE <= PACKET_BUFFER_SIZE - 5 &&
+							   HEALTH_DATA_SIZE <= PACKET_BUFFER_SIZE - 5 &&
+							   PROFILE_DATA_SIZE + PROFILE_COUNT * PROFILE_REGION_SIZE <= PACKET_BUFFER_SIZE - 5 ? 1 : -1];
+
+// Checksums and sends the len data bytes at packet->data back on the bus.
+static void Packet_Reply(uint8_t len)
+{
+	if (len > PACKET_BUFFER_SIZE - 4)
+		return;
+	packet->data[len] = checksum_len((char *)packet, 3 + len);
+	RS485_SendData(packet_buff, 4 + len);
+}
+
+// Sends the len bytes at packet->data + 1 back as a block, the length
+// byte in front of them.
+static void Packet_ReplyBlock(uint8_t len)
+{
+	if (len > PACKET_BUFFER_SIZE - 5)
+		return;
+	packet->data_type = TYPE_BLOCK | BIG_ENDIAN_BYTE_ORDER;
+	packet->data[0] = len;
+	Packet_Reply(1 + len);
+}
+
+static void Packet_Handle(void)
+{
+	packet = (struct Packet *)packet_buff;
+	// the length byte of a block first
+	if (packet_len < 4 + getTypeLength(packet->data_type) || packet_len < 4 + getDataLength(packet_buff))
+	{
+		// not enough length
+		return;
+	}
+	if (packet->data[getDataLength(packet_buff)] != checksum((char *)packet))
+	{
+		Health_Count(HEALTH_BAD_CHECKSUM);
+		return;
+	}
+	if (packet->id != flash_data.id && !IS_BROADCAST_ID(packet->id))
+	{
+		Health_Count(HEALTH_NOT_ADDRESSED);
+		return;
+	}
+	
+	switch (packet->cmd)
+	{
+	case CMD_QUERY:
+		if (packet->id == flash_data.id)
+		{
+			LED_RUN_TOGGLE;
+			
+			packet->data_type = TYPE_FLOAT | BIG_ENDIAN_BYTE_ORDER;
+			Packet_Reply(putFloat(packet->data, mydata.temperature));
+			Power_CountPoll();
+		}
+		else if (IS_BROADCAST_ID(packet->id) && GPIO_ReadInputPin(RS485_SEL_PORT, RS485_SEL_PIN) == RESET)
+		{
+			// do the same above but check select pin is activited
+			
+			LED_RUN_TOGGLE;
+			
+			packet->id = flash_data.id;
+			packet->data_type = TYPE_FLOAT | BIG_ENDIAN_BYTE_ORDER;
+			Packet_Reply(putFloat(packet->data, mydata.temperature));
+			Power_CountPoll();
+		}
+		else
+		{
+			// not own id
+		}
+		break;
+	case CMD_QUERY_STATS:
+		if (packet->id == flash_data.id)
+		{
+			struct StatsData stats;
+			
+			LED_RUN_TOGGLE;
+			
+			// a new window length restarts the windows
+			if (IS_TYPE_BYTE(packet->data_type) && packet->data[0] && packet->data[0] != Stats_GetWindow())
+				Stats_SetWindow(packet->data[0]);
+			Stats_Fill(&stats);
+			Packet_ReplyBlock(putStatsData(packet->data + 1, &stats));
+		}
+		break;
+	case CMD_QUERY_POWER:
+		if (packet->id == flash_data.id)
+		{
+			struct PowerData power;
+			
+			Power_Fill(&power);
+			Packet_ReplyBlock(putPowerData(packet->data + 1, &power));
+		}
+		break;
+	case CMD_HISTORY:
+	case CMD_HISTORY_PACKED:
+		if (packet->id == flash_data.id && IS_TYPE_UINT32(packet->data_type))
+		{
+			uint32_t first = ((uint32_t)packet->data[0] << 24) | ((uint32_t)packet->data[1] << 16) |
+				((uint32_t)packet->data[2] << 8) | packet->data[3];
+			uint8_t len;
+			
+			if (packet->cmd == CMD_HISTORY_PACKED)
+				len = History_ReadPacked(first, packet->data + 1, PACKET_BUFFER_SIZE - 5);
+			else
+				len = History_Read(first, packet->data + 1);
+			Packet_ReplyBlock(len);
+		}
+		break;
+	case CMD_QUERY_PROFILE:
+		if (packet->id == flash_data.id)
+		{
+			Packet_ReplyBlock(Profile_Fill(packet->data + 1));
+		}
+		break;
+	case CMD_QUERY_HEALTH:
+	case CMD_RESET_HEALTH:
+		if (packet->id == flash_data.id)
+		{
+			struct HealthData health;
+			
+			Health_Fill(&health);
+			if (packet->cmd == CMD_RESET_HEALTH)
+				Health_Reset();
+			Packet_ReplyBlock(putHealthData(packet->data + 1, &health));
+		}
+		break;
+	case CMD_CONTROL:
+		// for setting id
+		break;
+	default:
+		break;
+	}
+}
+
+static void Task_RS485(void)
+{
+	struct event ev;
+	
+	while (Event_Get(&rs485_events, &ev) != EVT_NONE)
+	{
+		if (ev.type == EVT_RS485_FRAME)
+		{
+			packet_len = RS485_GetFrame(packet_buff, ev.arg, PACKET_BUFFER_SIZE);
+			if (packet_len)
+			{
+				Health_Count(HEALTH_FRAMES);
+				TRACE_EVENT(RS485_FRAME, packet_buff[1], packet_len);
+				PROFILE_ENTER(PACKET);
+				Packet_Handle();
+				PROFILE_EXIT(PACKET);
+			}
+		}
+		else if (ev.type == EVT_RS485_OVERRUN)
+		{
+			Health_Count(HEALTH_RX_OVERRUN);
+			TRACE_EVENT(RS485_OVERRUN, 0, 0);
+		}
+	}
+	// after the frames, which all started before the partial ones
+	while (Event_Get(&timer_events, &ev) != EVT_NONE)
+	{
+		if (ev.type == EVT_RS485_TIMEOUT)
+		{
+			Health_Count(HEALTH_RX_TIMEOUT);
+			TRACE_EVENT(RS485_TIMEOUT, ev.arg, 0);
+			RS485_Discard(ev.arg);
+		}
+	}
+}
+
+static void Task_ADC(void)
+{
+	struct event ev;
+	
+	while (Event_Get(&adc_events, &ev) != EVT_NONE)
+	{
+		PROFILE_ENTER(ADC);
+		Health_AdcSeen(ev.arg);
+		if (ev.arg == GAS_CHANNEL)
+		{
+			mydata.gas = GasLighting_GetGas();
+			Stats_Add(STATS_GAS, GasLighting_GetRaw(GAS_CHANNEL));
+		}
+		else
+		{
+			mydata.lighting = GasLighting_GetLighting();
+			Stats_Add(STATS_LIGHTING, GasLighting_GetRaw(LIGHTING_CHANNEL));
+		}
+		PROFILE_EXIT(ADC);
+	}
+}
+
+static void Task_OneWire(void)
+{
+	Temperature_Task();
+	if (Temperature_Ready())
+	{
+		mydata.temperature = Temperature_Get();
+		Stats_Add(STATS_TEMPERATURE, (int16_t)(mydata.temperature * 16));
+	}
+}
+
+static void Task_LED(void)
+{
+	LED_RUN_TOGGLE;
+}
+
+static void Task_History(void)
+{
+	if (History_Due())
+	{
+		PROFILE_ENTER(HISTORY);
+		History_Add((int16_t)(mydata.temperature * 16),
+					Calib_Convert(LIGHTING_CHANNEL, GasLighting_GetRaw(LIGHTING_CHANNEL)),
+					Calib_Convert(GAS_CHANNEL, GasLighting_GetRaw(GAS_CHANNEL)));
+		PROFILE_EXIT(HISTORY);
+	}
+}
+
+static void Task_EEPROM(void)
+{
+	if (flash_dirty)
+	{
+		flash_dirty = 0;
+		Config_Write(CONFIG_KEY_ID, &flash_data, sizeof (struct flash_data));
+	}
+}
+
+static void Task_Health(void)
+{
+	Health_AdcCheck();
+}
+
+#if PROFILE
+static void Task_Profile(void)
+{
+	Profile_Dump();
+}
 #endif
 
+// period and deadline in ms, period 0 tasks are released by events
+struct sched_task tasks[] =
+{
+	SCHED_TASK(Task_RS485,		0,		2),
+	SCHED_TASK(Task_ADC,		0,		10),
+	SCHED_TASK(Task_OneWire,	50,		50),
+	SCHED_TASK(Task_LED,		500,	100),
+	SCHED_TASK(Task_History,	1000,	1000),
+	SCHED_TASK(Task_EEPROM,		1000,	1000),
+	SCHED_TASK(Task_Health,		HEALTH_ADC_PERIOD,	100),
+#if PROFILE
+	SCHED_TASK(Task_Profile,	PROFILE_DUMP_PERIOD,	1000),
+#endif
+};
+#endif
 
 byte i;
 byte present = 0;
@@ -75,18 +348,39 @@ void main(void)
 	CLK_HSIPrescalerConfig(CLK_PRESCALER_HSIDIV1);
 	
 	GPIO_Init(LED_RUN_PORT, LED_RUN_PIN, GPIO_MODE_OUT_PP_HIGH_FAST);
+	Power_Init();
 	Delay_Init();
+	Profile_Init();
 	RS485_Init(115200);
 	UART_Init(115200);
 	GasLighting_Init();
 	OneWire_Init();
 	
-	flash_read_buffer((char *)&flash_data, sizeof (struct flash_data));
-	if (flash_data.id == BROADCAST_ID)
+	if (!Config_Init())
+	{
+		// nothing logged yet, carry over the id of the old block 0 layout
+		flash_read_buffer((char *)&flash_data, sizeof (struct flash_data));
+#if !DEBUG
+		flash_dirty = 1;
+#endif
+	}
+	else
+	{
+		Config_Read(CONFIG_KEY_ID, &flash_data, sizeof (struct flash_data));
+	}
+	if (flash_data.id == BROADCAST_ID || flash_data.id == 0)
 	{
 		// get default id
 		flash_data.id = DEV_MY_THESIS | 0x01;
 	}
+	Calib_Init();
+	Stats_Init();
+	TRACE_EVENT(BOOT, 0, 0);
+#if !DEBUG
+	Temperature_Init();
+	History_Init();
+	Sched_Init(tasks, sizeof (tasks) / sizeof (tasks[0]));
+#endif
 		
 	/* Infinite loop */
 	while (1)
@@ -202,74 +496,20 @@ void main(void)
 		LED_RUN_TOGGLE;
 		Delay(250);
 #else
-		if (Millis() - tmp_time > 500)
-		{
-			LED_RUN_TOGGLE;
-			tmp_time = Millis();
-			mydata.temperature = DS18B20.getTempC(insideThermometer);
-			DS18B20.requestTemperatures(); // for the next time
-			mydata.lighting = GasLighting_GetLighting();
-			mydata.gas = GasLighting_GetGas();
-		}
+		if (Event_Pending(&rs485_events) || Event_Pending(&timer_events))
+			Sched_Release(TASK_RS485);
+		if (Event_Pending(&adc_events))
+			Sched_Release(TASK_ADC);
 		
-		if (RS485_Available() >= 8)
+		if (!Sched_Run())
 		{
-			packet_len = RS485_GetData(packet_buff);
-			packet = (struct Packet *)packet_buff;
-			if (packet_len < 4 + getTypeLength(packet->data_type))
-			{
-				// not enough length
-			}
+			// WFI unmasks interrupts again, so an event posted after
+			// the check still wakes the core at once
+			sim();
+			if (Event_Pending(&rs485_events) || Event_Pending(&timer_events) || Event_Pending(&adc_events))
+				rim();
 			else
-			{
-				switch (packet->cmd)
-				{
-				case CMD_QUERY:
-					if (packet->id == flash_data.id)
-					{
-						LED_RUN_TOGGLE;
-						
-						packet->data_type = TYPE_FLOAT | BIG_ENDIAN_BYTE_ORDER;
-						pdata = (struct ThesisData *)packet->data;
-						pdata->temperature = mydata.temperature;
-						pdata->lighting = mydata.lighting;
-						pdata->gas = mydata.gas;
-						packet->data[getTypeLength(packet->data_type)] = checksum((char *)packet);
-						RS485_DIR_OUTPUT;
-						RS485_SendData(packet_buff, 4 + getTypeLength(packet->data_type));
-						RS485_DIR_INPUT;
-					}
-					else if (IS_BROADCAST_ID(packet->id) && GPIO_ReadInputPin(RS485_SEL_PORT, RS485_SEL_PIN) == RESET)
-					{
-						// do the same above but check select pin is activited
-						
-						LED_RUN_TOGGLE;
-						
-						packet->id = flash_data.id;
-						packet->data_type = TYPE_FLOAT | BIG_ENDIAN_BYTE_ORDER;
-						pdata = (struct ThesisData *)packet->data;
-						pdata->temperature = mydata.temperature;
-						pdata->lighting = mydata.lighting;
-						pdata->gas = mydata.gas;
-						packet->data[getTypeLength(packet->data_type)] = checksum((char *)packet);
-						RS485_DIR_OUTPUT;
-						RS485_SendData(packet_buff, 4 + getTypeLength(packet->data_type));
-						RS485_DIR_INPUT;
-					}
-					else
-					{
-						// not own id
-					}
-					break;
-				case CMD_CONTROL:
-					// for setting id
-					break;
-				default:
-					break;
-				}
-				
-				RS485_Flush();
-			}
+				Power_Idle();
 		}
 #endif
 	}
@@ -0,0 +1,148 @@
+#include "numfmt.h"
+
+static const uint16_t numfmt_pow10[5] = {1, 10, 100, 1000, 10000};
+
+// width digits of v, v < 10^width
+static uint8_t NumFmt_Digits(char * buf, uint16_t v, uint8_t width)
+{
+	uint8_t n = 0;
+	
+	while (--width)
+	{
+		uint16_t p = numfmt_pow10[width];
+		char d = '0';
+		
+		while (v >= p)
+		{
+			v -= p;
+			d++;
+		}
+		buf[n++] = d;
+	}
+	buf[n++] = '0' + (uint8_t)v;
+	return n;
+}
+
+// quotient of *v by d, below 2^bits, the remainder is left in *v
+static uint16_t NumFmt_DivMod(uint32_t * v, uint32_t d, uint8_t bits)
+{
+	uint16_t q = 0;
+	
+	while (bits--)
+	{
+		if (*v >= (d << bits))
+		{
+			*v -= d << bits;
+			q |= 1 << bits;
+		}
+	}
+	return q;
+}
+
+uint8_t NumFmt_U16(char * buf, uint16_t v)
+{
+	uint8_t width = 1;
+	
+	while (width < 5 && v >= numfmt_pow10[width])
+		width++;
+	return NumFmt_Digits(buf, v, width);
+}
+
+uint8_t NumFmt_I16(char * buf, int16_t v)
+{
+	if (v < 0)
+	{
+		buf[0] = '-';
+		// through unsigned, -32768 has no positive int16
+		return 1 + NumFmt_U16(buf + 1, (uint16_t)(0 - (uint16_t)v));
+	}
+	return NumFmt_U16(buf, (uint16_t)v);
+}
+
+uint8_t NumFmt_U32(char * buf, uint32_t v)
+{
+	uint16_t top, mid;
+	uint8_t n = 0;
+	
+	if (v <= 0xFFFF)
+		return NumFmt_U16(buf, (uint16_t)v);
+	
+	top = NumFmt_DivMod(&v, 100000000UL, 6);	// 0..42
+	mid = NumFmt_DivMod(&v, 10000, 14);		// 0..9999
+	if (top)
+	{
+		n = NumFmt_U16(buf, top);
+		n += NumFmt_Digits(buf + n, mid, 4);
+	}
+	else
+	{
+		n = NumFmt_U16(buf, mid);
+	}
+	return n + NumFmt_Digits(buf + n, (uint16_t)v, 4);
+}
+
+uint8_t NumFmt_Fixed(char * buf, float v, uint8_t decimals)
+{
+	uint8_t n = 0;
+	uint8_t negative = v < 0;
+	uint32_t ip;
+	uint16_t frac;
+	
+	if (decimals > 4)
+		decimals = 4;
+	if (negative)
+		v = -v;
+	if (v >= 4294967040.0f)
+		v = 4294967040.0f;
+	
+	// the fraction is exact once the integer part is off, round it alone
+	ip = (uint32_t)v;
+	frac = (uint16_t)((v - ip) * numfmt_pow10[decimals] + 0.5f);
+	if (frac >= numfmt_pow10[decimals])
+	{
+		frac -= numfmt_pow10[decimals];
+		ip++;
+	}
+	
+	// no sign on a value that rounds to zero
+	if (negative && (ip || frac))
+		buf[n++] = '-';
+	n += NumFmt_U32(buf + n, ip);
+	if (decimals)
+	{
+		buf[n++] = '.';
+		n += NumFmt_Digits(buf + n, frac, decimals);
+	}
+	return n;
+}
+
+uint8_t NumFmt_Byte(char * buf, uint8_t b, BYTE_FORMAT f)
+{
+	uint8_t i;
+	
+	switch (f)
+	{
+	case BIN:
+		for (i = 0; i < 8; i++)
+			buf[i] = (b & (0x80 >> i)) ? '1' : '0';
+		return 8;
+	case OCT:
+		buf[0] = '0' + (b >> 6);
+		buf[1] = '0' + ((b >> 3) & 7);
+		buf[2] = '0' + (b & 7);
+		return 3;
+	case HEX:
+		buf[0] = "0123456789ABCDEF"[b >> 4];
+		buf[1] = "0123456789ABCDEF"[b & 0x0F];
+		return 2;
+	case DEC:
+	default:
+		return NumFmt_U16(buf, b);
+	}
+}
+
+void NumFmt_Write(numfmt_put put, const char * buf, uint8_t len)
+{
+	while (len--)
+		put(*buf++);
+}
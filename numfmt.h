@@ -0,0 +1,33 @@
+#ifndef _numfmt_h_
+#define _numfmt_h_
+
+#include "stm8s.h"
+
+// Number to text for every serial port. Digits come from subtracting
+// powers of ten in 16 bit, 32 bit values are first split in base 10000
+// by shift and subtract, so no library division is called. The
+// functions write into buf without a terminator and return the length.
+
+#define BIN     0
+#define OCT     1
+#define DEC     2
+#define HEX     3
+typedef unsigned char BYTE_FORMAT;
+
+#define NUMFMT_MAX		16		// longest output, sign and 4 decimals included
+
+typedef void (*numfmt_put)(char c);
+
+uint8_t NumFmt_U16(char * buf, uint16_t v);
+uint8_t NumFmt_I16(char * buf, int16_t v);
+uint8_t NumFmt_U32(char * buf, uint32_t v);
+
+// Rounds to decimals (0..4) places, the fraction is zero padded.
+uint8_t NumFmt_Fixed(char * buf, float v, uint8_t decimals);
+
+// BIN is 8 digits, OCT 3, HEX 2, DEC as short as it gets.
+uint8_t NumFmt_Byte(char * buf, uint8_t b, BYTE_FORMAT f);
+
+void NumFmt_Write(numfmt_put put, const char * buf, uint8_t len);
+
+#endif
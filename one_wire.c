@@ -1,6 +1,7 @@
 
 #include "one_wire.h"
 #include "delay.h"
+#include "health.h"
 
 static inline void delayMicroseconds(unsigned int us)
 {	
@@ -47,7 +48,11 @@ uint8_t OneWire_reset(void)
 	enableInterrupts();
 	// wait until the wire is high... just in case
 	do {
-		if (--retries == 0) return 0;
+		if (--retries == 0)
+		{
+			Health_Count(HEALTH_ONEWIRE_PRESENCE);
+			return 0;
+		}
 		delayMicroseconds(2);
 	} while (DIRECT_READ() == 0);
 	
@@ -62,6 +67,8 @@ uint8_t OneWire_reset(void)
 	r = !DIRECT_READ();
 	enableInterrupts();
 	delayMicroseconds(420);
+	if (!r)
+		Health_Count(HEALTH_ONEWIRE_PRESENCE);
 	return r;
 }
 
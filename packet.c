@@ -35,20 +35,206 @@ int getTypeLength(unsigned char type)
 	case TYPE_DOUBLE:
 		return sizeof(double);
 		break;
+	case TYPE_BLOCK:
+		return 1; // the length byte, see getDataLength
+		break;
 	default:
 		return 0;
 		break;
 	}
 }
 
-unsigned char checksum(char * packet)
+// data bytes of the packet, the length byte of a block too
+int getDataLength(char * packet)
 {
-	unsigned char checksum, packet_len, i;
 	struct Packet * mypacket = (struct Packet *)packet;
-	packet_len = getTypeLength(mypacket->data_type) + 3;
+	if (IS_TYPE_BLOCK(mypacket->data_type))
+		return 1 + mypacket->data[0];
+	return getTypeLength(mypacket->data_type);
+}
+
+unsigned char checksum(char * packet)
+{
+	return checksum_len(packet, getDataLength(packet) + 3);
+}
+
+// two's complement of the byte sum of the first packet_len bytes
+unsigned char checksum_len(char * packet, unsigned char packet_len)
+{
+	unsigned char checksum = 0, i;
 	for (i = 0; i < packet_len; i++)
 		checksum += packet[i];
-	checksum = !checksum + 1;
+	checksum = ~checksum + 1;
 	return checksum;
 }
 
+
+/* big-endian data --------------------------------------------------------*/
+union float_bits
+{
+	float f;
+	uint32_t u;
+};
+
+uint8_t putUint16(uint8_t * p, uint16_t v)
+{
+	p[0] = (uint8_t)(v >> 8);
+	p[1] = (uint8_t)v;
+	return 2;
+}
+
+uint8_t putUint32(uint8_t * p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+	return 4;
+}
+
+uint8_t putFloat(uint8_t * p, float v)
+{
+	union float_bits b;
+	b.f = v;
+	return putUint32(p, b.u);
+}
+
+uint16_t getUint16(const uint8_t * p)
+{
+	return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+uint32_t getUint32(const uint8_t * p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+float getFloat(const uint8_t * p)
+{
+	union float_bits b;
+	b.u = getUint32(p);
+	return b.f;
+}
+
+static uint8_t putSensorStats(uint8_t * p, const struct SensorStats * s)
+{
+	putFloat(p, s->min);
+	putFloat(p + 4, s->max);
+	putFloat(p + 8, s->mean);
+	putFloat(p + 12, s->stddev);
+	return 16;
+}
+
+uint8_t putStatsData(uint8_t * p, const struct StatsData * data)
+{
+	putSensorStats(p, &data->temperature);
+	putSensorStats(p + 16, &data->lighting);
+	putSensorStats(p + 32, &data->gas);
+	return STATS_DATA_SIZE;
+}
+
+uint8_t putPowerData(uint8_t * p, const struct PowerData * data)
+{
+	putFloat(p, data->active);
+	putFloat(p + 4, data->idle);
+	putFloat(p + 8, data->polls);
+	putFloat(p + 12, data->energy);
+	putFloat(p + 16, data->energy_no_idle);
+	return POWER_DATA_SIZE;
+}
+
+uint8_t putHistoryRecord(uint8_t * p, const struct HistoryRecord * rec)
+{
+	putUint16(p, rec->time);
+	putUint16(p + 2, (uint16_t)rec->temperature);
+	putUint16(p + 4, rec->lighting);
+	putUint16(p + 6, rec->gas);
+	return HISTORY_RECORD_SIZE;
+}
+
+uint8_t putHistoryData(uint8_t * p, const struct HistoryData * data)
+{
+	putUint32(p, data->first);
+	putUint32(p + 4, data->next);
+	putUint16(p + 8, data->boot);
+	putUint32(p + 10, data->start);
+	p[14] = data->count;
+	return HISTORY_DATA_SIZE;
+}
+
+uint8_t putHistoryPacked(uint8_t * p, const struct HistoryPacked * data)
+{
+	putUint32(p, data->first);
+	putUint32(p + 4, data->next);
+	putUint16(p + 8, data->boot);
+	putUint32(p + 10, data->start);
+	putUint16(p + 14, data->period);
+	p[16] = data->count;
+	return HISTORY_PACKED_SIZE;
+}
+
+uint8_t putProfileRegion(uint8_t * p, const struct ProfileRegion * r)
+{
+	putUint16(p, r->min);
+	putUint16(p + 2, r->max);
+	putUint16(p + 4, r->mean);
+	putUint32(p + 6, r->count);
+	return PROFILE_REGION_SIZE;
+}
+
+uint8_t putProfileData(uint8_t * p, const struct ProfileData * data)
+{
+	p[0] = data->prescaler;
+	p[1] = data->count;
+	return PROFILE_DATA_SIZE;
+}
+
+uint8_t putHealthData(uint8_t * p, const struct HealthData * data)
+{
+	uint8_t i;
+	
+	putUint32(p, data->uptime);
+	putUint32(p + 4, data->since_reset);
+	putUint16(p + 8, data->boot);
+	for (i = 0; i < 8; i++)
+		putUint16(p + 10 + 2 * i, data->counters[i]);
+	putUint16(p + 26, data->uart_tx_dropped);
+	putUint16(p + 28, data->trace_dropped);
+	p[30] = data->events_dropped;
+	p[31] = data->rs485_rx_high;
+	p[32] = data->uart_tx_high;
+	p[33] = data->event_high;
+	return HEALTH_DATA_SIZE;
+}
+
+static void getSensorStats(const uint8_t * p, struct SensorStats * s)
+{
+	s->min = getFloat(p);
+	s->max = getFloat(p + 4);
+	s->mean = getFloat(p + 8);
+	s->stddev = getFloat(p + 12);
+}
+
+void getStatsData(const uint8_t * p, struct StatsData * data)
+{
+	getSensorStats(p, &data->temperature);
+	getSensorStats(p + 16, &data->lighting);
+	getSensorStats(p + 32, &data->gas);
+}
+
+void getHealthData(const uint8_t * p, struct HealthData * data)
+{
+	uint8_t i;
+	
+	data->uptime = getUint32(p);
+	data->since_reset = getUint32(p + 4);
+	data->boot = getUint16(p + 8);
+	for (i = 0; i < 8; i++)
+		data->counters[i] = getUint16(p + 10 + 2 * i);
+	data->uart_tx_dropped = getUint16(p + 26);
+	data->trace_dropped = getUint16(p + 28);
+	data->events_dropped = p[30];
+	data->rs485_rx_high = p[31];
+	data->uart_tx_high = p[32];
+	data->event_high = p[33];
+}
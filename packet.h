@@ -1,6 +1,12 @@
 #ifndef _packet_h_
 #define _packet_h_
 
+#ifdef __ICCSTM8__
+#include "stm8s.h"	// the StdPeriph integer types, which clash with stdint.h
+#else
+#include <stdint.h>
+#endif
+
 /* data type */
 #define TYPE_BYTE		0x01
 #define TYPE_INT8		0x02
@@ -12,6 +18,7 @@
 #define TYPE_UINT64		0x08
 #define TYPE_FLOAT		0x09
 #define TYPE_DOUBLE		0x0A
+#define TYPE_BLOCK		0x0B	// data[0] is the number of data bytes after it
 
 #define IS_TYPE_BYTE(x) 	((x & 0x0f) == TYPE_BYTE)
 #define IS_TYPE_INT8(x) 	((x & 0x0f) == TYPE_INT8)
@@ -23,6 +30,7 @@
 #define IS_TYPE_UINT64(x) 	((x & 0x0f) == TYPE_UINT64)
 #define IS_TYPE_FLOAT(x) 	((x & 0x0f) == TYPE_FLOAT)
 #define IS_TYPE_DOUBLE(x) 	((x & 0x0f) == TYPE_DOUBLE)
+#define IS_TYPE_BLOCK(x) 	((x & 0x0f) == TYPE_BLOCK)
 /* data type */
 
 /* byte order */
@@ -65,6 +73,15 @@
 /* command */
 #define CMD_CONTROL		0x01
 #define CMD_QUERY		0x02
+#define CMD_QUERY_STATS	0x03	// request data is a byte, 0 or the window length in
+								// samples to change to, reply is a block of struct StatsData
+#define CMD_QUERY_POWER	0x04	// reply is a block of struct PowerData
+#define CMD_HISTORY		0x05	// request data is the uint32 record index to
+								// resume from, reply is a block of struct HistoryData
+#define CMD_HISTORY_PACKED	0x06	// as CMD_HISTORY, reply is a block of struct HistoryPacked
+#define CMD_QUERY_PROFILE	0x07	// reply is a block of struct ProfileData
+#define CMD_QUERY_HEALTH	0x08	// reply is a block of struct HealthData
+#define CMD_RESET_HEALTH	0x09	// as CMD_QUERY_HEALTH, then zeroes the counters
 /* command */
 
 #define BROADCAST_ID	0xff
@@ -78,6 +95,11 @@ struct Packet
 	unsigned char data[]; // checksum number on the data byte number data_type
 };
 
+// Reply data is sent field by field, most significant byte first, floats
+// as their IEEE 754 bits, whatever the byte order of the machine: the
+// put functions below write a struct as sent, the get ones read it back.
+// The _SIZE defines are the bytes on the wire, not sizeof.
+
 struct ThesisData
 {
 	float temperature;
@@ -86,8 +108,133 @@ struct ThesisData
 };
 
 
+struct SensorStats
+{
+	float min;
+	float max;
+	float mean;
+	float stddev;
+};
+
+#define STATS_DATA_SIZE		48
+struct StatsData
+{
+	struct SensorStats temperature;
+	struct SensorStats lighting;
+	struct SensorStats gas;
+};
+
+#define POWER_DATA_SIZE		20
+struct PowerData
+{
+	float active;			// s
+	float idle;				// s in WFI
+	float polls;
+	float energy;			// uJ per poll
+	float energy_no_idle;	// uJ per poll if the core never slept
+};
+
+// one logged sample, time in s after the start of its block
+#define HISTORY_RECORD_SIZE	8
+struct HistoryRecord
+{
+	uint16_t time;
+	int16_t temperature;	// 1/16 Celsius
+	uint16_t lighting;		// 0.1 lux
+	uint16_t gas;			// 0.01 kppm
+};
+
+// Records are sent a flash block at a time. Ask again from next until
+// count comes back 0; first is past the index asked for when older
+// records were overwritten.
+#define HISTORY_DATA_SIZE	15		// records after
+struct HistoryData
+{
+	uint32_t first;			// index of records[0]
+	uint32_t next;			// index to resume from
+	uint16_t boot;			// boot count when the block was recorded
+	uint32_t start;			// s from that boot to the start of the block
+	uint8_t count;
+	struct HistoryRecord records[];
+};
+
+// The same records packed by codec.c in groups of CODEC_GROUP rows, the
+// last one shorter, rows of four channels: time, then temperature,
+// lighting and gas as in HistoryRecord. Record k was taken at
+// start + k * period + the time channel, all in s from boot.
+#define HISTORY_PACKED_SIZE	17		// bits after
+struct HistoryPacked
+{
+	uint32_t first;
+	uint32_t next;
+	uint16_t boot;
+	uint32_t start;
+	uint16_t period;
+	uint8_t count;
+	uint8_t bits[];
+};
+
+// Run times of the profile.h regions in TIM2 ticks of 2^prescaler
+// cycles. count is 0 when the firmware was built without PROFILE.
+#define PROFILE_REGION_SIZE	10
+struct ProfileRegion
+{
+	uint16_t min;
+	uint16_t max;
+	uint16_t mean;
+	uint32_t count;
+};
+
+#define PROFILE_DATA_SIZE	2		// regions after
+struct ProfileData
+{
+	uint8_t prescaler;
+	uint8_t count;
+	struct ProfileRegion regions[];
+};
+
+// Fault counters since the last CMD_RESET_HEALTH, counters[] indexed by
+// the HEALTH_ defines in health.h. The high-water marks are the most
+// bytes or events waiting at once.
+#define HEALTH_DATA_SIZE	34
+struct HealthData
+{
+	uint32_t uptime;			// s since boot
+	uint32_t since_reset;		// s since the counters were zeroed
+	uint16_t boot;				// boot count
+	uint16_t counters[8];
+	uint16_t uart_tx_dropped;	// debug UART bytes lost to a full ring
+	uint16_t trace_dropped;		// trace records lost
+	uint8_t events_dropped;		// ISR events lost on full queues, mod 256
+	uint8_t rs485_rx_high;		// of 63
+	uint8_t uart_tx_high;		// of 127
+	uint8_t event_high;			// of 7, deepest event queue
+};
+
 int getTypeLength(unsigned char type);
+int getDataLength(char * packet);
 unsigned char checksum(char * packet);
+unsigned char checksum_len(char * packet, unsigned char packet_len);
+
+// Each put writes at p and returns the bytes written, each get reads
+// from p.
+uint8_t putUint16(uint8_t * p, uint16_t v);
+uint8_t putUint32(uint8_t * p, uint32_t v);
+uint8_t putFloat(uint8_t * p, float v);
+uint16_t getUint16(const uint8_t * p);
+uint32_t getUint32(const uint8_t * p);
+float getFloat(const uint8_t * p);
+
+uint8_t putStatsData(uint8_t * p, const struct StatsData * data);
+uint8_t putPowerData(uint8_t * p, const struct PowerData * data);
+uint8_t putHistoryRecord(uint8_t * p, const struct HistoryRecord * rec);
+uint8_t putHistoryData(uint8_t * p, const struct HistoryData * data);
+uint8_t putHistoryPacked(uint8_t * p, const struct HistoryPacked * data);
+uint8_t putProfileRegion(uint8_t * p, const struct ProfileRegion * r);
+uint8_t putProfileData(uint8_t * p, const struct ProfileData * data);
+uint8_t putHealthData(uint8_t * p, const struct HealthData * data);
+void getStatsData(const uint8_t * p, struct StatsData * data);
+void getHealthData(const uint8_t * p, struct HealthData * data);
 
 
 #endif
@@ -0,0 +1,50 @@
+#include "power.h"
+#include "delay.h"
+
+uint32_t power_idle_s;
+uint32_t power_idle_us;
+uint32_t power_polls;
+
+void Power_Init(void)
+{
+	CLK_PeripheralClockConfig(CLK_PERIPHERAL_I2C, DISABLE);
+	CLK_PeripheralClockConfig(CLK_PERIPHERAL_SPI, DISABLE);
+	CLK_PeripheralClockConfig(CLK_PERIPHERAL_TIMER2, DISABLE);	// back on with PROFILE
+	CLK_PeripheralClockConfig(CLK_PERIPHERAL_TIMER4, DISABLE);
+	CLK_PeripheralClockConfig(CLK_PERIPHERAL_AWU, DISABLE);
+}
+
+void Power_Idle(void)
+{
+	uint32_t start = Micros();
+	
+	wfi();
+	
+	power_idle_us += Micros() - start;
+	if (power_idle_us >= 1000000)
+	{
+		power_idle_us -= 1000000;
+		power_idle_s++;
+	}
+}
+
+void Power_CountPoll(void)
+{
+	power_polls++;
+}
+
+void Power_Fill(struct PowerData * data)
+{
+	float uptime = Millis() * 0.001;
+	float idle = power_idle_s + power_idle_us * 0.000001;
+	float active = uptime - idle;
+	float polls = power_polls ? power_polls : 1;
+	
+	if (active < 0) active = 0;
+	data->active = active;
+	data->idle = idle;
+	data->polls = power_polls;
+	// uW * s = uJ
+	data->energy = (active * POWER_RUN_UA + idle * POWER_WFI_UA) * (POWER_SUPPLY_MV * 0.001) / polls;
+	data->energy_no_idle = uptime * POWER_RUN_UA * (POWER_SUPPLY_MV * 0.001) / polls;
+}
@@ -0,0 +1,32 @@
+#ifndef _power_h_
+#define _power_h_
+
+#include "stm8s.h"
+#include "packet.h"
+
+// Supply and typical STM8S207 currents at 16 MHz HSI, used to estimate
+// the energy spent per poll.
+#ifndef POWER_SUPPLY_MV
+#define POWER_SUPPLY_MV		5000
+#endif
+#ifndef POWER_RUN_UA
+#define POWER_RUN_UA		7400
+#endif
+#ifndef POWER_WFI_UA
+#define POWER_WFI_UA		1600
+#endif
+
+// Gates the clock of peripherals the node does not use.
+void Power_Init(void);
+
+// Sleeps in WFI until the next interrupt. The TIM3 tick bounds the
+// wake up latency to 1 ms and a RS485 byte wakes the core at once.
+// May be called with interrupts masked, WFI unmasks them.
+void Power_Idle(void);
+
+// Counts one answered poll.
+void Power_CountPoll(void);
+
+void Power_Fill(struct PowerData * data);
+
+#endif
@@ -0,0 +1,147 @@
+#include "profile.h"
+#include "numfmt.h"
+#include "uart.h"
+
+#if PROFILE
+
+struct profile_stat
+{
+	uint16_t min;
+	uint16_t max;
+	uint32_t sum;		// of the last n runs
+	uint16_t n;
+	uint32_t count;
+};
+
+#define PROFILE_LABEL(name, label)	label,
+
+static const char * const profile_label[PROFILE_COUNT] = { PROFILE_REGIONS(PROFILE_LABEL) };
+
+uint16_t profile_start[PROFILE_COUNT];
+struct profile_stat profile_stat[PROFILE_COUNT];
+uint16_t profile_overhead;
+
+void Profile_Init(void)
+{
+	uint8_t i;
+	uint16_t t;
+	
+	CLK_PeripheralClockConfig(CLK_PERIPHERAL_TIMER2, ENABLE);
+	TIM2_TimeBaseInit((TIM2_Prescaler_TypeDef)PROFILE_PRESCALER, 0xFFFF);
+	TIM2_Cmd(ENABLE);
+	
+	for (i = 0; i < PROFILE_COUNT; i++)
+	{
+		profile_stat[i].min = 0xFFFF;
+		profile_stat[i].max = 0;
+		profile_stat[i].sum = 0;
+		profile_stat[i].n = 0;
+		profile_stat[i].count = 0;
+	}
+	
+	// an empty region, taken off every run
+	profile_overhead = 0;
+	t = TIM2_GetCounter();
+	profile_overhead = TIM2_GetCounter() - t;
+}
+
+void Profile_Exit(uint8_t region, uint16_t now)
+{
+	struct profile_stat * s = &profile_stat[region];
+	uint16_t t = now - profile_start[region];
+	
+	t = t > profile_overhead ? t - profile_overhead : 0;
+	if (t < s->min)
+		s->min = t;
+	if (t > s->max)
+		s->max = t;
+	// keep the mean over the later half once the sum would overflow
+	if (s->sum + t < s->sum || s->n == 0xFFFF)
+	{
+		s->sum >>= 1;
+		s->n >>= 1;
+	}
+	s->sum += t;
+	s->n++;
+	s->count++;
+}
+
+static void Profile_Region(uint8_t i, struct ProfileRegion * r)
+{
+	struct profile_stat * s = &profile_stat[i];
+	
+	r->min = s->count ? s->min : 0;
+	r->max = s->max;
+	r->mean = s->n ? (uint16_t)(s->sum / s->n) : 0;
+	r->count = s->count;
+}
+
+uint8_t Profile_Fill(uint8_t * out)
+{
+	struct ProfileData data;
+	struct ProfileRegion r;
+	uint8_t i, len;
+	
+	data.prescaler = PROFILE_PRESCALER;
+	data.count = PROFILE_COUNT;
+	len = putProfileData(out, &data);
+	for (i = 0; i < PROFILE_COUNT; i++)
+	{
+		Profile_Region(i, &r);
+		len += putProfileRegion(out + len, &r);
+	}
+	return len;
+}
+
+static void Profile_SendU32(char * label, uint32_t v)
+{
+	char buf[NUMFMT_MAX];
+	
+	UART_SendStr(label);
+	UART_SendData(buf, NumFmt_U32(buf, v));
+}
+
+void Profile_Dump(void)
+{
+	struct ProfileRegion r;
+	uint8_t i;
+	
+	for (i = 0; i < PROFILE_COUNT; i++)
+	{
+		Profile_Region(i, &r);
+		UART_SendStr("profile ");
+		UART_SendStr((char *)profile_label[i]);
+		Profile_SendU32(" n=", r.count);
+		Profile_SendU32(" min=", r.min);
+		Profile_SendU32(" max=", r.max);
+		Profile_SendU32(" mean=", r.mean);
+		UART_SendStr(" ticks\n");
+	}
+}
+
+#else
+
+void Profile_Init(void)
+{
+}
+
+void Profile_Exit(uint8_t region, uint16_t now)
+{
+	(void)region;
+	(void)now;
+}
+
+uint8_t Profile_Fill(uint8_t * out)
+{
+	struct ProfileData data;
+	
+	data.prescaler = PROFILE_PRESCALER;
+	data.count = 0;
+	return putProfileData(out, &data);
+}
+
+void Profile_Dump(void)
+{
+}
+
+#endif
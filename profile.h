@@ -0,0 +1,69 @@
+#ifndef _profile_h_
+#define _profile_h_
+
+#include "stm8s.h"
+#include "packet.h"
+
+// Enter/exit probes timed on free running TIM2 ticks, min, max, mean and
+// count per region. Main loop context only: the TIM2 counter latch is
+// shared, an ISR reading it would corrupt the read it interrupted.
+// With PROFILE 0 the probes expand to nothing and TIM2 stays gated.
+#ifndef PROFILE
+#define PROFILE		0
+#endif
+
+// TIM2 prescaler as a power of two, a tick is 2^PROFILE_PRESCALER
+// cycles. 4 gives 1 us ticks at 16 MHz; regions longer than 65535
+// ticks alias.
+#ifndef PROFILE_PRESCALER
+#define PROFILE_PRESCALER	4
+#endif
+
+// ms between dumps on the debug UART
+#ifndef PROFILE_DUMP_PERIOD
+#define PROFILE_DUMP_PERIOD	10000
+#endif
+
+// X(name, label), the label is only printed by Profile_Dump. Regions
+// are numbered in this order in the query reply.
+#define PROFILE_REGIONS(X) \
+	X(PACKET,			"packet") \
+	X(ADC,				"adc") \
+	X(ONEWIRE_SEARCH,	"1-wire search") \
+	X(ONEWIRE_READ,		"1-wire read") \
+	X(HISTORY,			"history")
+
+#define PROFILE_ENUM(name, label)	PROFILE_##name,
+
+enum profile_region
+{
+	PROFILE_REGIONS(PROFILE_ENUM)
+	PROFILE_COUNT
+};
+
+#if PROFILE
+extern uint16_t profile_start[PROFILE_COUNT];
+#define PROFILE_ENTER(name)	(profile_start[PROFILE_##name] = TIM2_GetCounter())
+#define PROFILE_EXIT(name)	Profile_Exit(PROFILE_##name, TIM2_GetCounter())
+#elif defined(HAL_PROFILE_ENTER)
+// host build: the region's modelled run time goes on the virtual clock
+#define PROFILE_ENTER(name)	HAL_PROFILE_ENTER(PROFILE_##name)
+#define PROFILE_EXIT(name)	((void)0)
+#else
+#define PROFILE_ENTER(name)	((void)0)
+#define PROFILE_EXIT(name)	((void)0)
+#endif
+
+// Clocks and starts TIM2 and clears the regions, after Power_Init.
+void Profile_Init(void);
+
+void Profile_Exit(uint8_t region, uint16_t now);
+
+// Writes the struct ProfileData query reply at out, returns its length.
+// No regions without PROFILE.
+uint8_t Profile_Fill(uint8_t * out);
+
+// One text line per region on the debug UART.
+void Profile_Dump(void);
+
+#endif
@@ -1,14 +1,40 @@
 #include "rs485.h"
+#include "trace.h"
+
+#define RS485_BUFF_SIZE 64	// power of 2
+#define RS485_NEXT(i) ((uint8_t)(((i) + 1) & (RS485_BUFF_SIZE - 1)))
+#define RS485_DIST(from, to) ((uint8_t)(((to) - (from)) & (RS485_BUFF_SIZE - 1)))
+
+// ms of bus silence that aborts a partial frame
+#define RS485_FRAME_TIMEOUT 3
+// longest frame kept, longer blocks are replies of other nodes and are
+// skipped without going through the ring
+#define RS485_FRAME_MAX 32
 
-#define RS485_BUFF_SIZE 50
 __IO unsigned char rs485_rx_buff[RS485_BUFF_SIZE];
-__IO unsigned char rs485_rx_len; 
+__IO uint8_t rs485_rx_head;	// written by the RX ISR only
+__IO uint8_t rs485_rx_tail;	// written by the main loop only
+
+// frame parser, shared by the UART1 RX and TIM3 ISRs only
+uint8_t rs485_frame_start;
+uint8_t rs485_frame_len;
+uint8_t rs485_frame_expected;	// 0 until the length byte of a block
+uint16_t rs485_frame_skip;		// bytes left of a skipped block
+uint8_t rs485_idle_ms;
+__IO uint8_t rs485_rx_high;	// most bytes waiting at once
+
+// reply being sent by the TX ISR
+#define RS485_TX_SIZE 255
+unsigned char rs485_tx_buff[RS485_TX_SIZE];
+__IO uint8_t rs485_tx_len;	// 0 once the bus is turned back to input
+__IO uint8_t rs485_tx_pos;	// written by the TX ISR only
 
 void RS485_Init(unsigned long baudrate)
 {
   GPIO_Init(RS485_SEL_PORT, RS485_SEL_PIN, GPIO_MODE_IN_FL_NO_IT);
   GPIO_Init(RS485_DIR_PORT, RS485_DIR_PIN, GPIO_MODE_OUT_PP_HIGH_FAST);
   RS485_DIR_INPUT;
+  rs485_tx_len = 0;
   
   /* Deinitializes the UART1 peripheral */
   UART1_DeInit();
@@ -29,46 +55,180 @@ void RS485_Init(unsigned long baudrate)
 INTERRUPT_HANDLER(UART1_RX_IRQHandler, 18)
 {
   /* Read one byte from the receive data register */
-  rs485_rx_buff[rs485_rx_len++] = UART1_ReceiveData8();
+  unsigned char c = UART1_ReceiveData8();
+  uint8_t head = rs485_rx_head;
   
-  if (rs485_rx_len >= RS485_BUFF_SIZE)
+  rs485_idle_ms = 0;
+  if (rs485_frame_skip)
+  {
+    rs485_frame_skip--;
+  }
+  else if (RS485_NEXT(head) == rs485_rx_tail)
   {
-    rs485_rx_len = 0;
+    /* ring full, drop the byte and the frame it belongs to */
+    rs485_frame_len = 0;
+    Event_Post(&rs485_events, EVT_RS485_OVERRUN, head);
+  }
+  else
+  {
+    rs485_rx_buff[head] = c;
+    rs485_rx_head = RS485_NEXT(head);
+    if (RS485_DIST(rs485_rx_tail, rs485_rx_head) > rs485_rx_high)
+      rs485_rx_high = RS485_DIST(rs485_rx_tail, rs485_rx_head);
+    
+    /* the data type byte gives the frame length */
+    if (rs485_frame_len == 0)
+      rs485_frame_start = head;
+    rs485_frame_len++;
+    if (rs485_frame_len == 3)
+    {
+      rs485_frame_expected = IS_TYPE_BLOCK(c) ? 0 : 4 + getTypeLength(c);
+    }
+    else if (rs485_frame_len == 4 && rs485_frame_expected == 0)
+    {
+      /* the length byte of a block */
+      if (5 + c > RS485_FRAME_MAX)
+      {
+        rs485_rx_head = rs485_frame_start;
+        rs485_frame_len = 0;
+        rs485_frame_skip = c + 1;
+      }
+      else
+        rs485_frame_expected = 5 + c;
+    }
+    else if (rs485_frame_len > 3 && rs485_frame_len == rs485_frame_expected)
+    {
+      rs485_frame_len = 0;
+      Event_Post(&rs485_events, EVT_RS485_FRAME, rs485_frame_start);
+    }
   }
   UART1_ClearITPendingBit(UART1_IT_RXNE);
 }
+
+INTERRUPT_HANDLER(UART1_TX_IRQHandler, 17)
+{
+  uint8_t pos = rs485_tx_pos;
+  
+  if (pos < rs485_tx_len)
+  {
+    if (pos + 1 == rs485_tx_len)
+    {
+      /* reading SR before the last write clears TC, which then marks
+         the end of its stop bit */
+      UART1_GetFlagStatus(UART1_FLAG_TC);
+      UART1_ITConfig(UART1_IT_TXE, DISABLE);
+      UART1_ITConfig(UART1_IT_TC, ENABLE);
+    }
+    UART1_SendData8(rs485_tx_buff[pos]);
+    rs485_tx_pos = pos + 1;
+  }
+  else
+  {
+    /* the last byte is out, turn the bus around; no RS485_DIR_INPUT
+       here, its delay unmasks interrupts */
+    UART1_ITConfig(UART1_IT_TC, DISABLE);
+    GPIO_WriteLow(RS485_DIR_PORT, RS485_DIR_PIN);
+    rs485_tx_len = 0;
+  }
+}
+
+/* called from the TIM3 1 ms tick */
+void RS485_Tick(void)
+{
+  if ((rs485_frame_len || rs485_frame_skip) && ++rs485_idle_ms >= RS485_FRAME_TIMEOUT)
+  {
+    rs485_frame_len = 0;
+    rs485_frame_skip = 0;
+    Event_Post(&timer_events, EVT_RS485_TIMEOUT, rs485_rx_head);
+  }
+}
+
 int RS485_Available(void)
 {
-  return rs485_rx_len;
+  return RS485_DIST(rs485_rx_tail, rs485_rx_head);
 }
+
 int RS485_GetData(char * buffer)
 {
-//  memcpy((void *)buffer, (void const *)rs485_rx_buff, len);
-//  memset((void *)rs485_rx_buff, 0, RS485_BUFF_SIZE);
-  int i;
-  disableInterrupts();
-  for (i = 0; i < rs485_rx_len; i++)
+  uint8_t tail = rs485_rx_tail;
+  uint8_t head = rs485_rx_head;
+  int i = 0;
+  
+  while (tail != head)
   {
-    buffer[i] = rs485_rx_buff[i];
+    buffer[i++] = rs485_rx_buff[tail];
+    tail = RS485_NEXT(tail);
   }
-	enableInterrupts();
+  rs485_rx_tail = tail;
   return i;
 }
 
-int RS485_SendData(char * buffer, int len)
+int RS485_GetFrame(char * buffer, uint8_t start, int size)
 {
-  int i;
+  uint8_t tail = rs485_rx_tail;
+  int i, len;
+  
+  /* bytes before the frame belong to aborted frames */
+  if (RS485_DIST(tail, start) >= RS485_Available())
+    return 0;
+  tail = start;
+  
+  if (IS_TYPE_BLOCK(rs485_rx_buff[(start + 2) & (RS485_BUFF_SIZE - 1)]))
+    len = 5 + rs485_rx_buff[(start + 3) & (RS485_BUFF_SIZE - 1)];
+  else
+    len = 4 + getTypeLength(rs485_rx_buff[(start + 2) & (RS485_BUFF_SIZE - 1)]);
+  if (len > RS485_DIST(tail, rs485_rx_head))
+    return 0;
   for (i = 0; i < len; i++)
   {
-    UART3_SendData8(buffer[i]);
-    while (UART3_GetFlagStatus(UART3_FLAG_TXE) == RESET);
+    if (i < size)
+      buffer[i] = rs485_rx_buff[tail];
+    tail = RS485_NEXT(tail);
   }
-  return i;
+  rs485_rx_tail = tail;
+  return len > size ? size : len;
+}
+
+void RS485_Discard(uint8_t upto)
+{
+  if (RS485_DIST(rs485_rx_tail, upto) <= RS485_Available())
+    rs485_rx_tail = upto;
+}
+
+int RS485_SendData(char * buffer, int len)
+{
+  int i;
+  
+  if (rs485_tx_len || len <= 0 || len > RS485_TX_SIZE)
+    return 0;
+  for (i = 0; i < len; i++)
+    rs485_tx_buff[i] = buffer[i];
+  rs485_tx_pos = 0;
+  rs485_tx_len = (uint8_t)len;
+  RS485_DIR_OUTPUT;
+  TRACE_EVENT(RS485_SEND, len > 1 ? buffer[1] : 0, len);
+  UART1_ITConfig(UART1_IT_TXE, ENABLE);
+  return len;
+}
+
+uint8_t RS485_Sending(void)
+{
+  return rs485_tx_len != 0;
+}
+
+uint8_t RS485_RxHigh(void)
+{
+  return rs485_rx_high;
+}
+
+void RS485_ClearRxHigh(void)
+{
+  rs485_rx_high = 0;
 }
 
 void RS485_Flush(void)
 {
-	rs485_rx_len = 0;
+	rs485_rx_tail = rs485_rx_head;
 }
 
 void RS485_SendChar(char c)
@@ -89,71 +249,20 @@ void RS485_SendStr(char Str[])
 
 void RS485_SendNum(int num)
 {
-  unsigned long tmp = 10000000;
-  if (num == 0)
-  {
-    RS485_SendChar('0');
-    return;
-  }
-  if (num < 0)
-  {
-    RS485_SendChar('-');
-    num = -num;
-  }
-  while (tmp > 0)
-  {
-    if (tmp <= num)
-    {
-      RS485_SendChar((num/tmp)%10 + '0');
-    }
-    tmp = tmp / 10;
-  }
+  char buf[NUMFMT_MAX];
+  NumFmt_Write(RS485_SendChar, buf, NumFmt_I16(buf, num));
 }
 
 void RS485_SendFloat(float num)
 {
-  int __int = (int) num;
-  RS485_SendNum(__int);
-  RS485_SendChar('.');
-  __int = (int)((num-__int)*100);
-  if (__int < 0)
-    __int = 0;
-  RS485_SendNum(__int);
+  char buf[NUMFMT_MAX];
+  NumFmt_Write(RS485_SendChar, buf, NumFmt_Fixed(buf, num, 2));
 }
 
 void RS485_SendByte(uint8_t b, BYTE_FORMAT f)
 {
-  uint8_t bitMask = 1;
-  uint8_t i;
-  switch (f)
-  {
-  case BIN:
-    for (i = 8; i > 0; i--)
-    {
-      RS485_SendChar((b&(bitMask << i)) ? '1' : '0');
-    }
-    break;
-  case OCT:
-    break;
-  case DEC:
-    RS485_SendNum(b);
-    break;
-  case HEX:
-    if(b/16 < 10){
-      RS485_SendChar(0x30 + b/16);
-    }else{
-      RS485_SendChar(0x37 + b/16);
-    }
-    
-    if(b%16 < 10){
-      RS485_SendChar(0x30 + b%16);
-    }else{
-      RS485_SendChar(0x37 + b%16);
-    }
-    break;
-  default:
-    break;
-  }
+  char buf[NUMFMT_MAX];
+  NumFmt_Write(RS485_SendChar, buf, NumFmt_Byte(buf, b, f));
 }
 
 
@@ -3,6 +3,9 @@
 
 #include "stm8s.h"
 #include "delay.h"
+#include "event.h"
+#include "numfmt.h"
+#include "packet.h"
 
 #define RS485_DIR_PORT          GPIOA
 #define RS485_DIR_PIN           GPIO_PIN_6
@@ -12,16 +15,6 @@
 #define RS485_SEL_PORT					GPIOA
 #define RS485_SEL_PIN						GPIO_PIN_3
 
-#ifndef BYTE_FORMAT
-
-#define BIN     0
-#define OCT     1
-#define DEC     2
-#define HEX     3
-typedef unsigned char BYTE_FORMAT;
-
-#endif
-
 void RS485_Init(unsigned long baudrate);
 void RS485_SendChar(char c);
 void RS485_SendStr(char Str[]);
@@ -30,8 +23,21 @@ void RS485_SendFloat(float num);
 void RS485_SendByte(uint8_t b, BYTE_FORMAT f);
 int RS485_Available(void);
 int RS485_GetData(char * buffer);
+// Copies the frame an EVT_RS485_FRAME event points at and consumes it
+// with the bytes before it, returns the copied length or 0.
+int RS485_GetFrame(char * buffer, uint8_t start, int size);
+// Consumes the bytes up to a ring index, for EVT_RS485_TIMEOUT.
+void RS485_Discard(uint8_t upto);
+void RS485_Tick(void);
+// Copies a frame for the TX ISR, turns the bus to output and returns at
+// once; the ISR turns it back after the last stop bit. Returns 0 and
+// sends nothing while the frame before is still going out.
 int RS485_SendData(char * buffer, int len);
+uint8_t RS485_Sending(void);
 void RS485_Flush(void);
+// most bytes waiting in the RX ring at once
+uint8_t RS485_RxHigh(void);
+void RS485_ClearRxHigh(void);
 
 
 #endif
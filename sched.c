@@ -0,0 +1,84 @@
+#include "sched.h"
+#include "delay.h"
+#include "trace.h"
+
+struct sched_task * sched_tasks;
+uint8_t sched_count;
+uint32_t sched_last_tick;
+
+void Sched_Init(struct sched_task * tasks, uint8_t count)
+{
+	uint8_t i;
+	
+	sched_tasks = tasks;
+	sched_count = count;
+	sched_last_tick = Millis();
+	for (i = 0; i < count; i++)
+	{
+		tasks[i].release = sched_last_tick;
+		tasks[i].ready = tasks[i].period != 0;
+	}
+}
+
+void Sched_Release(uint8_t index)
+{
+	struct sched_task * t = &sched_tasks[index];
+	
+	if (!t->ready)
+	{
+		t->release = Millis();
+		t->ready = 1;
+	}
+}
+
+uint8_t Sched_Run(void)
+{
+	struct sched_task * t, * next = 0;
+	uint32_t now = Millis();
+	uint32_t start, elapsed;
+	uint8_t i;
+	
+	// release periodic tasks once per tick
+	if (now != sched_last_tick)
+	{
+		sched_last_tick = now;
+		for (i = 0; i < sched_count; i++)
+		{
+			t = &sched_tasks[i];
+			if (t->period && !t->ready && (int32_t)(now - (t->release + t->period)) >= 0)
+			{
+				t->release += t->period;
+				t->ready = 1;
+			}
+		}
+	}
+	
+	// earliest deadline first
+	for (i = 0; i < sched_count; i++)
+	{
+		t = &sched_tasks[i];
+		if (t->ready && (next == 0 ||
+			(int32_t)((t->release + t->deadline) - (next->release + next->deadline)) < 0))
+			next = t;
+	}
+	if (next == 0)
+		return 0;
+	
+	next->ready = 0;
+	start = Micros();
+	next->run();
+	elapsed = Micros() - start;
+	
+	next->runs++;
+	if (elapsed > next->wcet_us)
+		next->wcet_us = elapsed;
+	if ((int32_t)(Millis() - (next->release + next->deadline)) > 0)
+	{
+		next->overruns++;
+		TRACE_EVENT(SCHED_OVERRUN, next - sched_tasks, elapsed > 0xFFFF ? 0xFFFF : elapsed);
+		// a late periodic task restarts its phase instead of bursting
+		if (next->period)
+			next->release = Millis();
+	}
+	return 1;
+}
@@ -0,0 +1,38 @@
+#ifndef _sched_h_
+#define _sched_h_
+
+#include "stm8s.h"
+
+// Cooperative run-to-completion scheduler on the TIM3 1 ms tick.
+// Released tasks run earliest deadline first, ties go to the task
+// listed first.
+
+typedef void (*sched_fn)(void);
+
+struct sched_task
+{
+	sched_fn run;
+	unsigned int period;		// ms between releases, 0 for Sched_Release only
+	unsigned int deadline;		// ms after the release
+	
+	// state
+	uint32_t release;			// tick of the last or next release
+	uint8_t ready;
+	
+	// instrumentation
+	uint32_t wcet_us;			// longest run
+	unsigned int runs;
+	unsigned int overruns;		// runs that finished after the deadline
+};
+
+#define SCHED_TASK(fn, period, deadline)	{fn, period, deadline, 0, 0, 0, 0, 0}
+
+void Sched_Init(struct sched_task * tasks, uint8_t count);
+
+// Releases a task now, for event driven work.
+void Sched_Release(uint8_t index);
+
+// Runs at most one released task, returns 0 if none was ready.
+uint8_t Sched_Run(void);
+
+#endif
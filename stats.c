@@ -0,0 +1,151 @@
+#include "stats.h"
+#include "calib.h"
+#include "gas_lighting.h"
+#include <math.h>
+
+struct stats_window
+{
+	int16_t sample[STATS_WINDOW];
+	uint8_t head;		// slot of the next sample
+	uint8_t count;		// samples in the window
+	int32_t sum;
+	uint32_t sumsq;
+	
+	// slot indexes with increasing (min) and decreasing (max) samples,
+	// the front is the extreme of the window
+	uint8_t minq[STATS_WINDOW], min_front, min_len;
+	uint8_t maxq[STATS_WINDOW], max_front, max_len;
+};
+
+struct stats_window stats[STATS_SENSORS];
+uint8_t stats_length = STATS_WINDOW;
+
+#define RING_NEXT(i)	((uint8_t)((i) + 1 == stats_length ? 0 : (i) + 1))
+#define QUEUE_AT(f, n)	((uint8_t)((f) + (n) >= stats_length ? (f) + (n) - stats_length : (f) + (n)))
+
+void Stats_Init(void)
+{
+	uint8_t i;
+	for (i = 0; i < STATS_SENSORS; i++)
+	{
+		stats[i].head = 0;
+		stats[i].count = 0;
+		stats[i].sum = 0;
+		stats[i].sumsq = 0;
+		stats[i].min_front = stats[i].min_len = 0;
+		stats[i].max_front = stats[i].max_len = 0;
+	}
+}
+
+void Stats_SetWindow(uint8_t length)
+{
+	if (length == 0) length = 1;
+	if (length > STATS_WINDOW) length = STATS_WINDOW;
+	stats_length = length;
+	Stats_Init();
+}
+
+uint8_t Stats_GetWindow(void)
+{
+	return stats_length;
+}
+
+void Stats_Add(uint8_t sensor, int16_t sample)
+{
+	struct stats_window * w = &stats[sensor];
+	uint8_t slot = w->head;
+	
+	if (w->count == stats_length)
+	{
+		// the oldest sample leaves the window
+		int16_t old = w->sample[slot];
+		w->sum -= old;
+		w->sumsq -= (uint32_t)((int32_t)old * old);
+		if (w->min_len && w->minq[w->min_front] == slot)
+		{
+			w->min_front = RING_NEXT(w->min_front);
+			w->min_len--;
+		}
+		if (w->max_len && w->maxq[w->max_front] == slot)
+		{
+			w->max_front = RING_NEXT(w->max_front);
+			w->max_len--;
+		}
+	}
+	else
+	{
+		w->count++;
+	}
+	
+	w->sample[slot] = sample;
+	w->sum += sample;
+	w->sumsq += (uint32_t)((int32_t)sample * sample);
+	w->head = RING_NEXT(slot);
+	
+	// drop the samples that can no longer be the extreme
+	while (w->min_len && w->sample[w->minq[QUEUE_AT(w->min_front, w->min_len - 1)]] >= sample)
+		w->min_len--;
+	w->minq[QUEUE_AT(w->min_front, w->min_len)] = slot;
+	w->min_len++;
+	
+	while (w->max_len && w->sample[w->maxq[QUEUE_AT(w->max_front, w->max_len - 1)]] <= sample)
+		w->max_len--;
+	w->maxq[QUEUE_AT(w->max_front, w->max_len)] = slot;
+	w->max_len++;
+}
+
+static float Stats_Scale(uint8_t sensor, float x)
+{
+	uint16_t raw;
+	
+	if (sensor == STATS_TEMPERATURE)
+		return x * 0.0625;
+	if (x < 0) x = 0;
+	if (x > GAS_LIGHTING_FULL_SCALE - 1) x = GAS_LIGHTING_FULL_SCALE - 1;
+	raw = (uint16_t)(x + 0.5);
+	if (sensor == STATS_GAS)
+		return Calib_Convert(GAS_CHANNEL, raw) * (1.0 / CALIB_GAS_SCALE);
+	return Calib_Convert(LIGHTING_CHANNEL, raw) * (1.0 / CALIB_LUX_SCALE);
+}
+
+static void Stats_Fill_One(uint8_t sensor, struct SensorStats * out)
+{
+	struct stats_window * w = &stats[sensor];
+	float mean, var, lo, hi, slope;
+	int32_t q, r;
+	uint32_t dev;
+	
+	if (w->count == 0)
+	{
+		out->min = out->max = out->mean = out->stddev = 0;
+		return;
+	}
+	
+	// sum of squares about q = sum / count, exact in 32 bits since the
+	// true value fits: sumsq - 2 q sum + count q^2 = sumsq - q (sum + r)
+	q = w->sum / w->count;
+	r = w->sum - q * w->count;
+	dev = w->sumsq - (uint32_t)q * (uint32_t)(w->sum + r);
+	mean = (float)w->sum / w->count;
+	var = ((float)dev - (float)(r * r) / w->count) / w->count;
+	if (var < 0) var = 0;
+	
+	lo = Stats_Scale(sensor, w->sample[w->minq[w->min_front]]);
+	hi = Stats_Scale(sensor, w->sample[w->maxq[w->max_front]]);
+	// the gas curve is decreasing
+	out->min = lo < hi ? lo : hi;
+	out->max = lo < hi ? hi : lo;
+	out->mean = Stats_Scale(sensor, mean);
+	
+	// the deviation goes through the local slope of the conversion
+	slope = (Stats_Scale(sensor, mean + 16) - Stats_Scale(sensor, mean - 16)) / 32;
+	if (slope < 0) slope = -slope;
+	out->stddev = sqrt(var) * (sensor == STATS_TEMPERATURE ? 0.0625 : slope);
+}
+
+void Stats_Fill(struct StatsData * data)
+{
+	Stats_Fill_One(STATS_TEMPERATURE, &data->temperature);
+	Stats_Fill_One(STATS_LIGHTING, &data->lighting);
+	Stats_Fill_One(STATS_GAS, &data->gas);
+}
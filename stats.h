@@ -0,0 +1,34 @@
+#ifndef _stats_h_
+#define _stats_h_
+
+#include "stm8s.h"
+#include "packet.h"
+
+// Number of samples the statistics are computed over. Samples must stay
+// within +-4095 so the 32 bit sum of squares cannot overflow.
+#ifndef STATS_WINDOW
+#define STATS_WINDOW	64
+#endif
+
+#if STATS_WINDOW > 255
+#error "STATS_WINDOW must fit the 8 bit ring indexes"
+#endif
+
+#define STATS_TEMPERATURE	0	// 1/16 Celsius
+#define STATS_LIGHTING		1	// decimated ADC reading
+#define STATS_GAS			2	// decimated ADC reading
+#define STATS_SENSORS		3
+
+void Stats_Init(void);
+
+// Changes the window length, 1..STATS_WINDOW, and restarts all windows.
+void Stats_SetWindow(uint8_t length);
+uint8_t Stats_GetWindow(void);
+
+// O(1) amortized: ring buffer, running sums and monotonic min/max queues.
+void Stats_Add(uint8_t sensor, int16_t sample);
+
+// Fills the query reply in engineering units.
+void Stats_Fill(struct StatsData * data);
+
+#endif
@@ -323,17 +323,17 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
 
 #if defined (STM8S208) || defined(STM8S207) || defined(STM8S007) || defined(STM8S103) || \
     defined(STM8S003) ||  defined (STM8AF62Ax) || defined (STM8AF52Ax) || defined (STM8S903)
-/**
-  * @brief UART1 TX Interrupt routine.
-  * @param  None
-  * @retval None
-  */
- INTERRUPT_HANDLER(UART1_TX_IRQHandler, 17)
- {
-    /* In order to detect unexpected events during development,
-       it is recommended to set a breakpoint on the following instruction.
-    */
- }
+///**
+//  * @brief UART1 TX Interrupt routine.
+//  * @param  None
+//  * @retval None
+//  */
+// INTERRUPT_HANDLER(UART1_TX_IRQHandler, 17)
+// {
+//    /* In order to detect unexpected events during development,
+//       it is recommended to set a breakpoint on the following instruction.
+//    */
+// }
 
 ///**
 //  * @brief UART1 RX Interrupt routine.
@@ -413,17 +413,17 @@ INTERRUPT_HANDLER(I2C_IRQHandler, 19)
 #endif /* (STM8S105) || (STM8AF626x) */
 
 #if defined(STM8S207) || defined(STM8S007) || defined(STM8S208) || defined (STM8AF52Ax) || defined (STM8AF62Ax)
-/**
-  * @brief UART3 TX interrupt routine.
-  * @param  None
-  * @retval None
-  */
- INTERRUPT_HANDLER(UART3_TX_IRQHandler, 20)
- {
-    /* In order to detect unexpected events during development,
-       it is recommended to set a breakpoint on the following instruction.
-    */
- }
+///**
+//  * @brief UART3 TX interrupt routine.
+//  * @param  None
+//  * @retval None
+//  */
+// INTERRUPT_HANDLER(UART3_TX_IRQHandler, 20)
+// {
+//    /* In order to detect unexpected events during development,
+//       it is recommended to set a breakpoint on the following instruction.
+//    */
+// }
 
 ///**
 //  * @brief UART3 RX interrupt routine.
@@ -0,0 +1,110 @@
+#include "temperature.h"
+#include "DallasTemperature.h"
+#include "delay.h"
+#include "trace.h"
+#include "profile.h"
+
+#define TEMP_SEARCH		0
+#define TEMP_START		1
+#define TEMP_WAIT		2
+#define TEMP_READ		3
+
+// skipped task steps between searches when no sensor answers
+#define TEMP_SEARCH_BACKOFF	20
+
+DeviceAddress temp_addr;
+uint8_t temp_state = TEMP_SEARCH;
+uint8_t temp_backoff;
+uint32_t temp_start;
+float temp_value;
+uint8_t temp_ready;
+
+static unsigned int Temperature_ConversionTime(void)
+{
+	switch (DS18B20.getResolution1())
+	{
+	case 9:
+		return 94;
+	case 10:
+		return 188;
+	case 11:
+		return 375;
+	default:
+		return 750;
+	}
+}
+
+void Temperature_Init(void)
+{
+	DS18B20.Init();
+	DS18B20.begin();
+	DS18B20.setWaitForConversion(FALSE);
+	temp_state = TEMP_SEARCH;
+	temp_backoff = 0;
+}
+
+void Temperature_Task(void)
+{
+	float t;
+	
+	switch (temp_state)
+	{
+	case TEMP_SEARCH:
+		if (temp_backoff)
+		{
+			temp_backoff--;
+			break;
+		}
+		PROFILE_ENTER(ONEWIRE_SEARCH);
+		if (DS18B20.getAddress(temp_addr, 0))
+			temp_state = TEMP_START;
+		else
+			temp_backoff = TEMP_SEARCH_BACKOFF;
+		PROFILE_EXIT(ONEWIRE_SEARCH);
+		TRACE_EVENT(ONEWIRE_SEARCH, temp_state == TEMP_START, 0);
+		break;
+	case TEMP_START:
+		DS18B20.requestTemperatures();
+		temp_start = Millis();
+		temp_state = TEMP_WAIT;
+		break;
+	case TEMP_WAIT:
+		if (Millis() - temp_start < Temperature_ConversionTime())
+			break;
+		temp_state = TEMP_READ;
+		// fall through
+	case TEMP_READ:
+		PROFILE_ENTER(ONEWIRE_READ);
+		t = DS18B20.getTempC(temp_addr);
+		PROFILE_EXIT(ONEWIRE_READ);
+		if (t == DEVICE_DISCONNECTED)
+		{
+			TRACE_EVENT(ONEWIRE_LOST, 0, 0);
+			temp_state = TEMP_SEARCH;
+			break;
+		}
+		TRACE_EVENT(ONEWIRE_READ, (int16_t)(t * 16), 0);
+		temp_value = t;
+		temp_ready = 1;
+		temp_state = TEMP_START;
+		break;
+	default:
+		temp_state = TEMP_SEARCH;
+		break;
+	}
+}
+
+uint8_t Temperature_Ready(void)
+{
+	if (temp_ready)
+	{
+		temp_ready = 0;
+		return 1;
+	}
+	return 0;
+}
+
+float Temperature_Get(void)
+{
+	return temp_value;
+}
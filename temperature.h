@@ -0,0 +1,17 @@
+#ifndef _temperature_h_
+#define _temperature_h_
+
+#include "stm8s.h"
+
+// Non blocking DS18x20 reader on top of the DallasTemperature driver.
+// Temperature_Task() moves the 1-Wire state machine by one step and
+// never waits for a conversion.
+
+void Temperature_Init(void);
+void Temperature_Task(void);
+
+// Returns non zero once per new reading.
+uint8_t Temperature_Ready(void);
+float Temperature_Get(void);
+
+#endif
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Generate calib_table.c, the gas and lighting conversion tables.
+
+The tables hold the sensor characteristic curves sampled at the knots
+of the piecewise linear conversion in calib.c. Run from the repository
+root after changing a curve or the table geometry in calib.h:
+
+    python3 tools/gen_calib.py > calib_table.c
+
+With --eeprom the script instead writes a data EEPROM image holding
+the per unit calibration record (struct calib_record, STM8 layout) in
+the config log of config.c, for example:
+
+    python3 tools/gen_calib.py --eeprom calib.bin --id 0x91 \\
+        --gas 820:1520,3100:95 --lux 400:2440,3000:18300
+
+Program the whole image, it replaces every logged setting.
+"""
+
+import argparse
+import struct
+import sys
+
+INPUT_BITS = 12
+SEGMENT_BITS = 4
+FULL_SCALE = 1 << INPUT_BITS
+
+GAS_SCALE = 100
+LUX_SCALE = 10
+CALIB_MAGIC = 0xCA
+
+# config.h
+CONFIG_BLOCKS = 12
+CONFIG_KEY_ID = 1
+CONFIG_KEY_CALIB = 2
+BLOCK_SIZE = 128
+
+
+def gas_curve(x):
+    # MQ sensor against RL = 10K, Rs/RL from the divider ratio
+    if x == 0:
+        return float('inf')
+    return 10240.0 * (FULL_SCALE / 1024) / x - 10.0
+
+
+def lux_curve(x):
+    # 1lux - 0.002V, 1000lux - 2V, RL = 10K
+    return x * 2.44141 * 1024 / FULL_SCALE
+
+
+def knots(curve, scale):
+    out = []
+    for i in range((1 << (INPUT_BITS - SEGMENT_BITS)) + 1):
+        v = curve(i << SEGMENT_BITS) * scale
+        out.append(max(0, min(0xFFFF, int(round(v))) if v != float('inf') else 0xFFFF))
+    return out
+
+
+def emit_table(name, values, unit):
+    lines = ['const uint16_t %s[CALIB_KNOTS] = {  // %s' % (name, unit)]
+    for i in range(0, len(values), 8):
+        lines.append('\t' + ', '.join('%5d' % v for v in values[i:i + 8]) + ',')
+    lines[-1] = lines[-1].rstrip(',')
+    lines.append('};')
+    return '\n'.join(lines)
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        for _ in range(8):
+            mix = (crc ^ b) & 1
+            crc >>= 1
+            if mix:
+                crc ^= 0x8C
+            b >>= 1
+    return crc
+
+
+def config_record(key, seq, data):
+    rec = struct.pack('>BBH', key, len(data), seq) + data
+    rec += struct.pack('>B', crc8(rec))
+    # CONFIG_RECORD_SIZE, padded to the 4 byte EEPROM word
+    return rec + bytes(-len(rec) % 4)
+
+
+def parse_points(text):
+    points = []
+    for item in text.split(','):
+        raw, value = item.split(':')
+        points.append((int(raw, 0), int(value, 0)))
+    if len(points) != 2:
+        raise ValueError('expected two raw:value points, got %r' % text)
+    return sorted(points)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    ap.add_argument('--eeprom', metavar='FILE',
+                    help='write a data EEPROM image with the calibration instead of the tables')
+    ap.add_argument('--id', type=lambda x: int(x, 0),
+                    help='also log a node id')
+    ap.add_argument('--gas', default='0:0,4095:%d' % knots(gas_curve, GAS_SCALE)[-1],
+                    help='two raw:value points, value in 0.01 kppm')
+    ap.add_argument('--lux', default='0:0,4095:%d' % round(lux_curve(4095) * LUX_SCALE),
+                    help='two raw:value points, value in 0.1 lux')
+    args = ap.parse_args()
+
+    if args.eeprom:
+        rec = struct.pack('>B', CALIB_MAGIC)
+        for pts in (parse_points(args.gas), parse_points(args.lux)):
+            for raw, value in pts:
+                rec += struct.pack('>HH', raw, value)
+        rec += struct.pack('>B', crc8(rec))
+        image = config_record(CONFIG_KEY_CALIB, 1, rec)
+        if args.id is not None:
+            image += config_record(CONFIG_KEY_ID, 2, struct.pack('>B', args.id))
+        image += bytes(CONFIG_BLOCKS * BLOCK_SIZE - len(image))
+        with open(args.eeprom, 'wb') as f:
+            f.write(image)
+        return
+
+    out = sys.stdout
+    out.write('// Generated by tools/gen_calib.py, do not edit.\n\n')
+    out.write('#include "calib.h"\n\n')
+    out.write('#if CALIB_INPUT_BITS != %d || CALIB_SEGMENT_BITS != %d\n' % (INPUT_BITS, SEGMENT_BITS))
+    out.write('#error "calib_table.c is out of date, run tools/gen_calib.py"\n')
+    out.write('#endif\n\n')
+    out.write(emit_table('calib_gas_table', knots(gas_curve, GAS_SCALE), '0.01 kppm') + '\n\n')
+    out.write(emit_table('calib_lux_table', knots(lux_curve, LUX_SCALE), '0.1 lux') + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,44 @@
+#include "trace.h"
+#include "delay.h"
+#include "uart.h"
+
+#define TRACE_ARGS(name, args, format)	args,
+
+static const uint8_t trace_args[TRACE_COUNT] = { TRACE_EVENTS(TRACE_ARGS) };
+
+unsigned int trace_dropped;
+
+void Trace_Emit(uint8_t event, uint16_t a, uint16_t b)
+{
+	uint8_t rec[TRACE_RECORD_SIZE(2)];
+	uint32_t t = Micros();
+	uint8_t len, i, check = 0;
+	
+	len = TRACE_RECORD_SIZE(trace_args[event]);
+	if (UART_TxSpace() < len)
+	{
+		trace_dropped++;
+		return;
+	}
+	
+	rec[0] = TRACE_SYNC;
+	rec[1] = event;
+	rec[2] = (uint8_t)(t >> 24);
+	rec[3] = (uint8_t)(t >> 16);
+	rec[4] = (uint8_t)(t >> 8);
+	rec[5] = (uint8_t)t;
+	rec[6] = a >> 8;
+	rec[7] = a & 0xFF;
+	rec[8] = b >> 8;
+	rec[9] = b & 0xFF;
+	for (i = 1; i < len - 1; i++)
+		check ^= rec[i];
+	rec[len - 1] = check;
+	
+	UART_SendData((char *)rec, len);
+}
+
+unsigned int Trace_Dropped(void)
+{
+	return trace_dropped;
+}
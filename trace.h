@@ -0,0 +1,25 @@
+#ifndef _trace_h_
+#define _trace_h_
+
+#include "stm8s.h"
+#include "trace_events.h"
+
+// Binary trace records on the debug UART, decoded on the host by
+// host/trace_decode. Costs a few bytes in the TX ring per event; a
+// record that does not fit is dropped whole. Main loop context only.
+#ifndef TRACE
+#define TRACE	1
+#endif
+
+#if TRACE
+#define TRACE_EVENT(name, a, b)	Trace_Emit(TRACE_##name, (uint16_t)(a), (uint16_t)(b))
+#else
+#define TRACE_EVENT(name, a, b)	((void)0)
+#endif
+
+void Trace_Emit(uint8_t event, uint16_t a, uint16_t b);
+
+// records lost to a full TX ring
+unsigned int Trace_Dropped(void);
+
+#endif
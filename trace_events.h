@@ -0,0 +1,32 @@
+#ifndef _trace_events_h_
+#define _trace_events_h_
+
+// Trace event table, shared with host/trace_decode.c. X(name, args, format)
+// with up to two 16 bit arguments; the format takes %u, %d or %x per
+// argument and only exists on the host. Append new events at the end so
+// older captures still decode.
+#define TRACE_EVENTS(X) \
+	X(BOOT,				0,	"boot") \
+	X(RS485_FRAME,		2,	"rs485 rx cmd %x len %u") \
+	X(RS485_SEND,		2,	"rs485 tx cmd %x len %u") \
+	X(RS485_TIMEOUT,	1,	"rs485 partial frame dropped at %u") \
+	X(RS485_OVERRUN,	0,	"rs485 rx ring full") \
+	X(ONEWIRE_SEARCH,	1,	"1-wire search found %u") \
+	X(ONEWIRE_READ,		1,	"1-wire temperature %d/16 C") \
+	X(ONEWIRE_LOST,		0,	"1-wire sensor lost") \
+	X(SCHED_OVERRUN,	2,	"task %u overran, took %u us")
+
+#define TRACE_ENUM(name, args, format)	TRACE_##name,
+
+enum trace_event
+{
+	TRACE_EVENTS(TRACE_ENUM)
+	TRACE_COUNT
+};
+
+// record: TRACE_SYNC, event, Micros() big endian, arguments big endian,
+// xor of the bytes after the sync
+#define TRACE_SYNC			0xA5
+#define TRACE_RECORD_SIZE(args)	(7 + 2 * (args))
+
+#endif
@@ -1,8 +1,18 @@
 #include "uart.h"
 
-#define UART_BUFF_SIZE 128
+#define UART_BUFF_SIZE 128	// power of 2
+#define UART_NEXT(i) ((uint8_t)(((i) + 1) & (UART_BUFF_SIZE - 1)))
 __IO unsigned char uart_rx_buff[UART_BUFF_SIZE];
-__IO unsigned char uart_rx_len; 
+__IO uint8_t uart_rx_head;	// written by the RX ISR only
+__IO uint8_t uart_rx_tail;	// written by the main loop only
+
+#define UART_TX_SIZE 128	// power of 2
+#define UART_TX_NEXT(i) ((uint8_t)(((i) + 1) & (UART_TX_SIZE - 1)))
+__IO unsigned char uart_tx_buff[UART_TX_SIZE];
+__IO uint8_t uart_tx_head;	// written by the main loop only
+__IO uint8_t uart_tx_tail;	// written by the TX ISR only
+__IO unsigned int uart_tx_dropped;	// bytes lost to a full ring
+uint8_t uart_tx_high;	// most bytes queued at once
 
 
 
@@ -27,119 +37,138 @@ void UART_Init(unsigned long baudrate)
 INTERRUPT_HANDLER(UART3_RX_IRQHandler, 21)
 {
   /* Read one byte from the receive data register */
-  uart_rx_buff[uart_rx_len++] = UART3_ReceiveData8();
+  unsigned char c = UART3_ReceiveData8();
+  uint8_t head = uart_rx_head;
   
-  if (uart_rx_len >= UART_BUFF_SIZE)
+  if (UART_NEXT(head) != uart_rx_tail)
   {
-    uart_rx_len = 0;
+    uart_rx_buff[head] = c;
+    uart_rx_head = UART_NEXT(head);
+    /* one event per burst, when the ring was empty */
+    if (head == uart_rx_tail)
+      Event_Post(&uart_events, EVT_UART_RX, c);
   }
   UART3_ClearITPendingBit(UART3_IT_RXNE);
 }
 
 
+INTERRUPT_HANDLER(UART3_TX_IRQHandler, 20)
+{
+  uint8_t tail = uart_tx_tail;
+  
+  if (tail != uart_tx_head)
+  {
+    /* writing the data register clears TXE */
+    UART3_SendData8(uart_tx_buff[tail]);
+    uart_tx_tail = UART_TX_NEXT(tail);
+  }
+  else
+  {
+    /* drained, wait for the next byte */
+    UART3_ITConfig(UART3_IT_TXE, DISABLE);
+  }
+}
+
+
 int UART_Available(void)
 {
-  return uart_rx_len;
+  return (uint8_t)((uart_rx_head - uart_rx_tail) & (UART_BUFF_SIZE - 1));
 }
 int UART_GetData(char * buffer)
 {
-//  memcpy((void *)buffer, (void const *)uart_rx_buff, len);
-//  memset((void *)uart_rx_buff, 0, UART_BUFF_SIZE);
-  int i;
-  for (i = 0; i < uart_rx_len; i++)
+  struct event ev;
+  uint8_t tail = uart_rx_tail;
+  uint8_t head = uart_rx_head;
+  int i = 0;
+  
+  while (Event_Get(&uart_events, &ev) != EVT_NONE);
+  while (tail != head)
   {
-    buffer[i] = uart_rx_buff[i];
+    buffer[i++] = uart_rx_buff[tail];
+    tail = UART_NEXT(tail);
   }
-  uart_rx_len = 0;
+  uart_rx_tail = tail;
   return i;
 }
 void UART_Flush(void)
 {
-  uart_rx_len = 0;
+  struct event ev;
+  while (Event_Get(&uart_events, &ev) != EVT_NONE);
+  uart_rx_tail = uart_rx_head;
 }
 
+// Queues a byte for the TX ISR, a full ring drops it and counts it so
+// logging never waits on the line.
 void UART_SendChar(char c)
 {  
-  UART3_SendData8(c);
-  while (UART3_GetFlagStatus(UART3_FLAG_TXE) == RESET);
+  uint8_t head = uart_tx_head;
+  
+  if (UART_TX_NEXT(head) == uart_tx_tail)
+  {
+    uart_tx_dropped++;
+    return;
+  }
+  uart_tx_buff[head] = c;
+  uart_tx_head = UART_TX_NEXT(head);
+  if ((uint8_t)((uart_tx_head - uart_tx_tail) & (UART_TX_SIZE - 1)) > uart_tx_high)
+    uart_tx_high = (uart_tx_head - uart_tx_tail) & (UART_TX_SIZE - 1);
+  UART3_ITConfig(UART3_IT_TXE, ENABLE);
 }
 
 void UART_SendStr(char Str[])
 {  
   while(*Str)
   {
-    UART3_SendData8(*Str++);
-    while (UART3_GetFlagStatus(UART3_FLAG_TXE) == RESET);
+    UART_SendChar(*Str++);
   }
 }
 
-void UART_SendNum(int num)
+int UART_SendData(char * buffer, int len)
 {
-  unsigned long tmp = 10000000;
-  if (num == 0)
-  {
-    UART_SendChar('0');
-    return;
-  }
-  if (num < 0)
-  {
-    UART_SendChar('-');
-    num = -num;
-  }
-  while (tmp > 0)
+  int i;
+  for (i = 0; i < len; i++)
   {
-    if (tmp <= num)
-    {
-      UART_SendChar((num/tmp)%10 + '0');
-    }
-    tmp = tmp / 10;
+    UART_SendChar(buffer[i]);
   }
+  return i;
+}
+
+int UART_TxSpace(void)
+{
+  return (uint8_t)((uart_tx_tail - uart_tx_head - 1) & (UART_TX_SIZE - 1));
+}
+
+uint8_t UART_TxHigh(void)
+{
+  return uart_tx_high;
+}
+
+void UART_ClearTxHigh(void)
+{
+  uart_tx_high = 0;
+}
+
+unsigned int UART_TxDropped(void)
+{
+  return uart_tx_dropped;
+}
+
+void UART_SendNum(int num)
+{
+  char buf[NUMFMT_MAX];
+  NumFmt_Write(UART_SendChar, buf, NumFmt_I16(buf, num));
 }
 
 void UART_SendFloat(float num)
 {
-  int __int = (int) num;
-  UART_SendNum(__int);
-  UART_SendChar('.');
-  __int = (int)((num-__int)*100);
-  if (__int < 0)
-    __int = 0;
-  UART_SendNum(__int);
+  char buf[NUMFMT_MAX];
+  NumFmt_Write(UART_SendChar, buf, NumFmt_Fixed(buf, num, 2));
 }
 
 void UART_SendByte(uint8_t b, BYTE_FORMAT f)
 {
-  uint8_t bitMask = 1;
-  uint8_t i;
-  switch (f)
-  {
-  case BIN:
-    for (i = 8; i > 0; i--)
-    {
-      UART_SendChar((b&(bitMask << i)) ? '1' : '0');
-    }
-    break;
-  case OCT:
-    break;
-  case DEC:
-    UART_SendNum(b);
-    break;
-  case HEX:
-    if(b/16 < 10){
-      UART_SendChar(0x30 + b/16);
-    }else{
-      UART_SendChar(0x37 + b/16);
-    }
-    
-    if(b%16 < 10){
-      UART_SendChar(0x30 + b%16);
-    }else{
-      UART_SendChar(0x37 + b%16);
-    }
-    break;
-  default:
-    break;
-  }
+  char buf[NUMFMT_MAX];
+  NumFmt_Write(UART_SendChar, buf, NumFmt_Byte(buf, b, f));
 }
 
 
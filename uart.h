@@ -2,18 +2,11 @@
 #define _uart_h_
 
 #include "stm8s.h"
-
-#ifndef BYTE_FORMAT
-
-#define BIN     0
-#define OCT     1
-#define DEC     2
-#define HEX     3
-typedef unsigned char BYTE_FORMAT;
-
-#endif
+#include "event.h"
+#include "numfmt.h"
 
 void UART_Init(unsigned long baudrate);
+// Sends queue into a TX ring drained by UART3_TX_IRQHandler.
 void UART_SendChar(char c);
 void UART_SendStr(char Str[]);
 void UART_SendNum(int num);
@@ -23,5 +16,10 @@ int UART_Available(void);
 int UART_GetData(char * buffer);
 int UART_SendData(char * buffer, int len);
 void UART_Flush(void);
+int UART_TxSpace(void);
+unsigned int UART_TxDropped(void);
+// most bytes queued at once
+uint8_t UART_TxHigh(void);
+void UART_ClearTxHigh(void);
 
 #endif